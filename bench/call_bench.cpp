@@ -0,0 +1,90 @@
+/**
+ * @file call_bench.cpp
+ * @brief Cost of a call to a lambda of three arguments
+ *
+ * Runs CALLS iterations of a loop on each engine with the JIT off; each
+ * iteration is one call to (f a b c) and one tail call of the loop. Reports
+ * nanoseconds (best of ROUNDS) and operator new calls per iteration. The
+ * tree walker and the flat evaluator put arguments and call frames on the
+ * value stack and should allocate nothing per call; the Frame objects
+ * themselves come from the collector's free lists, which this count does
+ * not see. Program output goes to /dev/null.
+ *
+ *   call_bench
+ */
+
+#include "jit.hpp"
+#include "output.hpp"
+#include "reader.hpp"
+#include "repl.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <new>
+#include <string>
+#include <unistd.h>
+
+// 统计 operator new 的调用次数
+long allocations = 0;
+
+void *operator new(std::size_t size) {
+    ++allocations;
+    if (void *p = std::malloc(size != 0 ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+const int ROUNDS = 5;
+const int CALLS = 1000000;
+
+const std::string DEFINITIONS =
+    "(define (f a b c) (if (< a b) (+ a c) (- b c)))\n"
+    "(define (loop i acc) (if (= i 0) acc (loop (- i 1) (f i acc 1))))\n";
+
+void run(FILE *report, const char *name, bool vm, bool flat) {
+    ReplOptions opts;
+    opts.use_vm = vm;
+    opts.use_flat = flat;
+    Reader definitions(DEFINITIONS);
+    REPL(definitions, opts);
+    std::string call = "(loop " + std::to_string(CALLS) + " 0)\n";
+
+    double best = 1e30;
+    long allocated = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        Reader reader(call);
+        long before = allocations;
+        auto start = std::chrono::steady_clock::now();
+        REPL(reader, opts);
+        std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+        allocated = allocations - before;
+        output_flush();
+        if (secs.count() < best) best = secs.count();
+    }
+    std::fprintf(report, "%-6s %10.1f %14.4f\n", name, best * 1e9 / CALLS,
+                 static_cast<double>(allocated) / CALLS);
+}
+
+} // namespace
+
+int main() {
+    // 结果写到原来的 stdout，程序的输出写到 /dev/null
+    FILE *report = fdopen(dup(STDOUT_FILENO), "w");
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    close(null);
+
+    jit_options.enabled = false;
+    std::fprintf(report, "%-6s %10s %14s\n", "engine", "ns/iter", "new/iter");
+    run(report, "tree", false, false);
+    run(report, "flat", false, true);
+    run(report, "vm", true, false);
+    fclose(report);
+    return 0;
+}
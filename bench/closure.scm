@@ -0,0 +1,9 @@
+(define (adder k) (lambda (x) (+ x k)))
+(define (compose f g) (lambda (x) (f (g x))))
+(define (build n acc) (if (= n 0) acc (build (- n 1) (cons n acc))))
+(define (mk i) (let ((big (build 20000 (quote ())))) (lambda () i)))
+(define (keep n acc) (if (= n 0) acc (keep (- n 1) (cons (mk n) acc))))
+(define kept (keep 200 (quote ())))
+(define (run i acc) (if (= i 0) acc (run (- i 1) ((compose (adder i) (lambda (y) (* y 2))) acc))))
+(run 400000 ((car kept)))
+(exit)
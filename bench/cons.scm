@@ -0,0 +1,5 @@
+(define (build n acc) (if (= n 0) acc (build (- n 1) (cons n acc))))
+(define (len l acc) (if (null? l) acc (len (cdr l) (+ acc 1))))
+(define (rounds r total) (if (= r 0) total (rounds (- r 1) (+ total (len (build 1000 '()) 0)))))
+(rounds 2000 0)
+(exit)
@@ -0,0 +1,5 @@
+(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))
+(define (count i acc) (if (= i 0) acc (count (- i 1) (+ acc (* i 2)))))
+(fib 25)
+(count 1000000 0)
+(exit)
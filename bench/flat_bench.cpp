@@ -0,0 +1,166 @@
+/**
+ * @file flat_bench.cpp
+ * @brief Cache behaviour of the tree walker and the flat evaluator
+ *
+ * Each program (score/data/18.in and 19.in by default) is run ROUNDS times
+ * in-process by each engine, with the JIT off so that every call is
+ * interpreted, and reported per run:
+ *   ms       wall time
+ *   L1D      L1 data cache read misses, and misses per read
+ *   LLC      last-level cache read misses, and misses per read
+ *   insns    instructions retired
+ * The counters are read with perf_event_open (user space only). Where the
+ * kernel or the virtual machine does not expose a hardware counter it is
+ * printed as n/a. Program output goes to /dev/null.
+ *
+ *   flat_bench [file.scm...]
+ */
+
+#include "jit.hpp"
+#include "output.hpp"
+#include "reader.hpp"
+#include "repl.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <linux/perf_event.h>
+#include <sstream>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const int ROUNDS = 20;
+
+uint64_t cache_config(uint64_t cache, uint64_t result) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+}
+
+// 一个计数器；打不开时 fd 为 -1，输出 n/a
+class Counter {
+public:
+    Counter(uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof attr);
+        attr.size = sizeof attr;
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~Counter() {
+        if (fd >= 0) close(fd);
+    }
+    Counter(const Counter &) = delete;
+    Counter &operator=(const Counter &) = delete;
+
+    bool ok() const { return fd >= 0; }
+
+    void start() {
+        if (fd < 0) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    void stop() {
+        if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    double read_count() const {
+        uint64_t n = 0;
+        if (fd < 0 || read(fd, &n, sizeof n) != sizeof n) return -1;
+        return n;
+    }
+
+private:
+    int fd;
+};
+
+struct Counters {
+    Counter l1d_reads{PERF_TYPE_HW_CACHE, cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_ACCESS)};
+    Counter l1d_misses{PERF_TYPE_HW_CACHE, cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS)};
+    Counter llc_reads{PERF_TYPE_HW_CACHE, cache_config(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_ACCESS)};
+    Counter llc_misses{PERF_TYPE_HW_CACHE, cache_config(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS)};
+    Counter insns{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS};
+
+    std::vector<Counter *> all() { return {&l1d_reads, &l1d_misses, &llc_reads, &llc_misses, &insns}; }
+};
+
+std::string read_file(const std::string &path) {
+    std::ifstream in(path);
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+// 未命中次数与每次读的未命中率，计数器不可用时为 n/a
+std::string misses(const Counter &miss, const Counter &reads) {
+    if (!miss.ok()) return "n/a";
+    char buf[64];
+    double m = miss.read_count() / ROUNDS;
+    if (reads.ok() && reads.read_count() > 0) {
+        std::snprintf(buf, sizeof buf, "%.0f (%.2f%%)", m, 100.0 * miss.read_count() / reads.read_count());
+    } else {
+        std::snprintf(buf, sizeof buf, "%.0f", m);
+    }
+    return buf;
+}
+
+void run(FILE *report, const std::string &name, const std::string &text, bool flat) {
+    ReplOptions opts;
+    opts.use_flat = flat;
+    {
+        Reader warm(text);   // 先跑一遍：全局定义、内联缓存与展平的函数体都已就绪
+        REPL(warm, opts);
+        output_flush();
+    }
+    Counters counters;
+    for (Counter *c : counters.all()) c->start();
+    auto begin = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; ++r) {
+        Reader reader(text);
+        REPL(reader, opts);
+        output_flush();
+    }
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - begin;
+    for (Counter *c : counters.all()) c->stop();
+
+    char insns[32] = "n/a";
+    if (counters.insns.ok()) std::snprintf(insns, sizeof insns, "%.0f", counters.insns.read_count() / ROUNDS);
+    std::fprintf(report, "%-10s %-6s %9.3f %22s %22s %14s\n", name.c_str(), flat ? "flat" : "tree",
+                 secs.count() * 1e3 / ROUNDS, misses(counters.l1d_misses, counters.l1d_reads).c_str(),
+                 misses(counters.llc_misses, counters.llc_reads).c_str(), insns);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) files.push_back(argv[i]);
+    if (files.empty()) files = {SCORE_DIR "/data/18.in", SCORE_DIR "/data/19.in"};
+
+    // 结果写到原来的 stdout，程序的输出写到 /dev/null
+    FILE *report = fdopen(dup(STDOUT_FILENO), "w");
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    close(null);
+
+    jit_options.enabled = false;
+    std::fprintf(report, "%-10s %-6s %9s %22s %22s %14s\n", "program", "engine", "ms/run", "L1D misses/run",
+                 "LLC misses/run", "insns/run");
+    for (const auto &path : files) {
+        std::string text = read_file(path);
+        std::string name = path.substr(path.rfind('/') + 1);
+        run(report, name, text, false);
+        run(report, name, text, true);
+    }
+    fclose(report);
+    return 0;
+}
@@ -0,0 +1,4 @@
+(define (step x) (if (< 1 2) (+ x (* (- 100 98) (quote 3)) (modulo 17 5)) (car x)))
+(define (loop n acc) (if (= n 0) acc (loop (- n 1) (step (cond ((> 1 2) acc) (else (+ acc (- 10 10))))))))
+(loop 2000000 0)
+(exit)
@@ -0,0 +1,80 @@
+/**
+ * @file nest_bench.cpp
+ * @brief Reading and quoting deeply nested and very long data
+ *
+ * For each size n, a quoted datum is read, converted to a value as quote
+ * does, and destroyed again (best of ROUNDS), in three shapes:
+ *   deep   '((((...)))) nested n levels
+ *   quotes ''''...'x, a chain of n quote forms
+ *   long   '(1 2 ... n), one flat list
+ * The time per node should stay flat as n grows; none of the steps may
+ * recurse on the native stack, so the largest sizes must not crash.
+ *
+ *   nest_bench [max-n]
+ */
+
+#include "reader.hpp"
+#include "syntax.hpp"
+#include "value.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+Value syntax_to_quoted_value(const Syntax &);
+
+namespace {
+
+const int ROUNDS = 5;
+
+std::string deep(long n) {
+    return "'" + std::string(n, '(') + std::string(n, ')');
+}
+
+std::string quotes(long n) {
+    return std::string(n, '\'') + "x";
+}
+
+std::string flat(long n) {
+    std::string text = "'(";
+    for (long i = 1; i <= n; ++i) {
+        text += std::to_string(i);
+        text += ' ';
+    }
+    return text + ")";
+}
+
+// 读入、转换、析构一次的最短时间，单位为秒
+double best_time(const std::string &text) {
+    double best = 1e30;
+    for (int r = 0; r < ROUNDS; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        {
+            Reader reader(text);
+            SyntaxArena arena;
+            Value v = syntax_to_quoted_value(readSyntax(reader, arena));
+            if (v.type() != V_PAIR) std::puts("not a list");
+        }
+        std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+        if (secs.count() < best) best = secs.count();
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    long max_n = argc > 1 ? std::atol(argv[1]) : 1000000;
+    std::printf("%-8s %10s %12s %10s\n", "shape", "n", "ms", "ns/node");
+    for (long n = 1000; n <= max_n; n *= 10) {
+        struct {
+            const char *name;
+            std::string text;
+        } shapes[] = {{"deep", deep(n)}, {"quotes", quotes(n)}, {"long", flat(n)}};
+        for (auto &shape : shapes) {
+            double secs = best_time(shape.text);
+            std::printf("%-8s %10ld %12.2f %10.1f\n", shape.name, n, secs * 1e3, secs * 1e9 / n);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,5 @@
+(define (emit i n) (if (< i n) (begin (display i) (display " ") (display (* i i)) (display "\n") (emit (+ i 1) n))))
+(emit 0 300000)
+(define (show-lists i n) (if (< i n) (begin (display (list i "x" 'y)) (display "\n") (show-lists (+ i 1) n))))
+(show-lists 0 100000)
+(exit)
@@ -0,0 +1,11 @@
+(define (build n acc) (if (= n 0) acc (build (- n 1) (cons n acc))))
+(define (nest n acc) (if (= n 0) acc (nest (- n 1) (list acc n))))
+(define long (build 500000 '()))
+(display long)
+(display "\n")
+(nest 200000 '())
+(define ring (build 100000 '()))
+(define (last l) (if (null? (cdr l)) l (last (cdr l))))
+(set-cdr! (last ring) ring)
+ring
+(exit)
@@ -0,0 +1,196 @@
+/**
+ * @file read_bench.cpp
+ * @brief Reader throughput in MB of source per second
+ *
+ * Reads a program form by form (best of ROUNDS) from three sources:
+ *   memory  a Reader over the text in a std::string
+ *   mmap    Reader::open on a file holding the text
+ *   pipe    a Reader over a pipe, filled by read(2) as for interactive stdin
+ * and reports both reading alone and reading plus parsing into Expr,
+ * followed by the number of operator new calls per syntax node for each.
+ *
+ * The program is the files given on the command line, concatenated, or a
+ * generated one of about 16 MB:
+ *   read_bench [file.scm...]
+ */
+
+#include "reader.hpp"
+#include "syntax.hpp"
+#include "expr.hpp"
+#include "RE.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// 统计 operator new 的调用次数
+long allocations = 0;
+
+void *operator new(std::size_t size) {
+    ++allocations;
+    if (void *p = std::malloc(size != 0 ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+const int ROUNDS = 5;
+const size_t GENERATED_SIZE = 16 << 20;
+
+std::string generate() {
+    std::string text;
+    char buf[256];
+    for (int i = 0; text.size() < GENERATED_SIZE; ++i) {
+        snprintf(buf, sizeof buf,
+                 "; function %d\n"
+                 "(define (f%d x y)\n"
+                 "  (if (< x %d) (+ x (* y %d))\n"
+                 "      (cons \"line\\n%d\" '(a b %d/7 12345678901234 #t #f))))\n",
+                 i, i, i % 97, i, i, i % 13 + 1);
+        text += buf;
+    }
+    return text;
+}
+
+// 读完全部形式；parse 为真时同时解析为 Expr
+long consume(Reader &reader, bool parse) {
+    Scope scope(nullptr);
+    SyntaxArena arena;
+    long forms = 0;
+    while (!readEnd(reader)) {
+        Syntax stx = readSyntax(reader, arena);
+        if (parse) {
+            try {
+                stx->parse(scope);
+            } catch (const RuntimeError &) {
+            }
+        }
+        arena.clear();
+        ++forms;
+    }
+    return forms;
+}
+
+long count_nodes(Syntax root) {
+    std::vector<Syntax> stack(1, root);
+    long nodes = 0;
+    while (!stack.empty()) {
+        Syntax stx = stack.back();
+        stack.pop_back();
+        ++nodes;
+        if (List *list = stx->list()) stack.insert(stack.end(), list->stxs.begin(), list->stxs.end());
+    }
+    return nodes;
+}
+
+// 读完（并解析）全部形式期间 operator new 的调用次数，除以语法节点数
+double allocations_per_node(const std::string &text, bool parse) {
+    long nodes = 0;
+    {
+        Reader reader(text);
+        SyntaxArena arena;
+        while (!readEnd(reader)) {
+            nodes += count_nodes(readSyntax(reader, arena));
+            arena.clear();
+        }
+    }
+    long before = allocations;
+    {
+        Reader reader(text);
+        consume(reader, parse);
+    }
+    return static_cast<double>(allocations - before) / nodes;
+}
+
+// 子进程把文本写进管道，父进程增量读取
+long consume_pipe(const std::string &text, bool parse) {
+    int fds[2];
+    if (pipe(fds) != 0) return 0;
+    pid_t child = fork();
+    if (child == 0) {
+        close(fds[0]);
+        for (size_t done = 0; done < text.size();) {
+            ssize_t n = write(fds[1], text.data() + done, text.size() - done);
+            if (n <= 0) _exit(1);
+            done += n;
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    long forms;
+    {
+        Reader reader(fds[0]);
+        forms = consume(reader, parse);
+    }
+    close(fds[0]);
+    waitpid(child, nullptr, 0);
+    return forms;
+}
+
+template <class F>
+double mb_per_sec(size_t bytes, F run) {
+    double best = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        long forms = run();
+        std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+        if (forms == 0) std::puts("no forms read");
+        double rate = bytes / secs.count() / 1e6;
+        if (rate > best) best = rate;
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::string text;
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream in(argv[i], std::ios::binary);
+        if (!in) {
+            std::fprintf(stderr, "read_bench: cannot open %s\n", argv[i]);
+            return 1;
+        }
+        text.append(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        text += '\n';
+    }
+    if (argc == 1) text = generate();
+
+    char path[] = "/tmp/read_benchXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0 || write(fd, text.data(), text.size()) != static_cast<ssize_t>(text.size())) {
+        std::fprintf(stderr, "read_bench: cannot write %s\n", path);
+        return 1;
+    }
+    close(fd);
+
+    std::printf("%.1f MB of source\n", text.size() / 1e6);
+    for (int parse = 0; parse < 2; ++parse) {
+        const char *what = parse ? "read+parse" : "read";
+        std::printf("memory %-10s %8.1f MB/s\n", what, mb_per_sec(text.size(), [&] {
+            Reader reader(text);
+            return consume(reader, parse);
+        }));
+        std::printf("mmap   %-10s %8.1f MB/s\n", what, mb_per_sec(text.size(), [&] {
+            std::unique_ptr<Reader> reader = Reader::open(path);
+            return reader ? consume(*reader, parse) : 0;
+        }));
+        std::printf("pipe   %-10s %8.1f MB/s\n", what, mb_per_sec(text.size(), [&] {
+            return consume_pipe(text, parse);
+        }));
+    }
+    std::printf("operator new per node: read %.3f, read+parse %.3f\n",
+                allocations_per_node(text, false), allocations_per_node(text, true));
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file scan_bench.cpp
+ * @brief Reader throughput with each set of scanning kernels
+ *
+ * The score corpus (score/data and score/more-tests) is concatenated
+ * until it reaches CORPUS_SIZE and, for every kernel level the CPU
+ * supports, reported in MB/s (best of ROUNDS):
+ *   tokens  a lexer loop made of the kernels alone, no Syntax built
+ *   read    readSyntax over the whole text
+ * Before timing, each level must read the corpus to the same forms as the
+ * scalar kernels.
+ *   scan_bench [file.scm...]
+ */
+
+#include "scan.hpp"
+#include "reader.hpp"
+#include "syntax.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <glob.h>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int ROUNDS = 5;
+const size_t CORPUS_SIZE = 32 << 20;
+
+std::vector<std::string> score_files() {
+    std::vector<std::string> files;
+    for (const char *pattern : {SCORE_DIR "/data/*.in", SCORE_DIR "/more-tests/*.in"}) {
+        glob_t g;
+        if (glob(pattern, 0, nullptr, &g) == 0) {
+            files.insert(files.end(), g.gl_pathv, g.gl_pathv + g.gl_pathc);
+        }
+        globfree(&g);
+    }
+    return files;
+}
+
+// 只用扫描内核切分记号，统计记号个数
+long count_tokens(const std::string &text) {
+    const char *p = text.data(), *end = p + text.size();
+    long tokens = 0;
+    while (true) {
+        p = scan_space_end(p, end);
+        if (p == end) break;
+        char c = *p;
+        if (c == ';') {
+            p = scan.line_end(p, end);
+            continue;
+        }
+        ++tokens;
+        if (c == '(' || c == ')' || c == '[' || c == ']' || c == '\'') {
+            ++p;
+        } else if (c == '"') {
+            // 跳过转义的字符，直到结束的引号
+            for (p = scan.string_stop(p + 1, end); p < end && *p == '\\'; ) {
+                p = scan.string_stop(std::min(p + 2, end), end);
+            }
+            if (p < end) ++p;
+        } else {
+            p = scan.delimiter(p, end);
+        }
+    }
+    return tokens;
+}
+
+long read_forms(const std::string &text) {
+    Reader reader(text);
+    SyntaxArena arena;
+    long forms = 0;
+    while (!readEnd(reader)) {
+        readSyntax(reader, arena);
+        arena.clear();
+        ++forms;
+    }
+    return forms;
+}
+
+size_t shown_hash(const std::string &text) {
+    Reader reader(text);
+    SyntaxArena arena;
+    std::ostringstream shown;
+    while (!readEnd(reader)) {
+        readSyntax(reader, arena)->show(shown);
+        shown << '\n';
+        arena.clear();
+    }
+    return std::hash<std::string>()(shown.str());
+}
+
+double mb_per_sec(const std::string &text, long (*run)(const std::string &)) {
+    double best = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        long count = run(text);
+        std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+        if (count == 0) std::puts("nothing read");
+        double rate = text.size() / secs.count() / 1e6;
+        if (rate > best) best = rate;
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> files(argv + 1, argv + argc);
+    if (files.empty()) files = score_files();
+    std::string corpus;
+    for (const std::string &file : files) {
+        std::ifstream in(file, std::ios::binary);
+        corpus.append(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        corpus += '\n';
+    }
+    if (corpus.empty()) {
+        std::fprintf(stderr, "scan_bench: no input\n");
+        return 1;
+    }
+    std::string text;
+    while (text.size() < CORPUS_SIZE) text += corpus;
+
+    scan_select(SCAN_SCALAR);
+    size_t expected = shown_hash(corpus);
+    std::printf("%zu files, %.1f MB\n", files.size(), text.size() / 1e6);
+    for (ScanLevel level : {SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2}) {
+        if (!scan_select(level)) {
+            std::printf("%-6s  not supported\n", scan_level_name(level));
+            continue;
+        }
+        if (shown_hash(corpus) != expected) {
+            std::printf("%-6s  MISMATCH with scalar\n", scan_level_name(level));
+            return 1;
+        }
+        double tokens = mb_per_sec(text, count_tokens);
+        double read = mb_per_sec(text, read_forms);
+        std::printf("%-6s  tokens %8.1f MB/s   read %8.1f MB/s\n", scan_level_name(level), tokens, read);
+    }
+    scan_select(scan_best());
+    return 0;
+}
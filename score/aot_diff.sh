@@ -0,0 +1,51 @@
+#!/bin/bash
+
+echo "Differential test of scmc: every test runs on the interpreter and as a compiled program"
+echo "--------------------------------------------------------------------------------"
+
+# 确保我们在score目录下
+cd "$(dirname "$0")"
+
+BUILD=$(cd "${1:-../build}" && pwd)
+SRC=$(cd ../src && pwd)
+export BUILD SRC
+# 生成的程序必须与运行时库使用相同的宏定义（如 INT32_WRAP）
+export FLAGS=$(grep -o -- '-D[A-Z0-9_]*' "$BUILD/compile_commands.json" | sort -u | tr '\n' ' ')
+export WORK=$(mktemp -d)
+
+build_one() {
+    "$BUILD/scmc" "$WORK/$1.scm" -o "$WORK/$1.cpp" 2> /dev/null &&
+        ${CXX:-c++} -std=gnu++11 -O1 $FLAGS -I"$SRC" "$WORK/$1.cpp" "$BUILD/libscheme_runtime.a" -pthread \
+            -o "$WORK/$1" 2> "$WORK/$1.log"
+}
+export -f build_one
+
+names=()
+for f in data/*.in more-tests/*.in
+do
+    name=$(echo "${f%.in}" | tr '/' '_')
+    { cat "$f"; echo; echo "(exit)"; } > "$WORK/$name.scm"
+    names+=("$name")
+done
+printf '%s\n' "${names[@]}" | xargs -P "$(nproc)" -I{} bash -c 'build_one {}'
+
+failed=0
+for name in "${names[@]}"
+do
+    if [ ! -x "$WORK/$name" ]; then
+        echo "Translation or compilation failed for" "$name"
+        failed=$((failed + 1))
+        continue
+    fi
+    timeout 20 "$BUILD/code" < "$WORK/$name.scm" > "$WORK/ref.out" 2>/dev/null
+    timeout 20 "$WORK/$name" > "$WORK/aot.out" 2>/dev/null
+    if ! diff "$WORK/ref.out" "$WORK/aot.out" > diff_output.txt; then
+        echo "Output differs in" "$name"
+        failed=$((failed + 1))
+    fi
+done
+rm -rf "$WORK"
+
+echo "--------------------------------------------------------------------------------"
+echo "$failed test(s) differ"
+[ $failed -eq 0 ]
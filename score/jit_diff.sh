@@ -0,0 +1,29 @@
+#!/bin/bash
+
+echo "Differential test of the JIT: every test runs interpreted and with --jit-check"
+echo "--------------------------------------------------------------------------------"
+
+# 确保我们在score目录下
+cd "$(dirname "$0")"
+
+BIN=${1:-../build/code}
+failed=0
+for f in data/*.in more-tests/*.in
+do
+    # 同一输入分别用纯解释器和 --jit-check（阈值为 1，每个本地结果都与解释器比对）运行
+    { cat "$f"; echo; echo "(exit)"; } | timeout 20 "$BIN" --no-jit > jit_ref.out 2>/dev/null
+    { cat "$f"; echo; echo "(exit)"; } | timeout 20 "$BIN" --jit-check > jit_run.out 2> jit_err.out
+    if ! diff jit_ref.out jit_run.out > diff_output.txt; then
+        echo "Output differs in" "$f"
+        failed=$((failed + 1))
+    elif grep -q "jit mismatch" jit_err.out; then
+        echo "Native result differs in" "$f"
+        grep "jit mismatch" jit_err.out | head -5
+        failed=$((failed + 1))
+    fi
+done
+rm -f jit_ref.out jit_run.out jit_err.out
+
+echo "--------------------------------------------------------------------------------"
+echo "$failed test(s) differ"
+[ $failed -eq 0 ]
@@ -20,8 +20,12 @@
 struct Syntax;
 struct Expr;
 struct Value;
-struct AssocList;
-struct Assoc;
+struct GlobalCell;
+struct GlobalEnv;
+struct Frame;
+struct Env;
+struct Scope;
+struct Chunk;
 
 /**
  * @brief Expression types enumeration
@@ -33,7 +37,9 @@ enum ExprType {
     // Basic types and literals
     E_FIXNUM,          
     E_RATIONAL,        
+    E_BIGNUM,
     E_STRING,         
+    E_CONST,
     E_TRUE,            
     E_FALSE,           
     E_VOID,          
@@ -112,12 +118,16 @@ enum ExprType {
 enum ValueType {
     V_INT,              
     V_RATIONAL,         
+    V_BIGNUM,
+    V_BIGRATIONAL,
     V_BOOL,             
     V_SYM,              
     V_NULL,             
     V_STRING,           
     V_PAIR,             
     V_PROC,             
+    V_PRIMITIVE,
+    V_BOX,
     V_VOID,            
     V_TERMINATE        
 };
@@ -0,0 +1,650 @@
+/**
+ * @file aot.cpp
+ * @brief Scheme to C++ translator behind scmc (see aot.hpp)
+ */
+
+#include "aot.hpp"
+#include "syntax.hpp"
+#include "reader.hpp"
+#include "expr.hpp"
+#include "value.hpp"
+#include "RE.hpp"
+#include "optimizer.hpp"
+#include <cctype>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <vector>
+
+Value syntax_to_quoted_value(const Syntax &);
+
+namespace {
+
+// 函数体中出现翻译不覆盖的形式：放弃这个 lambda，它照常由解释器执行
+struct Unsupported {};
+
+template <class T>
+bool isa(ExprBase *e) {
+    return dynamic_cast<T *>(e) != nullptr;
+}
+
+/**
+ * @brief Primitive node class and the code generated for it
+ */
+struct NodeClass {
+    const char *name;            ///< Class in expr.hpp
+    bool (*test)(ExprBase *);
+    const char *helper;          ///< Inline fast path, nullptr to use aot_unary/aot_binary/aot_variadic<name>
+};
+
+const NodeClass node_classes[] = {
+    {"Plus", isa<Plus>, "aot_add"},
+    {"Minus", isa<Minus>, "aot_sub"},
+    {"Mult", isa<Mult>, "aot_mul"},
+    {"Div", isa<Div>, nullptr},
+    {"Modulo", isa<Modulo>, nullptr},
+    {"Expt", isa<Expt>, nullptr},
+    {"Less", isa<Less>, "aot_compare<std::less<int>, Less>"},
+    {"LessEq", isa<LessEq>, "aot_compare<std::less_equal<int>, LessEq>"},
+    {"Equal", isa<Equal>, "aot_compare<std::equal_to<int>, Equal>"},
+    {"GreaterEq", isa<GreaterEq>, "aot_compare<std::greater_equal<int>, GreaterEq>"},
+    {"Greater", isa<Greater>, "aot_compare<std::greater<int>, Greater>"},
+    {"Cons", isa<Cons>, "aot_cons"},
+    {"SetCar", isa<SetCar>, nullptr},
+    {"SetCdr", isa<SetCdr>, nullptr},
+    {"IsEq", isa<IsEq>, "aot_eq"},
+    {"Car", isa<Car>, "aot_car"},
+    {"Cdr", isa<Cdr>, "aot_cdr"},
+    {"Not", isa<Not>, "aot_not"},
+    {"IsBoolean", isa<IsBoolean>, nullptr},
+    {"IsFixnum", isa<IsFixnum>, nullptr},
+    {"IsNull", isa<IsNull>, "aot_is_null"},
+    {"IsPair", isa<IsPair>, "aot_is_pair"},
+    {"IsProcedure", isa<IsProcedure>, nullptr},
+    {"IsSymbol", isa<IsSymbol>, nullptr},
+    {"IsList", isa<IsList>, nullptr},
+    {"IsString", isa<IsString>, nullptr},
+    {"Display", isa<Display>, nullptr},
+    {"PlusVar", isa<PlusVar>, nullptr},
+    {"MinusVar", isa<MinusVar>, nullptr},
+    {"MultVar", isa<MultVar>, nullptr},
+    {"DivVar", isa<DivVar>, nullptr},
+    {"LessVar", isa<LessVar>, nullptr},
+    {"LessEqVar", isa<LessEqVar>, nullptr},
+    {"EqualVar", isa<EqualVar>, nullptr},
+    {"GreaterEqVar", isa<GreaterEqVar>, nullptr},
+    {"GreaterVar", isa<GreaterVar>, nullptr},
+    {"ListFunc", isa<ListFunc>, nullptr},
+};
+
+std::string join(const std::vector<std::string> &parts) {
+    std::string s;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        if (i > 0) s += ", ";
+        s += parts[i];
+    }
+    return s;
+}
+
+// C++ 字符串字面量；非 ASCII 字节与 ? 一律转义（避免三字符组）
+std::string quote(const std::string &s) {
+    std::string out = "\"";
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c < 0x20 || c >= 0x7f || c == '?') {
+            char buf[8];
+            snprintf(buf, sizeof buf, "\\%03o", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// Let::eval 在求值时拒绝的变量名
+bool valid_name(const std::string &var) {
+    if (var.empty() || isdigit(static_cast<unsigned char>(var[0])) || var[0] == '.' || var[0] == '@') return false;
+    for (char c : var) {
+        if (c == '#' || c == '\'' || c == '"' || c == '`' || isspace(static_cast<unsigned char>(c))) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief A top-level (define name (lambda ...)) of the program
+ */
+struct Definition {
+    int form;                            ///< Index of the top-level form
+    std::string name;                    ///< Global it is bound to
+    std::shared_ptr<LambdaInfo> info;
+    std::string code;                    ///< C++ definition of its function and entry
+
+    std::string function() const { return "f" + std::to_string(form); }
+    std::string entry() const { return "e" + std::to_string(form); }
+};
+
+class Translator;
+
+/**
+ * @brief Translates the body of one Definition to a C++ function
+ *
+ * emit() writes statements leaving the value of a form in dest, or
+ * returning it when dest is empty (tail position); value() returns a C++
+ * expression for it that may be evaluated any number of times, which is
+ * a constant, a parameter or let variable (never assigned), or a temporary.
+ */
+class Emitter {
+    Translator &t;
+    const Definition &def;
+    std::ostringstream body;
+    int indent;
+    int temps;
+    bool looped;                                   ///< A self call in tail position jumps to top
+    std::vector<std::vector<std::string>> frames;  ///< C++ variable of each slot, innermost frame last
+
+    std::ostream &line() { return body << std::string(4 * indent, ' '); }
+    std::string temp() { return "t" + std::to_string(temps++); }
+
+    void finish(const std::string &x, const std::string &dest) {
+        if (dest.empty()) {
+            line() << "return " << x << ";\n";
+        } else {
+            line() << dest << " = " << x << ";\n";
+        }
+    }
+
+    bool constant(ExprBase *e, std::string &out);
+    std::string variable(Var *);
+    std::string primitive(ExprBase *);
+    static bool structured(ExprBase *);
+    std::string value(const Expr &);
+    void emit(const Expr &, const std::string &dest);
+    void branch(const Expr &, const std::string &dest);
+    void sequence(const std::vector<Expr> &, size_t from, const std::string &dest);
+    void close(int blocks);
+    void emitIf(If *, const std::string &dest);
+    void emitBegin(Begin *, const std::string &dest);
+    void emitCond(Cond *, const std::string &dest);
+    void emitAnd(AndVar *, const std::string &dest);
+    void emitOr(OrVar *, const std::string &dest);
+    void emitLet(Let *, const std::string &dest);
+    void emitApply(Apply *, const std::string &dest);
+
+public:
+    Emitter(Translator &tr, const Definition &d) : t(tr), def(d), indent(1), temps(0), looped(false) {}
+    std::string run();
+};
+
+/**
+ * @brief Whole-program state: definitions, global cells and quoted data
+ */
+class Translator {
+public:
+    std::vector<Definition> defs;
+    std::map<std::string, const Definition *> known;   ///< Translated definitions by name, the last one wins
+    std::map<std::string, int> cells;
+    std::vector<std::string> cell_names;
+    std::vector<std::string> data;
+
+    void read(const std::string &source);
+    void translate();
+    void write(std::ostream &, const std::string &name, const std::string &source) const;
+
+    std::string cell(const std::string &name) {
+        auto it = cells.find(name);
+        if (it == cells.end()) {
+            it = cells.insert({name, static_cast<int>(cell_names.size())}).first;
+            cell_names.push_back(name);
+        }
+        return "c" + std::to_string(it->second);
+    }
+
+    // 立即数直接写出值字；堆上的数据以文本保存，由 aot_main 启动时读回
+    std::string constant(const Value &v) {
+        if (!v.isHeap()) {
+            char buf[48];
+            snprintf(buf, sizeof buf, "Value::raw(0x%llxu)", static_cast<unsigned long long>(v.w));
+            return buf;
+        }
+        ValueType type = v.type();
+        if (type != V_RATIONAL && type != V_BIGNUM && type != V_SYM && type != V_STRING && type != V_PAIR) {
+            throw Unsupported();
+        }
+        std::ostringstream text, again;
+        v.show(text);
+        try {
+            std::string shown = text.str();
+            Reader in(shown);
+            SyntaxArena arena;
+            Value back = syntax_to_quoted_value(readSyntax(in, arena));
+            back.show(again);
+            if (back.type() != type || again.str() != text.str()) throw Unsupported();
+        } catch (const RuntimeError &) {
+            throw Unsupported();
+        }
+        data.push_back(text.str());
+        return "aot_datum(" + std::to_string(data.size() - 1) + ")";
+    }
+
+    const Definition *lookup(const std::string &name) const {
+        auto it = known.find(name);
+        return it == known.end() ? nullptr : it->second;
+    }
+};
+
+bool Emitter::constant(ExprBase *e, std::string &out) {
+    if (Fixnum *n = dynamic_cast<Fixnum *>(e)) {
+        out = "IntegerV(" + std::to_string(n->n) + ")";
+    } else if (isa<True>(e)) {
+        out = "BooleanV(true)";
+    } else if (isa<False>(e)) {
+        out = "BooleanV(false)";
+    } else if (isa<MakeVoid>(e)) {
+        out = "VoidV()";
+    } else if (Literal *literal = dynamic_cast<Literal *>(e)) {
+        if (!literal->value) throw Unsupported();   // 求值时才报错的引用
+        out = t.constant(*literal->value);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string Emitter::variable(Var *var) {
+    if (var->depth < 0) {
+        std::string v = temp();
+        line() << "Value " << v << " = aot_global(" << t.cell(var->x) << ");\n";
+        return v;
+    }
+    if (var->boxed || var->depth >= static_cast<int>(frames.size())) throw Unsupported();
+    const std::vector<std::string> &frame = frames[frames.size() - 1 - var->depth];
+    if (var->index >= static_cast<int>(frame.size())) throw Unsupported();
+    return frame[var->index];
+}
+
+std::string Emitter::primitive(ExprBase *e) {
+    const NodeClass *c = nullptr;
+    for (const NodeClass &nc : node_classes) {
+        if (nc.test(e)) {
+            c = &nc;
+            break;
+        }
+    }
+    if (c == nullptr) throw Unsupported();
+    std::vector<std::string> args;
+    std::string call;
+    if (Unary *u = dynamic_cast<Unary *>(e)) {
+        args.push_back(value(u->rand));
+        call = c->helper ? c->helper : std::string("aot_unary<") + c->name + ">";
+    } else if (Binary *b = dynamic_cast<Binary *>(e)) {
+        args.push_back(value(b->rand1));
+        args.push_back(value(b->rand2));
+        call = c->helper ? c->helper : std::string("aot_binary<") + c->name + ">";
+    } else {
+        for (const Expr &rand : static_cast<Variadic *>(e)->rands) {
+            args.push_back(value(rand));
+        }
+        call = std::string("aot_variadic<") + c->name + ">";
+        args = {"{" + join(args) + "}"};
+    }
+    std::string v = temp();
+    line() << "Value " << v << " = " << call << "(" << join(args) << ");\n";
+    return v;
+}
+
+bool Emitter::structured(ExprBase *e) {
+    return isa<If>(e) || isa<Begin>(e) || isa<Cond>(e) || isa<AndVar>(e) || isa<OrVar>(e) || isa<Let>(e) ||
+           isa<Apply>(e);
+}
+
+std::string Emitter::value(const Expr &expr) {
+    ExprBase *e = expr.get();
+    if (e == nullptr) throw Unsupported();
+    std::string out;
+    if (constant(e, out)) return out;
+    if (Var *var = dynamic_cast<Var *>(e)) return variable(var);
+    if (!structured(e)) return primitive(e);
+    out = temp();
+    line() << "Value " << out << "(nullptr);\n";
+    emit(expr, out);
+    return out;
+}
+
+void Emitter::emit(const Expr &expr, const std::string &dest) {
+    ExprBase *e = expr.get();
+    if (e == nullptr) throw Unsupported();
+    if (If *i = dynamic_cast<If *>(e)) {
+        emitIf(i, dest);
+    } else if (Begin *b = dynamic_cast<Begin *>(e)) {
+        emitBegin(b, dest);
+    } else if (Cond *c = dynamic_cast<Cond *>(e)) {
+        emitCond(c, dest);
+    } else if (AndVar *a = dynamic_cast<AndVar *>(e)) {
+        emitAnd(a, dest);
+    } else if (OrVar *o = dynamic_cast<OrVar *>(e)) {
+        emitOr(o, dest);
+    } else if (Let *l = dynamic_cast<Let *>(e)) {
+        emitLet(l, dest);
+    } else if (Apply *a = dynamic_cast<Apply *>(e)) {
+        emitApply(a, dest);
+    } else {
+        finish(value(expr), dest);
+    }
+}
+
+void Emitter::branch(const Expr &expr, const std::string &dest) {
+    ++indent;
+    if (expr.get() == nullptr) {
+        finish("VoidV()", dest);
+    } else {
+        emit(expr, dest);
+    }
+    --indent;
+}
+
+// es[from..] 依次求值，结果为最后一个
+void Emitter::sequence(const std::vector<Expr> &es, size_t from, const std::string &dest) {
+    for (size_t i = from; i + 1 < es.size(); ++i) value(es[i]);
+    emit(es.back(), dest);
+}
+
+void Emitter::close(int blocks) {
+    while (blocks-- > 0) {
+        --indent;
+        line() << "}\n";
+    }
+}
+
+void Emitter::emitIf(If *e, const std::string &dest) {
+    std::string cond = value(e->cond);
+    line() << "if (!" << cond << ".isFalse()) {\n";
+    branch(e->conseq, dest);
+    line() << "} else {\n";
+    branch(e->alter, dest);
+    line() << "}\n";
+}
+
+void Emitter::emitBegin(Begin *e, const std::string &dest) {
+    std::vector<Expr> es;
+    for (const Expr &sub : e->es) {
+        if (sub.get() == nullptr) continue;
+        if (isa<Define>(sub.get())) throw Unsupported();
+        es.push_back(sub);
+    }
+    if (es.empty()) {
+        finish("VoidV()", dest);
+    } else {
+        sequence(es, 0, dest);
+    }
+}
+
+// 与 Cond::eval 相同：名为 else 的变量开头的子句总是被选中
+void Emitter::emitCond(Cond *e, const std::string &dest) {
+    int blocks = 0;
+    for (const auto &clause : e->clauses) {
+        if (clause.empty()) throw Unsupported();
+        Var *head = dynamic_cast<Var *>(clause[0].get());
+        if (head != nullptr && head->x == "else") {
+            if (clause.size() == 1) {
+                finish("VoidV()", dest);
+            } else {
+                sequence(clause, 1, dest);
+            }
+            close(blocks);
+            return;
+        }
+        std::string pred = value(clause[0]);
+        line() << "if (!" << pred << ".isFalse()) {\n";
+        ++indent;
+        if (clause.size() == 1) {
+            finish(pred, dest);
+        } else {
+            sequence(clause, 1, dest);
+        }
+        --indent;
+        line() << "} else {\n";
+        ++indent;
+        ++blocks;
+    }
+    finish("VoidV()", dest);
+    close(blocks);
+}
+
+void Emitter::emitAnd(AndVar *e, const std::string &dest) {
+    if (e->rands.empty()) {
+        finish("BooleanV(true)", dest);
+        return;
+    }
+    int blocks = 0;
+    for (size_t i = 0; i + 1 < e->rands.size(); ++i) {
+        std::string v = value(e->rands[i]);
+        line() << "if (" << v << ".isFalse()) {\n";
+        ++indent;
+        finish("BooleanV(false)", dest);
+        --indent;
+        line() << "} else {\n";
+        ++indent;
+        ++blocks;
+    }
+    finish(value(e->rands.back()), dest);
+    close(blocks);
+}
+
+void Emitter::emitOr(OrVar *e, const std::string &dest) {
+    int blocks = 0;
+    for (const Expr &rand : e->rands) {
+        std::string v = value(rand);
+        line() << "if (!" << v << ".isFalse()) {\n";
+        ++indent;
+        finish(v, dest);
+        --indent;
+        line() << "} else {\n";
+        ++indent;
+        ++blocks;
+    }
+    finish("BooleanV(false)", dest);
+    close(blocks);
+}
+
+void Emitter::emitLet(Let *e, const std::string &dest) {
+    if (!e->boxed.empty() || e->frame_size != static_cast<int>(e->bind.size())) throw Unsupported();
+    std::vector<std::string> values;
+    for (const auto &binding : e->bind) {
+        if (!valid_name(binding.first)) throw Unsupported();
+        values.push_back(value(binding.second));
+    }
+    line() << "{\n";
+    ++indent;
+    std::vector<std::string> slots;
+    for (const std::string &v : values) {
+        std::string local = temp();
+        line() << "Value " << local << " = " << v << ";\n";
+        slots.push_back(local);
+    }
+    frames.push_back(slots);
+    emit(e->body, dest);
+    frames.pop_back();
+    close(1);
+}
+
+// 先求值函数再求值实参，与 Apply::eval 的顺序和报错一致
+void Emitter::emitApply(Apply *e, const std::string &dest) {
+    Var *global = dynamic_cast<Var *>(e->rator.get());
+    if (global != nullptr && global->depth >= 0) global = nullptr;
+    std::string f = value(e->rator);
+    line() << "aot_callable(" << f << ");\n";
+    std::vector<std::string> args;
+    for (const Expr &rand : e->rand) {
+        args.push_back(value(rand));
+    }
+    std::string generic = "aot_apply(" + f + ", {" + join(args) + "})";
+    const Definition *callee = global ? t.lookup(global->x) : nullptr;
+    if (callee == nullptr || callee->info->x.size() != args.size()) {
+        finish(generic, dest);
+        return;
+    }
+    if (callee == &def && dest.empty()) {
+        // 尾位置的自调用：改写参数后跳回函数开头
+        line() << "if (aot_is(" << f << ", " << def.entry() << ")) {\n";
+        ++indent;
+        for (size_t i = 0; i < args.size(); ++i) {
+            line() << "Value n" << i << " = " << args[i] << ";\n";
+        }
+        for (size_t i = 0; i < args.size(); ++i) {
+            line() << "s" << i << " = std::move(n" << i << ");\n";
+        }
+        line() << "goto top;\n";
+        --indent;
+        line() << "}\n";
+        looped = true;
+        finish(generic, dest);
+        return;
+    }
+    finish("aot_is(" + f + ", " + callee->entry() + ") ? " + callee->function() + "(" + join(args) + ") : " + generic,
+           dest);
+}
+
+std::string Emitter::run() {
+    const LambdaInfo &info = *def.info;
+    // 顶层 lambda 没有自由的局部变量；内部 define 与装箱的槽位留给解释器
+    if (!info.captures.empty() || !info.boxed.empty() || info.frame_size != static_cast<int>(info.x.size())) {
+        throw Unsupported();
+    }
+    std::vector<std::string> params;
+    for (size_t i = 0; i < info.x.size(); ++i) {
+        params.push_back("s" + std::to_string(i));
+    }
+    frames.push_back(params);
+    emit(info.e, "");
+
+    std::vector<std::string> decls, slots;
+    for (size_t i = 0; i < params.size(); ++i) {
+        decls.push_back("Value " + params[i]);
+        slots.push_back("frame->slots[" + std::to_string(i) + "]");
+    }
+    std::ostringstream out;
+    out << "// " << def.name << "\n";
+    out << "Value " << def.function() << "(" << join(decls) << ") {\n";
+    if (looped) out << "top:\n";
+    out << body.str() << "}\n\n";
+    out << "Value " << def.entry() << "(Frame *" << (params.empty() ? "" : "frame") << ") {\n";
+    out << "    return " << def.function() << "(" << join(slots) << ");\n";
+    out << "}\n";
+    return out.str();
+}
+
+// 与 REPL 相同地逐个读入、解析并折叠顶层形式，记下其中定义 lambda 的 define
+void Translator::read(const std::string &source) {
+    Reader reader(source);
+    Scope global_scope(nullptr);
+    SyntaxArena arena;
+    for (int form = 0; ; ++form) {
+        if (readEnd(reader)) break;
+        arena.clear();
+        Syntax stx = readSyntax(reader, arena);
+        try {
+            Expr expr = optimize(stx->parse(global_scope));
+            Define *def = dynamic_cast<Define *>(expr.get());
+            if (def == nullptr || def->index >= 0) continue;
+            Lambda *lambda = dynamic_cast<Lambda *>(def->e.get());
+            if (lambda == nullptr) continue;
+            defs.push_back({form, def->var, lambda->info, ""});
+        } catch (const RuntimeError &) {
+            // 解析出错的形式运行时照样报错
+        }
+    }
+}
+
+void Translator::translate() {
+    // 一个函数体能否翻译与它调用的其他 lambda 是否翻译无关：先逐个试译，
+    // 再按最终的集合重新生成，使直接调用只指向确实翻译了的函数
+    std::vector<Definition> translated;
+    for (const Definition &def : defs) {
+        known[def.name] = &def;
+    }
+    for (const Definition &def : defs) {
+        try {
+            Emitter(*this, def).run();
+            translated.push_back(def);
+        } catch (const Unsupported &) {
+        }
+    }
+    defs = translated;
+    known.clear();
+    cells.clear();
+    cell_names.clear();
+    data.clear();
+    for (const Definition &def : defs) {
+        known[def.name] = &def;
+    }
+    for (Definition &def : defs) {
+        def.code = Emitter(*this, def).run();
+    }
+}
+
+void Translator::write(std::ostream &os, const std::string &name, const std::string &source) const {
+    os << "// Generated by scmc from " << name << ". The program runs on the interpreter\n"
+       << "// with the lambdas below attached as native code (see aot_runtime.hpp).\n\n"
+       << "#include \"aot_runtime.hpp\"\n\n"
+       << "namespace {\n\n";
+    for (size_t i = 0; i < cell_names.size(); ++i) {
+        os << "GlobalCell *c" << i << ";   // " << cell_names[i] << "\n";
+    }
+    if (!cell_names.empty()) os << "\n";
+    for (const Definition &def : defs) {
+        std::vector<std::string> decls(def.info->x.size(), "Value");
+        os << "Value " << def.function() << "(" << join(decls) << ");\n";
+        os << "Value " << def.entry() << "(Frame *);\n";
+    }
+    if (!defs.empty()) os << "\n";
+    for (const Definition &def : defs) {
+        os << def.code << "\n";
+    }
+
+    os << "const char source[] =";
+    size_t start = 0;
+    while (start < source.size()) {
+        size_t end = source.find('\n', start);
+        end = end == std::string::npos ? source.size() : end + 1;
+        os << "\n    " << quote(source.substr(start, end - start));
+        start = end;
+    }
+    if (source.empty()) os << " \"\"";
+    os << ";\n\n";
+
+    os << "const char *const data[] = {\n";
+    for (const std::string &d : data) {
+        os << "    " << quote(d) << ",\n";
+    }
+    os << "    nullptr\n};\n\n";
+
+    os << "const AotLambda lambdas[] = {\n";
+    for (const Definition &def : defs) {
+        os << "    {" << def.form << ", " << def.info->x.size() << ", " << def.entry() << "},   // " << def.name << "\n";
+    }
+    os << "    {-1, 0, nullptr}\n};\n\n"
+       << "} // namespace\n\n"
+       << "int main(int argc, char *argv[]) {\n";
+    for (size_t i = 0; i < cell_names.size(); ++i) {
+        os << "    c" << i << " = aot_cell(" << quote(cell_names[i]) << ");\n";
+    }
+    os << "    return aot_main(argc, argv, source, lambdas, data);\n"
+       << "}\n";
+}
+
+} // namespace
+
+int aot_translate(std::istream &in, std::ostream &out, const std::string &name) {
+    std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    Translator t;
+    t.read(source);
+    t.translate();
+    t.write(out, name, source);
+    return t.defs.size();
+}
@@ -0,0 +1,33 @@
+#ifndef AOT_HPP
+#define AOT_HPP
+
+/**
+ * @file aot.hpp
+ * @brief Ahead-of-time translation of a Scheme program to C++ (scmc)
+ *
+ * The program is parsed and constant-folded form by form exactly as the
+ * read-eval-print loop does. Every top-level (define name (lambda ...))
+ * whose body stays inside what the translator covers becomes a C++
+ * function: parameters and let variables are C++ locals, primitives call
+ * the inline fast paths of aot_runtime.hpp, calls of other translated
+ * globals are direct C++ calls guarded by the closure the name holds, and
+ * a self call in tail position is a loop. Nested lambdas, letrec, set!,
+ * internal defines and boxed variables keep a lambda interpreted.
+ *
+ * The output embeds the whole source and runs it with aot_main, so forms
+ * that were not translated still run, in order, on the interpreter, and
+ * the output is the interpreter's.
+ */
+
+#include <istream>
+#include <ostream>
+#include <string>
+
+/**
+ * @brief Translate a Scheme program into a C++ program to be linked with scheme_runtime
+ * @param name Name of the source, shown in the generated header comment
+ * @return Number of lambdas translated to C++
+ */
+int aot_translate(std::istream &, std::ostream &, const std::string &name);
+
+#endif // AOT_HPP
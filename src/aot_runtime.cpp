@@ -0,0 +1,104 @@
+/**
+ * @file aot_runtime.cpp
+ * @brief Runtime support of programs generated by scmc (see aot_runtime.hpp)
+ */
+
+#include "aot_runtime.hpp"
+#include "syntax.hpp"
+#include "reader.hpp"
+#include "jit.hpp"
+#include "repl.hpp"
+#include <cstring>
+#include <sys/resource.h>
+
+extern GlobalEnv global_env;
+Value apply_primitive(Primitive *, const Value *, int);
+Value finish_tail_calls(Value);
+Value syntax_to_quoted_value(const Syntax &);
+
+uintptr_t aot_stack_limit = 0;
+std::vector<Value> *aot_data = nullptr;
+
+namespace {
+
+const uintptr_t DEFAULT_STACK = 8 << 20;        // 栈大小不受限制时按 8 MiB 计算
+
+const AotLambda *aot_lambdas = nullptr;
+
+// 在 define 求值之前把本地函数体挂到它的 lambda 上；形式对不上（不应发生）时保持解释执行
+void attach(int form, const Expr &expr) {
+    for (const AotLambda *l = aot_lambdas; l->entry != nullptr; ++l) {
+        if (l->form != form) continue;
+        Define *def = dynamic_cast<Define *>(expr.get());
+        if (def == nullptr || def->index >= 0) continue;
+        Lambda *lambda = dynamic_cast<Lambda *>(def->e.get());
+        if (lambda == nullptr || static_cast<int>(lambda->info->x.size()) != l->arity) continue;
+        lambda->info->aot = l->entry;
+    }
+}
+
+uintptr_t stack_size() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_STACK, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) return DEFAULT_STACK;
+    return limit.rlim_cur;
+}
+
+} // namespace
+
+GlobalCell *aot_cell(const std::string &name) {
+    return global_env.cell(name);
+}
+
+Value aot_global_slow(GlobalCell *cell) {
+    Var var(cell->name);
+    Env env(nullptr);
+    return var.eval(env);
+}
+
+void aot_not_callable() {
+    throw RuntimeError("Attempt to apply a non-procedure");
+}
+
+Value aot_apply(const Value &f, std::initializer_list<Value> args) {
+    aot_callable(f);
+    if (f.type() == V_PRIMITIVE) {
+        return apply_primitive(static_cast<Primitive *>(f.get()), args.begin(), args.size());
+    }
+    Procedure *proc = static_cast<Procedure *>(f.get());
+    const LambdaInfo &info = *proc->info;
+    if (args.size() != info.x.size()) {
+        throw RuntimeError("Wrong number of arguments for lambda");
+    }
+    Env frame(new Frame(info.frame_size, proc->env));
+    int i = 0;
+    for (const Value &arg : args) frame->slots[i++] = arg;
+    box_slots(frame.get(), info.boxed);
+    if (info.aot != nullptr && !aot_stack_low()) return info.aot(frame.get());
+    return finish_tail_calls(info.e->eval(frame));
+}
+
+int aot_main(int argc, char *argv[], const char *source, const AotLambda *lambdas, const char *const *data) {
+    static const AotLambda none = {-1, 0, nullptr};
+    aot_lambdas = lambdas;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--no-aot") == 0) aot_lambdas = &none;
+        if (strcmp(argv[i], "--no-jit") == 0) jit_options.enabled = false;
+    }
+    // 本地代码最多用一半的栈，另一半留给接着执行的解释器
+    aot_stack_limit = reinterpret_cast<uintptr_t>(__builtin_frame_address(0)) - stack_size() / 2;
+
+    // 不随程序退出析构：其中的值可能引用已销毁的全局对象
+    aot_data = new std::vector<Value>();
+    SyntaxArena arena;
+    for (const char *const *d = data; *d != nullptr; ++d) {
+        Reader in(*d, strlen(*d));
+        aot_data->push_back(syntax_to_quoted_value(readSyntax(in, arena)));
+        arena.clear();
+    }
+
+    ReplOptions opts;
+    opts.prepare = attach;
+    Reader in(source, strlen(source));
+    REPL(in, opts);
+    return 0;
+}
@@ -0,0 +1,163 @@
+#ifndef AOT_RUNTIME_HPP
+#define AOT_RUNTIME_HPP
+
+/**
+ * @file aot_runtime.hpp
+ * @brief Runtime support of the C++ programs generated by scmc (see aot.hpp)
+ *
+ * A generated program embeds the Scheme source and runs it through the
+ * usual read-eval-print loop; the lambdas scmc could translate are attached
+ * to their LambdaInfo as native entries before their define is evaluated,
+ * so every call of them, from the interpreter or from other native code,
+ * runs the C++ body. The helpers below are what those bodies are made of:
+ * fixnum fast paths that fall back to the interpreter's evalRator, global
+ * lookups through cached cells and a generic apply.
+ */
+
+#include "value.hpp"
+#include "number.hpp"
+#include "RE.hpp"
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A lambda translated by scmc
+ */
+struct AotLambda {
+    int form;        ///< Top-level form (counted from 0) that defines it
+    int arity;       ///< Number of parameters
+    AotEntry entry;  ///< Native body; nullptr ends the table
+};
+
+/**
+ * @brief Run a generated program: its source, translated lambdas and quoted data
+ *
+ * --no-aot ignores the translated lambdas and interprets everything,
+ * --no-jit is passed on to the interpreter.
+ */
+int aot_main(int argc, char *argv[], const char *source, const AotLambda *lambdas, const char *const *data);
+
+extern uintptr_t aot_stack_limit;   ///< Native calls are interpreted once the stack gets below this
+extern std::vector<Value> *aot_data;   ///< Quoted data used by native bodies, built by aot_main
+
+// 本地代码的调用链过深时改由解释器继续（解释器的尾调用不占用 C++ 栈）
+inline bool aot_stack_low() {
+    return reinterpret_cast<uintptr_t>(__builtin_frame_address(0)) < aot_stack_limit;
+}
+
+GlobalCell *aot_cell(const std::string &);
+Value aot_global_slow(GlobalCell *);
+[[noreturn]] void aot_not_callable();
+Value aot_apply(const Value &, std::initializer_list<Value>);
+
+inline const Value &aot_datum(int i) {
+    return (*aot_data)[i];
+}
+
+inline Value aot_global(GlobalCell *cell) {
+    if (!cell->v.empty()) return cell->v;
+    return aot_global_slow(cell);   // 未定义的名字或内置函数：按 Var::eval 处理
+}
+
+inline void aot_callable(const Value &f) {
+    ValueBase *p = f.get();
+    if (p == nullptr || (p->v_type != V_PROC && p->v_type != V_PRIMITIVE)) aot_not_callable();
+}
+
+/**
+ * @brief Whether f is a closure of the translated lambda with this entry
+ *
+ * Call sites of a translated lambda call its C++ function directly when
+ * this holds, and go through aot_apply otherwise (the name was redefined,
+ * or the stack is too deep for more native frames).
+ */
+inline bool aot_is(const Value &f, AotEntry entry) {
+    ValueBase *p = f.get();
+    return p != nullptr && p->v_type == V_PROC && static_cast<Procedure *>(p)->info->aot == entry &&
+           !aot_stack_low();
+}
+
+// ============================================================================
+// Primitives: the interpreter's evalRator on one prototype node per class
+// ============================================================================
+
+template <class Node>
+Value aot_unary(const Value &a) {
+    static Node node{Expr(nullptr)};
+    return node.Node::evalRator(a);
+}
+
+template <class Node>
+Value aot_binary(const Value &a, const Value &b) {
+    static Node node{Expr(nullptr), Expr(nullptr)};
+    return node.Node::evalRator(a, b);
+}
+
+template <class Node>
+Value aot_variadic(std::initializer_list<Value> args) {
+    static Node node{std::vector<Expr>()};
+    return node.Node::evalRator(args.begin(), args.size());
+}
+
+inline Value aot_add(const Value &a, const Value &b) {
+    int n;
+    if (a.isFixnum() && b.isFixnum() && !__builtin_add_overflow(a.fixnum(), b.fixnum(), &n)) return IntegerV(n);
+    return num_add(a, b);
+}
+
+inline Value aot_sub(const Value &a, const Value &b) {
+    int n;
+    if (a.isFixnum() && b.isFixnum() && !__builtin_sub_overflow(a.fixnum(), b.fixnum(), &n)) return IntegerV(n);
+    return num_sub(a, b);
+}
+
+inline Value aot_mul(const Value &a, const Value &b) {
+    int n;
+    if (a.isFixnum() && b.isFixnum() && !__builtin_mul_overflow(a.fixnum(), b.fixnum(), &n)) return IntegerV(n);
+    return num_mul(a, b);
+}
+
+template <class Compare, class Node>
+Value aot_compare(const Value &a, const Value &b) {
+    if (a.isFixnum() && b.isFixnum()) return BooleanV(Compare()(a.fixnum(), b.fixnum()));
+    return aot_binary<Node>(a, b);
+}
+
+inline Value aot_car(const Value &a) {
+    ValueBase *p = a.get();
+    if (p != nullptr && p->v_type == V_PAIR) return static_cast<Pair *>(p)->car;
+    return aot_unary<Car>(a);
+}
+
+inline Value aot_cdr(const Value &a) {
+    ValueBase *p = a.get();
+    if (p != nullptr && p->v_type == V_PAIR) return static_cast<Pair *>(p)->cdr;
+    return aot_unary<Cdr>(a);
+}
+
+inline Value aot_cons(const Value &a, const Value &b) {
+    return PairV(a, b);
+}
+
+inline Value aot_eq(const Value &a, const Value &b) {
+    if (a.w == b.w) return BooleanV(true);
+    return aot_binary<IsEq>(a, b);   // 符号按名字比较
+}
+
+inline Value aot_not(const Value &a) {
+    return BooleanV(a.isFalse());
+}
+
+inline Value aot_is_null(const Value &a) {
+    return BooleanV(a.w == Value::NULL_WORD);
+}
+
+inline Value aot_is_pair(const Value &a) {
+    ValueBase *p = a.get();
+    return BooleanV(p != nullptr && p->v_type == V_PAIR);
+}
+
+#endif // AOT_RUNTIME_HPP
@@ -0,0 +1,354 @@
+/**
+ * @file bigint.cpp
+ * @brief Magnitude arithmetic for BigInt: schoolbook and Karatsuba
+ *        multiplication, Knuth's long division, decimal conversion
+ */
+
+#include "bigint.hpp"
+#include <algorithm>
+
+namespace {
+
+typedef std::vector<uint32_t> Limbs;
+
+const uint64_t LIMB_BASE = 1ULL << 32;
+const uint32_t DECIMAL_CHUNK = 1000000000;   // 10^9，十进制转换时每次处理 9 位
+const int DECIMAL_DIGITS = 9;
+// 两个操作数都至少有这么多个 limb 时才使用 Karatsuba，更小时 schoolbook 更快
+const size_t KARATSUBA_THRESHOLD = 32;
+
+void trim(Limbs &x) {
+    while (!x.empty() && x.back() == 0) x.pop_back();
+}
+
+int compare_mag(const Limbs &a, const Limbs &b) {
+    if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+    for (size_t i = a.size(); i-- > 0;) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+Limbs add_mag(const Limbs &a, const Limbs &b) {
+    const Limbs &longer = a.size() >= b.size() ? a : b;
+    const Limbs &shorter = a.size() >= b.size() ? b : a;
+    Limbs r(longer.size() + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < longer.size(); ++i) {
+        uint64_t s = static_cast<uint64_t>(longer[i]) + (i < shorter.size() ? shorter[i] : 0) + carry;
+        r[i] = static_cast<uint32_t>(s);
+        carry = s >> 32;
+    }
+    r[longer.size()] = static_cast<uint32_t>(carry);
+    trim(r);
+    return r;
+}
+
+// 要求 a >= b
+Limbs sub_mag(const Limbs &a, const Limbs &b) {
+    Limbs r(a.size());
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        int64_t d = static_cast<int64_t>(a[i]) - (i < b.size() ? b[i] : 0) - borrow;
+        borrow = d < 0 ? 1 : 0;
+        r[i] = static_cast<uint32_t>(d);
+    }
+    trim(r);
+    return r;
+}
+
+// r[offset..] += x，r 需足够长
+void add_into(Limbs &r, const Limbs &x, size_t offset) {
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < x.size(); ++i) {
+        uint64_t s = static_cast<uint64_t>(r[offset + i]) + x[i] + carry;
+        r[offset + i] = static_cast<uint32_t>(s);
+        carry = s >> 32;
+    }
+    for (; carry != 0; ++i) {
+        uint64_t s = static_cast<uint64_t>(r[offset + i]) + carry;
+        r[offset + i] = static_cast<uint32_t>(s);
+        carry = s >> 32;
+    }
+}
+
+Limbs mul_schoolbook(const Limbs &a, const Limbs &b) {
+    if (a.empty() || b.empty()) return Limbs();
+    Limbs r(a.size() + b.size(), 0);
+    for (size_t i = 0; i < a.size(); ++i) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < b.size(); ++j) {
+            uint64_t t = static_cast<uint64_t>(a[i]) * b[j] + r[i + j] + carry;
+            r[i + j] = static_cast<uint32_t>(t);
+            carry = t >> 32;
+        }
+        r[i + b.size()] = static_cast<uint32_t>(carry);
+    }
+    trim(r);
+    return r;
+}
+
+Limbs low_half(const Limbs &x, size_t m) {
+    Limbs r(x.begin(), x.begin() + std::min(m, x.size()));
+    trim(r);
+    return r;
+}
+
+Limbs high_half(const Limbs &x, size_t m) {
+    if (x.size() <= m) return Limbs();
+    return Limbs(x.begin() + m, x.end());
+}
+
+// Karatsuba：a = a1·B^m + a0，b = b1·B^m + b0，
+// a·b = z2·B^2m + ((a0+a1)(b0+b1) - z2 - z0)·B^m + z0，三次递归乘法代替四次
+Limbs mul_mag(const Limbs &a, const Limbs &b) {
+    if (a.size() < KARATSUBA_THRESHOLD || b.size() < KARATSUBA_THRESHOLD) {
+        return mul_schoolbook(a, b);
+    }
+    size_t m = std::max(a.size(), b.size()) / 2;
+    Limbs a0 = low_half(a, m), a1 = high_half(a, m);
+    Limbs b0 = low_half(b, m), b1 = high_half(b, m);
+    Limbs z0 = mul_mag(a0, b0);
+    Limbs z2 = mul_mag(a1, b1);
+    Limbs z1 = sub_mag(sub_mag(mul_mag(add_mag(a0, a1), add_mag(b0, b1)), z0), z2);
+
+    Limbs r(a.size() + b.size() + 1, 0);
+    add_into(r, z0, 0);
+    add_into(r, z1, m);
+    add_into(r, z2, 2 * m);
+    trim(r);
+    return r;
+}
+
+// x = x * factor + addend
+void mul_small_add(Limbs &x, uint32_t factor, uint32_t addend) {
+    uint64_t carry = addend;
+    for (size_t i = 0; i < x.size(); ++i) {
+        uint64_t t = static_cast<uint64_t>(x[i]) * factor + carry;
+        x[i] = static_cast<uint32_t>(t);
+        carry = t >> 32;
+    }
+    if (carry != 0) x.push_back(static_cast<uint32_t>(carry));
+}
+
+// x /= divisor，返回余数
+uint32_t div_small(Limbs &x, uint32_t divisor) {
+    uint64_t rem = 0;
+    for (size_t i = x.size(); i-- > 0;) {
+        uint64_t cur = (rem << 32) | x[i];
+        x[i] = static_cast<uint32_t>(cur / divisor);
+        rem = cur % divisor;
+    }
+    trim(x);
+    return static_cast<uint32_t>(rem);
+}
+
+// 左移 shift (0..31) 位，结果固定多出一个 limb 以容纳溢出部分
+Limbs shift_left(const Limbs &x, int shift) {
+    Limbs r(x.size() + 1, 0);
+    for (size_t i = 0; i < x.size(); ++i) {
+        uint64_t t = static_cast<uint64_t>(x[i]) << shift;
+        r[i] |= static_cast<uint32_t>(t);
+        r[i + 1] = static_cast<uint32_t>(t >> 32);
+    }
+    return r;
+}
+
+// Knuth, TAOCP vol. 2, 4.3.1 算法 D：v 至少两个 limb 且 u >= v
+void divmod_mag(const Limbs &u, const Limbs &v, Limbs &q, Limbs &r) {
+    int shift = __builtin_clz(v.back());
+    Limbs vn = shift_left(v, shift);
+    vn.pop_back();   // 规格化后最高 limb 不会溢出
+    Limbs un = shift_left(u, shift);
+    size_t n = vn.size(), m = un.size() - n;
+    q.assign(m, 0);
+
+    for (size_t j = m; j-- > 0;) {
+        uint64_t num = (static_cast<uint64_t>(un[j + n]) << 32) | un[j + n - 1];
+        uint64_t qhat = num / vn[n - 1];
+        uint64_t rhat = num % vn[n - 1];
+        while (qhat >= LIMB_BASE || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2])) {
+            --qhat;
+            rhat += vn[n - 1];
+            if (rhat >= LIMB_BASE) break;
+        }
+
+        // un[j..j+n] -= qhat * vn
+        int64_t borrow = 0;
+        uint64_t carry = 0;
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t p = qhat * vn[i] + carry;
+            carry = p >> 32;
+            int64_t t = static_cast<int64_t>(un[i + j]) - static_cast<int64_t>(p & 0xffffffffu) - borrow;
+            un[i + j] = static_cast<uint32_t>(t);
+            borrow = t < 0 ? 1 : 0;
+        }
+        int64_t t = static_cast<int64_t>(un[j + n]) - static_cast<int64_t>(carry) - borrow;
+        un[j + n] = static_cast<uint32_t>(t);
+
+        if (t < 0) {
+            // qhat 多估了一，加回一个除数
+            --qhat;
+            uint64_t c = 0;
+            for (size_t i = 0; i < n; ++i) {
+                uint64_t s = static_cast<uint64_t>(un[i + j]) + vn[i] + c;
+                un[i + j] = static_cast<uint32_t>(s);
+                c = s >> 32;
+            }
+            un[j + n] += static_cast<uint32_t>(c);
+        }
+        q[j] = static_cast<uint32_t>(qhat);
+    }
+    trim(q);
+
+    r.assign(n, 0);
+    for (size_t i = 0; i < n; ++i) {
+        r[i] = shift == 0 ? un[i] : (un[i] >> shift) | (un[i + 1] << (32 - shift));
+    }
+    trim(r);
+}
+
+BigInt make(bool neg, Limbs mag) {
+    BigInt r;
+    r.mag.swap(mag);
+    r.neg = neg && !r.mag.empty();
+    return r;
+}
+
+} // namespace
+
+BigInt::BigInt() : neg(false) {}
+
+BigInt::BigInt(long long v) : neg(v < 0) {
+    // 先转为无符号再取负，LLONG_MIN 也不会溢出
+    unsigned long long m = neg ? 0ULL - static_cast<unsigned long long>(v) : static_cast<unsigned long long>(v);
+    while (m != 0) {
+        mag.push_back(static_cast<uint32_t>(m));
+        m >>= 32;
+    }
+}
+
+bool BigInt::fitsInt() const {
+    if (mag.size() > 1) return false;
+    if (mag.empty()) return true;
+    return neg ? mag[0] <= 0x80000000u : mag[0] <= 0x7fffffffu;
+}
+
+int BigInt::toInt() const {
+    if (mag.empty()) return 0;
+    return neg ? static_cast<int>(0u - mag[0]) : static_cast<int>(mag[0]);
+}
+
+bool BigInt::fitsLong() const {
+    if (mag.size() > 2) return false;
+    uint64_t m = 0;
+    for (size_t i = mag.size(); i-- > 0;) m = (m << 32) | mag[i];
+    return neg ? m <= (1ULL << 63) : m < (1ULL << 63);
+}
+
+long long BigInt::toLong() const {
+    uint64_t m = 0;
+    for (size_t i = mag.size(); i-- > 0;) m = (m << 32) | mag[i];
+    return neg ? static_cast<long long>(0ULL - m) : static_cast<long long>(m);
+}
+
+std::string BigInt::toString() const {
+    if (mag.empty()) return "0";
+    Limbs x = mag;
+    std::vector<uint32_t> chunks;
+    while (!x.empty()) {
+        chunks.push_back(div_small(x, DECIMAL_CHUNK));
+    }
+    std::string s = neg ? "-" : "";
+    s += std::to_string(chunks.back());
+    for (size_t i = chunks.size() - 1; i-- > 0;) {
+        std::string part = std::to_string(chunks[i]);
+        s.append(DECIMAL_DIGITS - part.size(), '0');
+        s += part;
+    }
+    return s;
+}
+
+bool BigInt::parse(const std::string &s, BigInt &out) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < s.size() && (s[i] == '+' || s[i] == '-')) {
+        negative = s[i] == '-';
+        ++i;
+    }
+    if (i == s.size()) return false;
+    Limbs mag;
+    while (i < s.size()) {
+        // 每次吸收至多 9 位十进制数字
+        uint32_t chunk = 0, scale = 1;
+        for (int k = 0; k < DECIMAL_DIGITS && i < s.size(); ++k, ++i) {
+            if (s[i] < '0' || s[i] > '9') return false;
+            chunk = chunk * 10 + (s[i] - '0');
+            scale *= 10;
+        }
+        mul_small_add(mag, scale, chunk);
+    }
+    trim(mag);
+    out = make(negative, mag);
+    return true;
+}
+
+void BigInt::divmod(const BigInt &a, const BigInt &b, BigInt &q, BigInt &r) {
+    Limbs qm, rm;
+    if (compare_mag(a.mag, b.mag) < 0) {
+        rm = a.mag;
+    } else if (b.mag.size() == 1) {
+        qm = a.mag;
+        uint32_t rem = div_small(qm, b.mag[0]);
+        if (rem != 0) rm.push_back(rem);
+    } else {
+        divmod_mag(a.mag, b.mag, qm, rm);
+    }
+    q = make(a.neg != b.neg, qm);
+    r = make(a.neg, rm);
+}
+
+BigInt BigInt::gcd(BigInt a, BigInt b) {
+    a.neg = b.neg = false;
+    while (!b.isZero()) {
+        BigInt q, r;
+        divmod(a, b, q, r);
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+BigInt operator-(const BigInt &a) {
+    return make(!a.neg, a.mag);
+}
+
+BigInt operator+(const BigInt &a, const BigInt &b) {
+    if (a.neg == b.neg) return make(a.neg, add_mag(a.mag, b.mag));
+    // 异号相加：大减小，符号随绝对值较大者
+    if (compare_mag(a.mag, b.mag) >= 0) return make(a.neg, sub_mag(a.mag, b.mag));
+    return make(b.neg, sub_mag(b.mag, a.mag));
+}
+
+BigInt operator-(const BigInt &a, const BigInt &b) {
+    return a + (-b);
+}
+
+BigInt operator*(const BigInt &a, const BigInt &b) {
+    return make(a.neg != b.neg, mul_mag(a.mag, b.mag));
+}
+
+bool operator==(const BigInt &a, const BigInt &b) {
+    return a.neg == b.neg && a.mag == b.mag;
+}
+
+bool operator!=(const BigInt &a, const BigInt &b) {
+    return !(a == b);
+}
+
+int compare(const BigInt &a, const BigInt &b) {
+    if (a.neg != b.neg) return a.neg ? -1 : 1;
+    int c = compare_mag(a.mag, b.mag);
+    return a.neg ? -c : c;
+}
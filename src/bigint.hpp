@@ -0,0 +1,58 @@
+#ifndef BIGINT_HPP
+#define BIGINT_HPP
+
+/**
+ * @file bigint.hpp
+ * @brief Arbitrary-precision signed integers
+ *
+ * Only results that overflow a fixnum are ever stored as a BigInt (see
+ * number.cpp), so this type is off the common small-number path. The
+ * magnitude is kept as little-endian 32-bit limbs without leading zero
+ * limbs; zero has no limbs and is never negative.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct BigInt {
+    bool neg;                     ///< Sign, false for zero
+    std::vector<uint32_t> mag;    ///< Magnitude, least significant limb first
+
+    BigInt();
+    BigInt(long long);
+
+    bool isZero() const { return mag.empty(); }
+    bool fitsInt() const;
+    int toInt() const;
+    bool fitsLong() const;
+    long long toLong() const;
+    std::string toString() const;
+
+    /**
+     * @brief Parse an optionally signed decimal literal
+     * @return false if the text is not an integer
+     */
+    static bool parse(const std::string &, BigInt &);
+
+    /**
+     * @brief Truncating division: the quotient rounds toward zero and the
+     *        remainder takes the sign of the dividend
+     */
+    static void divmod(const BigInt &, const BigInt &, BigInt &, BigInt &);
+    static BigInt gcd(BigInt, BigInt);
+};
+
+BigInt operator-(const BigInt &);
+BigInt operator+(const BigInt &, const BigInt &);
+BigInt operator-(const BigInt &, const BigInt &);
+BigInt operator*(const BigInt &, const BigInt &);
+bool operator==(const BigInt &, const BigInt &);
+bool operator!=(const BigInt &, const BigInt &);
+
+/**
+ * @brief Three-way comparison, returns -1, 0 or 1
+ */
+int compare(const BigInt &, const BigInt &);
+
+#endif // BIGINT_HPP
@@ -0,0 +1,75 @@
+#ifndef BYTECODE
+#define BYTECODE
+
+/**
+ * @file bytecode.hpp
+ * @brief Bytecode compiler and stack VM for the Scheme interpreter
+ *
+ * This is an alternative execution engine to ExprBase::eval. compile()
+ * lowers a parsed Expr tree into a Chunk of int-coded instructions and
+ * vm_eval() runs it with a computed-goto dispatch loop. The VM uses the
+ * same Frame environments and Procedure values as the tree walker, so
+ * closures created by either engine can be called by the other, and node
+ * kinds that are not lowered are executed through ExprBase::eval.
+ */
+
+#include "Def.hpp"
+#include "expr.hpp"
+#include "value.hpp"
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Instruction set; operands follow the opcode in Chunk::code
+ */
+enum OpCode {
+    OP_CONST,      // k           push consts[k]
+    OP_EVAL,       // n           push nodes[n]->eval(env)
+    OP_LOCAL0,     // i n         push env->slots[i]
+    OP_LOCAL,      // d i n       push slot i of the frame d levels up
+    OP_BOXED,      // d i n       push the variable boxed in slot i of the frame d levels up
+    OP_GLOBAL,     // n           push value of global Var nodes[n]
+    OP_SET_CHECK,  // n           fail unless Set nodes[n] targets a bound variable
+    OP_SET,        // n           pop value into Set nodes[n]'s variable, push void
+    OP_DEF_CHECK,  // n           check name of Define nodes[n], bind it to void
+    OP_DEF_VOID,   // n           bind Define nodes[n] to void (begin pre-binding)
+    OP_DEF_SET,    // n           pop value into Define nodes[n]'s binding, push void
+    OP_POP,        //             drop top of stack
+    OP_JUMP,       // pc          unconditional jump
+    OP_JUMP_FALSE, // pc          pop, jump if #f
+    OP_JUMP_FALSE_KEEP, // pc     jump keeping top if #f, else pop
+    OP_JUMP_TRUE_KEEP,  // pc     jump keeping top unless #f, else pop
+    OP_UNARY,      // n           top = nodes[n]->evalRator(top)
+    OP_BINARY,     // n           pop 2, push nodes[n]->evalRator(a, b)
+    OP_VARIADIC,   // n c         pop c, push nodes[n]->evalRator(args)
+    OP_CLOSURE,    // n           push closure of Lambda nodes[n]
+    OP_LET,        // s c         pop c values into the first slots of a new frame of size s
+    OP_LETREC,     // s c         new frame of size s whose first c slots are void
+    OP_STORE0,     // i           pop into env->slots[i] (or the Box it holds)
+    OP_BOX,        // i           wrap env->slots[i] in a Box
+    OP_END_LET,    //             restore the frame saved by OP_LET/OP_LETREC
+    OP_CHECK_PROC, //             fail unless top is a procedure
+    OP_CALL,       // c           call with c arguments
+    OP_TAIL_CALL,  // c           call with c arguments, replacing the current call
+    OP_RETURN,     //             return top to the caller
+    OP_HALT,       //             end of a top-level chunk
+    OP_COUNT
+};
+
+/**
+ * @brief Compiled code of one lambda body or one top-level form
+ *
+ * nodes are borrowed from the Expr tree, which the owner of the chunk
+ * (the REPL, a Lambda node or a Procedure's body) keeps alive.
+ */
+struct Chunk {
+    std::vector<int> code;
+    std::vector<Value> consts;
+    std::vector<ExprBase *> nodes;
+};
+
+std::shared_ptr<Chunk> compile(const Expr &);
+std::shared_ptr<Chunk> compile_body(const Expr &);
+Value vm_eval(const Expr &, Env &);
+
+#endif // BYTECODE
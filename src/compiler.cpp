@@ -0,0 +1,364 @@
+/**
+ * @file compiler.cpp
+ * @brief Lowering of parsed Expr trees into bytecode for the stack VM
+ *
+ * Every expression leaves exactly one value on the operand stack. Forms
+ * whose evaluation has checks that only ExprBase::eval implements (quote,
+ * exit, let with unusual variable names, ...) are emitted as OP_EVAL.
+ */
+
+#include "bytecode.hpp"
+#include "RE.hpp"
+#include <cctype>
+
+namespace {
+
+// Let::eval / Letrec::eval reject these names at runtime; leave them to the tree walker
+bool is_checked_name(const std::string &var) {
+    if (var.empty()) return false;
+    char first = var[0];
+    if (isdigit(static_cast<unsigned char>(first)) || first == '.' || first == '@') return false;
+    for (char c : var) {
+        if (c == '#' || c == '\'' || c == '"' || c == '`' || isspace(static_cast<unsigned char>(c))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_else_clause(const std::vector<Expr> &clause) {
+    Var *var = dynamic_cast<Var *>(clause[0].get());
+    return var != nullptr && var->x == "else";
+}
+
+class Compiler {
+    Chunk &chunk;
+
+    void emit(int word) { chunk.code.push_back(word); }
+
+    int node(ExprBase *e) {
+        chunk.nodes.push_back(e);
+        return chunk.nodes.size() - 1;
+    }
+
+    int constant(const Value &v) {
+        chunk.consts.push_back(v);
+        return chunk.consts.size() - 1;
+    }
+
+    // emits a jump with an unresolved target, returns the operand position
+    int jump(int op) {
+        emit(op);
+        emit(-1);
+        return chunk.code.size() - 1;
+    }
+
+    void patch(int pos) { chunk.code[pos] = chunk.code.size(); }
+
+    void fallback(ExprBase *e) {
+        emit(OP_EVAL);
+        emit(node(e));
+    }
+
+    void compileVar(Var *var) {
+        if (var->boxed) {
+            emit(OP_BOXED);
+            emit(var->depth);
+            emit(var->index);
+        } else if (var->depth == 0) {
+            emit(OP_LOCAL0);
+            emit(var->index);
+        } else if (var->depth > 0) {
+            emit(OP_LOCAL);
+            emit(var->depth);
+            emit(var->index);
+        } else {
+            emit(OP_GLOBAL);
+            emit(node(var));
+            return;
+        }
+        emit(node(var));
+    }
+
+    void compileBegin(Begin *begin, bool tail) {
+        for (const auto &expr : begin->es) {
+            if (auto *def = dynamic_cast<Define *>(expr.get())) {
+                emit(OP_DEF_VOID);
+                emit(node(def));
+            }
+        }
+        bool first = true;
+        for (size_t i = 0; i < begin->es.size(); ++i) {
+            ExprBase *expr = begin->es[i].get();
+            if (!expr) continue;
+            if (!first) emit(OP_POP);
+            first = false;
+            if (auto *def = dynamic_cast<Define *>(expr)) {
+                compile(def->e.get(), false);
+                emit(OP_DEF_SET);
+                emit(node(def));
+            } else {
+                compile(expr, tail && i + 1 == begin->es.size());
+            }
+        }
+        if (first) {
+            emit(OP_CONST);
+            emit(constant(VoidV()));
+        }
+    }
+
+    void compileCond(Cond *cond, bool tail) {
+        for (const auto &clause : cond->clauses) {
+            if (clause.empty()) {
+                fallback(cond);
+                return;
+            }
+        }
+        std::vector<int> exits;
+        for (const auto &clause : cond->clauses) {
+            if (is_else_clause(clause) && clause.size() == 1) {
+                emit(OP_CONST);
+                emit(constant(VoidV()));
+                exits.push_back(jump(OP_JUMP));
+                continue;
+            }
+            int next = -1;
+            if (!is_else_clause(clause)) {
+                compile(clause[0].get(), false);
+                if (clause.size() == 1) {
+                    exits.push_back(jump(OP_JUMP_TRUE_KEEP));
+                    continue;
+                }
+                next = jump(OP_JUMP_FALSE);
+            }
+            for (size_t j = 1; j < clause.size(); ++j) {
+                if (j > 1) emit(OP_POP);
+                compile(clause[j].get(), tail && j + 1 == clause.size());
+            }
+            exits.push_back(jump(OP_JUMP));
+            if (next >= 0) patch(next);
+        }
+        emit(OP_CONST);
+        emit(constant(VoidV()));
+        for (int pos : exits) patch(pos);
+    }
+
+    void compileApply(Apply *apply, bool tail) {
+        compile(apply->rator.get(), false);
+        emit(OP_CHECK_PROC);
+        for (const auto &arg : apply->rand) {
+            compile(arg.get(), false);
+        }
+        emit(tail ? OP_TAIL_CALL : OP_CALL);
+        emit(apply->rand.size());
+    }
+
+    void boxSlots(const std::vector<int> &slots) {
+        for (int i : slots) {
+            emit(OP_BOX);
+            emit(i);
+        }
+    }
+
+    void compileLambda(Lambda *lambda) {
+        if (!lambda->info->code) {
+            lambda->info->code = compile_body(lambda->info->e);
+        }
+        emit(OP_CLOSURE);
+        emit(node(lambda));
+    }
+
+    void compileLet(Let *let, bool tail) {
+        for (const auto &binding : let->bind) {
+            if (!is_checked_name(binding.first)) {
+                fallback(let);
+                return;
+            }
+        }
+        for (const auto &binding : let->bind) {
+            compile(binding.second.get(), false);
+        }
+        emit(OP_LET);
+        emit(let->frame_size);
+        emit(let->bind.size());
+        boxSlots(let->boxed);
+        compile(let->body.get(), tail);
+        emit(OP_END_LET);
+    }
+
+    void compileLetrec(Letrec *letrec, bool tail) {
+        for (const auto &binding : letrec->bind) {
+            if (!is_checked_name(binding.first)) {
+                fallback(letrec);
+                return;
+            }
+        }
+        emit(OP_LETREC);
+        emit(letrec->frame_size);
+        emit(letrec->bind.size());
+        boxSlots(letrec->boxed);
+        for (size_t k = 0; k < letrec->bind.size(); ++k) {
+            compile(letrec->bind[k].second.get(), false);
+            emit(OP_STORE0);
+            emit(k);
+        }
+        compile(letrec->body.get(), tail);
+        emit(OP_END_LET);
+    }
+
+    void compileAnd(AndVar *e, bool tail) {
+        if (e->rands.empty()) {
+            emit(OP_CONST);
+            emit(constant(BooleanV(true)));
+            return;
+        }
+        std::vector<int> exits;
+        for (size_t i = 0; i + 1 < e->rands.size(); ++i) {
+            compile(e->rands[i].get(), false);
+            exits.push_back(jump(OP_JUMP_FALSE_KEEP));
+        }
+        compile(e->rands.back().get(), tail);
+        for (int pos : exits) patch(pos);
+    }
+
+    void compileOr(OrVar *e, bool tail) {
+        if (e->rands.empty()) {
+            emit(OP_CONST);
+            emit(constant(BooleanV(false)));
+            return;
+        }
+        std::vector<int> exits;
+        for (size_t i = 0; i + 1 < e->rands.size(); ++i) {
+            compile(e->rands[i].get(), false);
+            exits.push_back(jump(OP_JUMP_TRUE_KEEP));
+        }
+        compile(e->rands.back().get(), tail);
+        for (int pos : exits) patch(pos);
+    }
+
+public:
+    explicit Compiler(Chunk &c) : chunk(c) {}
+
+    void compile(ExprBase *e, bool tail) {
+        switch (e->e_type) {
+            case E_FIXNUM:
+                emit(OP_CONST);
+                emit(constant(IntegerV(static_cast<Fixnum *>(e)->n)));
+                return;
+            case E_TRUE:
+            case E_FALSE:
+                emit(OP_CONST);
+                emit(constant(BooleanV(e->e_type == E_TRUE)));
+                return;
+            case E_VAR:
+                compileVar(static_cast<Var *>(e));
+                return;
+            case E_SET: {
+                Set *set = static_cast<Set *>(e);
+                int n = node(set);
+                emit(OP_SET_CHECK);
+                emit(n);
+                compile(set->e.get(), false);
+                emit(OP_SET);
+                emit(n);
+                return;
+            }
+            case E_DEFINE: {
+                Define *def = static_cast<Define *>(e);
+                int n = node(def);
+                emit(OP_DEF_CHECK);
+                emit(n);
+                compile(def->e.get(), false);
+                emit(OP_DEF_SET);
+                emit(n);
+                return;
+            }
+            case E_IF: {
+                If *ife = static_cast<If *>(e);
+                compile(ife->cond.get(), false);
+                int to_alter = jump(OP_JUMP_FALSE);
+                compile(ife->conseq.get(), tail);
+                int to_end = jump(OP_JUMP);
+                patch(to_alter);
+                compile(ife->alter.get(), tail);
+                patch(to_end);
+                return;
+            }
+            case E_COND:
+                compileCond(static_cast<Cond *>(e), tail);
+                return;
+            case E_BEGIN:
+                compileBegin(static_cast<Begin *>(e), tail);
+                return;
+            case E_LET:
+                compileLet(static_cast<Let *>(e), tail);
+                return;
+            case E_LETREC:
+                compileLetrec(static_cast<Letrec *>(e), tail);
+                return;
+            case E_LAMBDA:
+                compileLambda(static_cast<Lambda *>(e));
+                return;
+            case E_APPLY:
+                compileApply(static_cast<Apply *>(e), tail);
+                return;
+            case E_AND:
+                compileAnd(static_cast<AndVar *>(e), tail);
+                return;
+            case E_OR:
+                compileOr(static_cast<OrVar *>(e), tail);
+                return;
+            default:
+                break;
+        }
+        Literal *lit = dynamic_cast<Literal *>(e);
+        if (e->e_type == E_VOID && dynamic_cast<MakeVoid *>(e)) {
+            emit(OP_CONST);
+            emit(constant(VoidV()));
+        } else if (lit != nullptr && lit->value) {
+            emit(OP_CONST);
+            emit(constant(*lit->value));
+        } else if (auto *u = dynamic_cast<Unary *>(e)) {
+            compile(u->rand.get(), false);
+            emit(OP_UNARY);
+            emit(node(u));
+        } else if (auto *b = dynamic_cast<Binary *>(e)) {
+            compile(b->rand1.get(), false);
+            compile(b->rand2.get(), false);
+            emit(OP_BINARY);
+            emit(node(b));
+        } else if (auto *v = dynamic_cast<Variadic *>(e)) {
+            for (const auto &rand : v->rands) {
+                compile(rand.get(), false);
+            }
+            emit(OP_VARIADIC);
+            emit(node(v));
+            emit(v->rands.size());
+        } else {
+            // exit, and quote of a datum the parser could not convert
+            fallback(e);
+        }
+    }
+};
+
+} // namespace
+
+/**
+ * @brief Compile a top-level form; the chunk ends with OP_HALT
+ */
+std::shared_ptr<Chunk> compile(const Expr &expr) {
+    std::shared_ptr<Chunk> chunk(new Chunk());
+    Compiler(*chunk).compile(expr.get(), false);
+    chunk->code.push_back(OP_HALT);
+    return chunk;
+}
+
+/**
+ * @brief Compile a lambda body; its last expression is in tail position
+ */
+std::shared_ptr<Chunk> compile_body(const Expr &body) {
+    std::shared_ptr<Chunk> chunk(new Chunk());
+    Compiler(*chunk).compile(body.get(), true);
+    chunk->code.push_back(OP_RETURN);
+    return chunk;
+}
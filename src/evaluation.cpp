@@ -9,60 +9,77 @@
  */
 
 #include "value.hpp"
+#include "number.hpp"
 #include "expr.hpp"
 #include "RE.hpp"
 #include "syntax.hpp"
+#include "jit.hpp"
+#include "aot_runtime.hpp"
+#include "output.hpp"
+#include "printer.hpp"
 #include <cstring>
 #include <vector>
 #include <map>
 #include <climits>
+#include <functional>
 
 extern std::map<std::string, ExprType> primitives;
 extern std::map<std::string, ExprType> reserved_words;
-extern Assoc global_env;
+extern GlobalEnv global_env;
 
-Value Fixnum::eval(Assoc &e) { // evaluation of a fixnum
+Value Fixnum::eval(Env &e) { // evaluation of a fixnum
     return IntegerV(n);
 }
 
-Value RationalNum::eval(Assoc &e) { // evaluation of a rational number
-    return RationalV(numerator, denominator);
+Value RationalNum::eval(Env &e) { // evaluation of a rational number
+    return *value;
 }
 
-Value StringExpr::eval(Assoc &e) { // evaluation of a string
-    return StringV(s);
+Value BignumLiteral::eval(Env &e) { // evaluation of an integer literal beyond int
+    return *value;
 }
 
-Value True::eval(Assoc &e) { // evaluation of #t
+Value StringExpr::eval(Env &e) { // evaluation of a string
+    return *value;
+}
+
+Value Constant::eval(Env &e) { // evaluation of a folded constant
+    return *value;
+}
+
+Value True::eval(Env &e) { // evaluation of #t
     return BooleanV(true);
 }
 
-Value False::eval(Assoc &e) { // evaluation of #f
+Value False::eval(Env &e) { // evaluation of #f
     return BooleanV(false);
 }
 
-Value MakeVoid::eval(Assoc &e) { // (void)
+Value MakeVoid::eval(Env &e) { // (void)
     return VoidV();
 }
 
-Value Exit::eval(Assoc &e) { // (exit)
+Value Exit::eval(Env &e) { // (exit)
     return TerminateV();
 }
 
-Value Unary::eval(Assoc &e) { // evaluation of single-operator primitive
+Value Unary::eval(Env &e) { // evaluation of single-operator primitive
     return evalRator(rand->eval(e));
 }
 
-Value Binary::eval(Assoc &e) { // evaluation of two-operators primitive
-    return evalRator(rand1->eval(e), rand2->eval(e));
+Value Binary::eval(Env &e) { // evaluation of two-operators primitive
+    // 显式按从左到右的顺序求值（函数实参的求值顺序是未指定的）
+    Value v1 = rand1->eval(e);
+    Value v2 = rand2->eval(e);
+    return evalRator(v1, v2);
 }
 
-Value Variadic::eval(Assoc &e) { // evaluation of multi-operator primitive
-    std::vector<Value> args;
-    for (int i = 0; i < rands.size(); i++) {
-        args.push_back(rands[i]->eval(e));
+Value Variadic::eval(Env &e) { // evaluation of multi-operator primitive
+    StackArgs args(rands.size());   // 实参放在值栈上
+    for (size_t i = 0; i < rands.size(); i++) {
+        args.slots[i] = rands[i]->eval(e);
     }
-    return evalRator(args);
+    return evalRator(args.slots, rands.size());
     //TODO: To complete the substraction logic
 }
 
@@ -76,7 +93,113 @@ bool is_integer(const std::string& s) {
     return true;
 }
 
-Value Var::eval(Assoc &e) { // evaluation of variable
+// 内置函数作为值：启动时为每个内置函数分配一个 Primitive，Var 求值时直接取出；
+// 调用时经 fn 把参数数组交给求值节点的 evalRator（限定名调用，不再经过虚表）
+namespace {
+
+template <class Node>
+Value apply_unary(ExprBase *node, const Value *args, int) {
+    return static_cast<Node *>(node)->Node::evalRator(args[0]);
+}
+
+template <class Node>
+Value apply_binary(ExprBase *node, const Value *args, int) {
+    return static_cast<Node *>(node)->Node::evalRator(args[0], args[1]);
+}
+
+template <class Node>
+Value apply_variadic(ExprBase *node, const Value *args, int argc) {
+    return static_cast<Node *>(node)->Node::evalRator(args, argc);
+}
+
+Value apply_void(ExprBase *, const Value *, int) {
+    return VoidV();
+}
+
+Value apply_exit(ExprBase *, const Value *, int) {
+    return TerminateV();
+}
+
+template <class Node>
+std::pair<const std::string, Value> unary_primitive(const std::string &name) {
+    return {name, PrimitiveV(name, apply_unary<Node>, Expr(new Node(Expr(nullptr))), 1, 1)};
+}
+
+template <class Node>
+std::pair<const std::string, Value> binary_primitive(const std::string &name) {
+    return {name, PrimitiveV(name, apply_binary<Node>, Expr(new Node(Expr(nullptr), Expr(nullptr))), 2, 2)};
+}
+
+template <class Node>
+std::pair<const std::string, Value> variadic_primitive(const std::string &name, int min_args) {
+    return {name, PrimitiveV(name, apply_variadic<Node>, Expr(new Node(std::vector<Expr>())), min_args, -1)};
+}
+
+// and / or 是特殊形式，不能作为值使用
+std::map<std::string, Value> primitive_values = {
+    {"void", PrimitiveV("void", apply_void, Expr(nullptr), 0, 0)},
+    {"exit", PrimitiveV("exit", apply_exit, Expr(nullptr), 0, 0)},
+    variadic_primitive<PlusVar>("+", 0),
+    variadic_primitive<MinusVar>("-", 1),
+    variadic_primitive<MultVar>("*", 0),
+    variadic_primitive<DivVar>("/", 1),
+    binary_primitive<Modulo>("modulo"),
+    binary_primitive<Expt>("expt"),
+    variadic_primitive<LessVar>("<", 0),
+    variadic_primitive<LessEqVar>("<=", 0),
+    variadic_primitive<EqualVar>("=", 0),
+    variadic_primitive<GreaterEqVar>(">=", 0),
+    variadic_primitive<GreaterVar>(">", 0),
+    binary_primitive<Cons>("cons"),
+    unary_primitive<Car>("car"),
+    unary_primitive<Cdr>("cdr"),
+    variadic_primitive<ListFunc>("list", 0),
+    binary_primitive<SetCar>("set-car!"),
+    binary_primitive<SetCdr>("set-cdr!"),
+    unary_primitive<Not>("not"),
+    binary_primitive<IsEq>("eq?"),
+    unary_primitive<IsBoolean>("boolean?"),
+    unary_primitive<IsFixnum>("number?"),
+    unary_primitive<IsNull>("null?"),
+    unary_primitive<IsPair>("pair?"),
+    unary_primitive<IsProcedure>("procedure?"),
+    unary_primitive<IsSymbol>("symbol?"),
+    unary_primitive<IsList>("list?"),
+    unary_primitive<IsString>("string?"),
+    unary_primitive<Display>("display"),
+};
+
+} // namespace
+
+/**
+ * @brief Apply a built-in procedure after checking its arity
+ */
+Value apply_primitive(Primitive *prim, const Value *args, int argc) {
+    if (argc < prim->min_args || (prim->max_args >= 0 && argc > prim->max_args)) {
+        throw RuntimeError("Wrong number of arguments for " + prim->name);
+    }
+    return prim->fn(prim->node.get(), args, argc);
+}
+
+Value Var::eval(Env &e) { // evaluation of variable
+    if (depth >= 0) {
+        // 词法寻址：解析阶段已确定 (depth, index)
+        Value &slot = lookup(e, depth, index);
+        Value &v = boxed ? unbox(slot) : slot;
+        if (v.empty()) {
+            throw RuntimeError("Undefined variable: " + x);
+        }
+        return v;
+    }
+    if (cell != nullptr && !cell->v.empty()) {
+        // 全局变量：首次查找后缓存绑定单元，之后只需一次读取
+        return cell->v;
+    }
+    // 内置函数名不能被 define，作为值使用时直接返回启动时分配的 Primitive
+    auto prim = primitive_values.find(x);
+    if (prim != primitive_values.end()) {
+        return prim->second;
+    }
 	if(x.empty()){
 		throw RuntimeError("an block?what a fuckerman you are!! GRRRRRRRRRRRR");
 	}
@@ -114,62 +237,16 @@ Value Var::eval(Assoc &e) { // evaluation of variable
         }
     }
 
-    Value matched_value = find(x, e);
-	if (matched_value.get()!=nullptr) {
-		return matched_value;
-	}
-
-    // 解决相互递归和 REPL 定义可见性问题
-    if (e.get() != global_env.get()) {
-        matched_value = find(x, global_env);
-        if (matched_value.get() != nullptr) {
-            return matched_value;
-        }
+    // 局部变量都已在解析阶段寻址，这里只需查全局环境
+    if (cell == nullptr) {
+        cell = global_env.cell(x);
     }
+	if (!cell->v.empty()) {
+		return cell->v;
+	}
 
-    else if (matched_value.get() == nullptr) {
-        static std::map<ExprType, std::pair<Expr, std::vector<std::string>>> primitive_map = {
-            {E_VOID,     {new MakeVoid(), {}}},
-            {E_EXIT,     {new Exit(), {}}},
-            {E_BOOLQ,    {new IsBoolean(new Var("parm")), {}}},
-            {E_INTQ,     {new IsFixnum(new Var("parm")), {}}},
-            {E_NULLQ,    {new IsNull(new Var("parm")), {}}},
-            {E_PAIRQ,    {new IsPair(new Var("parm")), {}}},
-            {E_PROCQ,    {new IsProcedure(new Var("parm")), {}}},
-            {E_SYMBOLQ,  {new IsSymbol(new Var("parm")), {}}},
-            {E_STRINGQ,  {new IsString(new Var("parm")), {}}},
-            {E_DISPLAY,  {new Display(new Var("parm")), {}}},
-            {E_PLUS,     {new PlusVar({}),  {}}},
-            {E_MINUS,    {new MinusVar({}), {}}},
-            {E_MUL,      {new MultVar({}),  {}}},
-            {E_DIV,      {new DivVar({}),   {}}},
-            {E_MODULO,   {new Modulo(new Var("parm1"), new Var("parm2")), {}}},
-            {E_EXPT,     {new Expt(new Var("parm1"), new Var("parm2")), {}}},
-            {E_LT,       {new LessVar({}), {}}},
-            {E_LE,       {new LessEqVar({}), {}}},
-            {E_GT,       {new GreaterVar({}), {}}},
-            {E_GE,       {new GreaterEqVar({}), {}}},
-            {E_EQ,       {new EqualVar({}), {}}},
-            {E_EQQ,      {new IsEq(new Var("a"), new Var("b")), {}}},
-            {E_NOT,      {new Not(new Var("p")), {}}},
-            {E_CONS,     {new Cons(new Var("a"), new Var("b")), {}}},
-            {E_CAR,      {new Car(new Var("p")), {}}},
-            {E_CDR,      {new Cdr(new Var("p")), {}}},
-            {E_LIST,     {new ListFunc({}), {}}},
-            {E_SETCAR,   {new SetCar(new Var("p"), new Var("v")), {}}},
-            {E_SETCDR,   {new SetCdr(new Var("p"), new Var("v")), {}}}
-        };
-        if (primitives.count(x)) {
-            auto it = primitive_map.find(primitives[x]);
-            //TOD0:to PASS THE parameters correctly;
-            //COMPLETE THE CODE WITH THE HINT IN IF SENTENCE WITH CORRECT RETURN VALUE
-            if (it != primitive_map.end()) {
-                return ProcedureV(it->second.second, it->second.first, empty());
-            };
-        }
-        if (x == "else") {
-            return SymbolV("else");
-        }
+    if (x == "else") {
+        return SymbolV("else");
     }
     #ifndef ONLINE_JUDGE
         // std::cout<<"Undefined variable: "<<x<<std::endl;
@@ -177,491 +254,250 @@ Value Var::eval(Assoc &e) { // evaluation of variable
     throw RuntimeError("Undefined variable: " + x);
 }
 
+// 自特化的数值节点：记录见到的操作数类型，两个 fixnum 时内联计算，不再经过虚调用和分派表
+namespace {
 
-Value Plus::evalRator(const Value &rand1, const Value &rand2) { // +
-    //TODO: To complete the addition logic
-    if (rand1->v_type != V_INT && rand1->v_type != V_RATIONAL) {
-        throw(RuntimeError("Wrong typename"));
-    }
-    // 检查第二个参数是否为数字
-    if (rand2->v_type != V_INT && rand2->v_type != V_RATIONAL) {
-        throw(RuntimeError("Wrong typename"));
-    }
-    // 类型正确，执行加法（省略具体计算逻辑）
-    // 提取第一个参数的分子和分母（整数视为 "n/1"）
-    int num1, den1;
-    if (rand1->v_type == V_INT) {
-        num1 = dynamic_cast<Integer*>(rand1.get())->n;  // 整数的分子是其值
-        den1 = 1;                                      // 整数的分母是 1
-    } else {
-        num1 = dynamic_cast<Rational*>(rand1.get())->numerator;
-        den1 = dynamic_cast<Rational*>(rand1.get())->denominator;
+/**
+ * @brief Shared eval of the self-specializing arithmetic and comparison nodes
+ *
+ * Fast::fix computes the result for two fixnums and returns false when it
+ * does not fit in one; that case (and every non-fixnum operand once the
+ * guard has failed) goes through evalRator and the numeric kernels.
+ */
+template <class Fast>
+Value specialized_eval(Binary *node, Env &e) {
+    Value v1 = node->rand1->eval(e);
+    Value v2 = node->rand2->eval(e);
+    bool fixnums = v1.isFixnum() && v2.isFixnum();
+    if (node->spec == SPEC_UNINIT) {
+        node->spec = fixnums ? SPEC_FIXNUM : SPEC_GENERIC;
+    }
+    if (node->spec == SPEC_FIXNUM) {
+        if (fixnums) {
+            Value result(nullptr);
+            if (Fast::fix(v1.fixnum(), v2.fixnum(), result)) return result;
+            // 溢出只是值越界，类型没变，保持特化
+        } else {
+            node->spec = SPEC_GENERIC;  // 守卫失败：退回通用路径
+        }
     }
+    return node->evalRator(v1, v2);
+}
 
-    // 提取第二个参数的分子和分母
-    int num2, den2;
-    if (rand2->v_type == V_INT) {
-        num2 = dynamic_cast<Integer*>(rand2.get())->n;
-        den2 = 1;
-    } else {
-        num2 = dynamic_cast<Rational*>(rand2.get())->numerator;
-        den2 = dynamic_cast<Rational*>(rand2.get())->denominator;
+struct FixAdd {
+    static bool fix(int a, int b, Value &r) {
+        int n;
+        if (__builtin_add_overflow(a, b, &n)) return false;
+        r = IntegerV(n);
+        return true;
     }
+};
 
-    // 计算加法：num1/den1 + num2/den2 = (num1*den2 + num2*den1) / (den1*den2)
-    int new_num = num1 * den2 + num2 * den1;
-    int new_den = den1 * den2;
-    //约分
-
-    //WARNING：不需要约分，Rational 的构造函数里写了
-
-    // int common_divisor = gcd(abs(new_num), abs(new_den));
-    // if (common_divisor != 0) {
-    //     new_num /= common_divisor;
-    //     new_den /= common_divisor;
-    // }
-
-    // 确保分母为正数（约定：分数的分母始终为正）
-    if (new_den < 0) {
-        new_num *= -1;
-        new_den *= -1;
+struct FixSub {
+    static bool fix(int a, int b, Value &r) {
+        int n;
+        if (__builtin_sub_overflow(a, b, &n)) return false;
+        r = IntegerV(n);
+        return true;
     }
+};
 
-    // 结果为整数时返回 IntegerV，否则返回 RationalV
-    if (new_den == 1) {
-        return IntegerV(new_num);
-    } else {
-        return RationalV(new_num, new_den);
+struct FixMul {
+    static bool fix(int a, int b, Value &r) {
+        int n;
+        if (__builtin_mul_overflow(a, b, &n)) return false;
+        r = IntegerV(n);
+        return true;
     }
-}
+};
 
-Value Minus::evalRator(const Value &rand1, const Value &rand2) {
-    if (rand1->v_type != V_INT && rand1->v_type != V_RATIONAL) {
-        throw(RuntimeError("Wrong typename"));
-    }
-    if (rand2->v_type != V_INT && rand2->v_type != V_RATIONAL) {
-        throw(RuntimeError("Wrong typename"));
-    }
-    int num1, den1;
-    if (rand1->v_type == V_INT) {
-        num1 = dynamic_cast<Integer*>(rand1.get())->n;  // 整数的分子是其值
-        den1 = 1;                                      // 整数的分母是 1
-    } else {
-        num1 = dynamic_cast<Rational*>(rand1.get())->numerator;
-        den1 = dynamic_cast<Rational*>(rand1.get())->denominator;
-    }
-    int num2, den2;
-    if (rand2->v_type == V_INT) {
-        num2 = dynamic_cast<Integer*>(rand2.get())->n;
-        den2 = 1;
-    } else {
-        num2 = dynamic_cast<Rational*>(rand2.get())->numerator;
-        den2 = dynamic_cast<Rational*>(rand2.get())->denominator;
+template <class Compare>
+struct FixCompare {
+    static bool fix(int a, int b, Value &r) {
+        r = BooleanV(Compare()(a, b));
+        return true;
     }
+};
 
-    // 计算减法：num1/den1 + num2/den2 = (num1*den2 - num2*den1) / (den1*den2)
-    int new_num = num1 * den2 - num2 * den1;
-    int new_den = den1 * den2;
-    //约分
-    // int common_divisor = gcd(abs(new_num), abs(new_den));
-    // if (common_divisor != 0) {
-    //     new_num /= common_divisor;
-    //     new_den /= common_divisor;
-    // }
+} // namespace
 
-    // 确保分母为正数（约定：分数的分母始终为正）
-    if (new_den < 0) {
-        new_num *= -1;
-        new_den *= -1;
-    }
+Value Plus::eval(Env &e) {
+    return specialized_eval<FixAdd>(this, e);
+}
 
-    // 结果为整数时返回 IntegerV，否则返回 RationalV
-    if (new_den == 1) {
-        return IntegerV(new_num);
-    } else {
-        return RationalV(new_num, new_den);
-    }
-    //TODO: To complete the substraction logic
+Value Minus::eval(Env &e) {
+    return specialized_eval<FixSub>(this, e);
 }
 
-Value Mult::evalRator(const Value &rand1, const Value &rand2) { // *
-    if (rand1->v_type != V_INT && rand1->v_type != V_RATIONAL) {
-        throw(RuntimeError("Wrong typename"));
-    }
-    if (rand2->v_type != V_INT && rand2->v_type != V_RATIONAL) {
-        throw(RuntimeError("Wrong typename"));
-    }
-    int num1, den1;
-    if (rand1->v_type == V_INT) {
-        num1 = dynamic_cast<Integer*>(rand1.get())->n;  // 整数的分子是其值
-        den1 = 1;                                      // 整数的分母是 1
-    } else {
-        num1 = dynamic_cast<Rational*>(rand1.get())->numerator;
-        den1 = dynamic_cast<Rational*>(rand1.get())->denominator;
-    }
-    int num2, den2;
-    if (rand2->v_type == V_INT) {
-        num2 = dynamic_cast<Integer*>(rand2.get())->n;
-        den2 = 1;
-    } else {
-        num2 = dynamic_cast<Rational*>(rand2.get())->numerator;
-        den2 = dynamic_cast<Rational*>(rand2.get())->denominator;
-    }
+Value Mult::eval(Env &e) {
+    return specialized_eval<FixMul>(this, e);
+}
 
-    // 计算乘法：num1/den1 * num2/den2
-    int new_num = num1 * num2;
-    int new_den = den1 * den2;
-    //约分
-    // int common_divisor = gcd(abs(new_num), abs(new_den));
-    // if (common_divisor != 0) {
-    //     new_num /= common_divisor;
-    //     new_den /= common_divisor;
-    // }
+Value Less::eval(Env &e) {
+    return specialized_eval<FixCompare<std::less<int>>>(this, e);
+}
 
-    // 确保分母为正数（约定：分数的分母始终为正）
-    if (new_den < 0) {
-        new_num *= -1;
-        new_den *= -1;
-    }
+Value LessEq::eval(Env &e) {
+    return specialized_eval<FixCompare<std::less_equal<int>>>(this, e);
+}
 
-    // 结果为整数时返回 IntegerV，否则返回 RationalV
-    if (new_den == 1) {
-        return IntegerV(new_num);
-    } else {
-        return RationalV(new_num, new_den);
-    }
-    //TODO: To complete the Multiplication logic
+Value Equal::eval(Env &e) {
+    return specialized_eval<FixCompare<std::equal_to<int>>>(this, e);
 }
 
-Value Div::evalRator(const Value &rand1, const Value &rand2) {
-    if (rand1->v_type != V_INT && rand1->v_type != V_RATIONAL) {
-        throw(RuntimeError("Wrong typename"));
-    }
-    if (rand2->v_type != V_INT && rand2->v_type != V_RATIONAL) {
-        throw(RuntimeError("Wrong typename"));
-    }
-    int num1, den1;
-    if (rand1->v_type == V_INT) {
-        num1 = dynamic_cast<Integer*>(rand1.get())->n;  // 整数的分子是其值
-        den1 = 1;                                      // 整数的分母是 1
-    } else {
-        num1 = dynamic_cast<Rational*>(rand1.get())->numerator;
-        den1 = dynamic_cast<Rational*>(rand1.get())->denominator;
-    }
-    int num2, den2;
-    if (rand2->v_type == V_INT) {
-        num2 = dynamic_cast<Integer*>(rand2.get())->n;
-        den2 = 1;
-    } else {
-        num2 = dynamic_cast<Rational*>(rand2.get())->numerator;
-        den2 = dynamic_cast<Rational*>(rand2.get())->denominator;
-    }
+Value GreaterEq::eval(Env &e) {
+    return specialized_eval<FixCompare<std::greater_equal<int>>>(this, e);
+}
 
-    if (num2 == 0) {
-        throw(RuntimeError("You are a fucker, can't div 0"));
-    }
+Value Greater::eval(Env &e) {
+    return specialized_eval<FixCompare<std::greater<int>>>(this, e);
+}
 
-    // 计算除法：num1/den1 / num2/den2
-    int new_num = num1 * den2;
-    int new_den = den1 * num2;
-    //约分
-    // int common_divisor = gcd(abs(new_num), abs(new_den));
-    // if (common_divisor != 0) {
-    //     new_num /= common_divisor;
-    //     new_den /= common_divisor;
-    // }
+Value Plus::evalRator(const Value &rand1, const Value &rand2) { // +
+    return num_add(rand1, rand2);
+}
 
-    // 确保分母为正数（约定：分数的分母始终为正）
-    if (new_den < 0) {
-        new_num *= -1;
-        new_den *= -1;
-    }
+Value Minus::evalRator(const Value &rand1, const Value &rand2) { // -
+    return num_sub(rand1, rand2);
+}
 
-    // 结果为整数时返回 IntegerV，否则返回 RationalV
-    if (new_den == 1) {
-        return IntegerV(new_num);
-    } else {
-        return RationalV(new_num, new_den);
-    }
-    //TODO: To complete the dicision logic
+Value Mult::evalRator(const Value &rand1, const Value &rand2) { // *
+    return num_mul(rand1, rand2);
+}
+
+Value Div::evalRator(const Value &rand1, const Value &rand2) { // /
+    return num_div(rand1, rand2);
 }
 
 Value Modulo::evalRator(const Value &rand1, const Value &rand2) { // modulo
-    if (rand1->v_type == V_INT && rand2->v_type == V_INT) {
-        int dividend = dynamic_cast<Integer*>(rand1.get())->n;
-        int divisor = dynamic_cast<Integer*>(rand2.get())->n;
-        if (divisor == 0) {
-            throw(RuntimeError("Division by zero"));
-        }
-        return IntegerV(dividend % divisor);
-    }
-    throw(RuntimeError("modulo is only defined for integers"));
+    return num_modulo(rand1, rand2);
 }
 
-Value PlusVar::evalRator(const std::vector<Value> &args) { // + with multiple args
-    if (args.empty()) {
-        return Value(new Integer(0)); // 空参数时返回 0（Scheme 约定）
+// 可变参数版本逐对调用 number.cpp 中的数值核心，不再构造临时的 Plus 等节点
+Value PlusVar::evalRator(const Value *args, int argc) { // + with multiple args
+    if (argc == 0) {
+        return IntegerV(0); // 空参数时返回 0（Scheme 约定）
+    }
+    if (!isNumber(args[0])) {
+        throw(RuntimeError("Wrong typename"));
     }
     Value sum = args[0];
-    for(int i = 1; i < args.size(); i++) {
-        sum = Plus(Expr(new PlusVar({})), Expr(new PlusVar({}))).evalRator(sum, args[i]);
+    for(int i = 1; i < argc; i++) {
+        sum = num_add(sum, args[i]);
     }
     return sum;
 }
 
-Value MinusVar::evalRator(const std::vector<Value> &args) { // - with multiple args
-    if (args.empty()) {
+Value MinusVar::evalRator(const Value *args, int argc) { // - with multiple args
+    if (argc == 0) {
         throw(RuntimeError("(-)→ RuntimeError")); // 空参数时返回 RuntimeError（Scheme 约定）
     }
-    if (args.size() == 1) {
-        return Minus(Expr(new MinusVar({})), Expr(new MinusVar({}))).evalRator(IntegerV(0), args[0]);
+    if (argc == 1) {
+        return num_sub(IntegerV(0), args[0]);
     }
     Value sum = args[0];
-    for(int i = 1; i < args.size(); i++) {
-        sum = Minus(Expr(new MinusVar({})), Expr(new MinusVar({}))).evalRator(sum, args[i]);
+    for(int i = 1; i < argc; i++) {
+        sum = num_sub(sum, args[i]);
     }
     return sum;
-    //TODO: To complete the substraction logic
 }
 
-Value MultVar::evalRator(const std::vector<Value> &args) { // * with multiple args
-    if (args.empty()) {
-        return Value(new Integer(1)); // 空参数时返回 1（Scheme 约定）
+Value MultVar::evalRator(const Value *args, int argc) { // * with multiple args
+    if (argc == 0) {
+        return IntegerV(1); // 空参数时返回 1（Scheme 约定）
+    }
+    if (!isNumber(args[0])) {
+        throw(RuntimeError("Wrong typename"));
     }
     Value sum = args[0];
-    for(int i = 1; i < args.size(); i++) {
-        sum = Mult(Expr(new MultVar({})), Expr(new MultVar({}))).evalRator(sum, args[i]);
+    for(int i = 1; i < argc; i++) {
+        sum = num_mul(sum, args[i]);
     }
     return sum;
-    //TODO: To complete the multiplication logic
 }
 
-Value DivVar::evalRator(const std::vector<Value> &args) { // / with multiple args
-    if (args.empty()) {
+Value DivVar::evalRator(const Value *args, int argc) { // / with multiple args
+    if (argc == 0) {
         throw(RuntimeError("(/)→ RuntimeError")); // 空参数时返回 RuntimeError（Scheme 约定）
     }
-    if (args.size() == 1) {
-        return Div(Expr(new DivVar({})), Expr(new DivVar({}))).evalRator(IntegerV(1), args[0]);
+    if (argc == 1) {
+        return num_div(IntegerV(1), args[0]);
     }
     Value sum = args[0];
-    for(int i = 1; i < args.size(); i++) {
-        sum = Div(Expr(new DivVar({})), Expr(new DivVar({}))).evalRator(sum, args[i]);
+    for(int i = 1; i < argc; i++) {
+        sum = num_div(sum, args[i]);
     }
     return sum;
-    //TODO: To complete the divisor logic
 }
 
 Value Expt::evalRator(const Value &rand1, const Value &rand2) { // expt
-    if (rand1->v_type == V_INT && rand2->v_type == V_INT) {
-        int base = dynamic_cast<Integer*>(rand1.get())->n;
-        int exponent = dynamic_cast<Integer*>(rand2.get())->n;
-        
-        if (exponent < 0) {
-            throw(RuntimeError("Negative exponent not supported for integers"));
-        }
-        if (base == 0 && exponent == 0) {
-            throw(RuntimeError("0^0 is undefined"));
-        }
-        
-        long long result = 1;
-        long long b = base;
-        int exp = exponent;
-        
-        while (exp > 0) {
-            if (exp % 2 == 1) {
-                result *= b;
-                if (result > INT_MAX || result < INT_MIN) {
-                    throw(RuntimeError("Integer overflow in expt"));
-                }
-            }
-            b *= b;
-            if (b > INT_MAX || b < INT_MIN) {
-                if (exp > 1) {
-                    throw(RuntimeError("Integer overflow in expt"));
-                }
-            }
-            exp /= 2;
-        }
-        
-        return IntegerV((int)result);
-    }
-    throw(RuntimeError("Wrong typename"));
-}
-
-//A FUNCTION TO SIMPLIFY THE COMPARISON WITH INTEGER AND RATIONAL NUMBER
-int compareNumericValues(const Value &v1, const Value &v2) {
-    if (v1->v_type == V_INT && v2->v_type == V_INT) {
-        int n1 = dynamic_cast<Integer*>(v1.get())->n;
-        int n2 = dynamic_cast<Integer*>(v2.get())->n;
-        return (n1 < n2) ? -1 : (n1 > n2) ? 1 : 0;
-    }
-    else if (v1->v_type == V_RATIONAL && v2->v_type == V_INT) {
-        Rational* r1 = dynamic_cast<Rational*>(v1.get());
-        int n2 = dynamic_cast<Integer*>(v2.get())->n;
-        int left = r1->numerator;
-        int right = n2 * r1->denominator;
-        return (left < right) ? -1 : (left > right) ? 1 : 0;
-    }
-    else if (v1->v_type == V_INT && v2->v_type == V_RATIONAL) {
-        int n1 = dynamic_cast<Integer*>(v1.get())->n;
-        Rational* r2 = dynamic_cast<Rational*>(v2.get());
-        int left = n1 * r2->denominator;
-        int right = r2->numerator;
-        return (left < right) ? -1 : (left > right) ? 1 : 0;
-    }
-    else if (v1->v_type == V_RATIONAL && v2->v_type == V_RATIONAL) {
-        Rational* r1 = dynamic_cast<Rational*>(v1.get());
-        Rational* r2 = dynamic_cast<Rational*>(v2.get());
-        int left = r1->numerator * r2->denominator;
-        int right = r2->numerator * r1->denominator;
-        return (left < right) ? -1 : (left > right) ? 1 : 0;
-    }
-    throw RuntimeError("Wrong typename in numeric comparison");
+    return num_expt(rand1, rand2);
 }
 
 Value Less::evalRator(const Value &rand1, const Value &rand2) { // <
-    if ((rand1->v_type == V_INT||rand1->v_type == V_RATIONAL) && (rand2->v_type == V_INT||rand2->v_type == V_RATIONAL)) {
-        int a = compareNumericValues(rand1, rand2);
-        if (a == -1) {
-            return Value(new Boolean(true));
-        }else{
-            return Value(new Boolean(false));
-        }
-    }
-    else {
-        throw(RuntimeError("Wrong typename"));
-    }
-    //TODO: To complete the less logic
+    return BooleanV(num_compare(rand1, rand2) < 0);
 }
 
 Value LessEq::evalRator(const Value &rand1, const Value &rand2) { // <=
-    if ((rand1->v_type == V_INT||rand1->v_type == V_RATIONAL) && (rand2->v_type == V_INT||rand2->v_type == V_RATIONAL)) {
-        int a = compareNumericValues(rand1, rand2);
-        if (a == -1||a == 0) {
-            return Value(new Boolean(true));
-        }else{
-            return Value(new Boolean(false));
-        }
-    }
-    else {
-        throw(RuntimeError("Wrong typename"));
-    }
-    //TODO: To complete the less logic
+    return BooleanV(num_compare(rand1, rand2) <= 0);
 }
 
 Value Equal::evalRator(const Value &rand1, const Value &rand2) { // =
-    if ((rand1->v_type == V_INT||rand1->v_type == V_RATIONAL) && (rand2->v_type == V_INT||rand2->v_type == V_RATIONAL)) {
-        int a = compareNumericValues(rand1, rand2);
-        if (a == 0) {
-            return Value(new Boolean(true));
-        }else{
-            return Value(new Boolean(false));
-        }
-    }
-    else {
-        throw(RuntimeError("Wrong typename"));
-    }
-    //TODO: To complete the less logic
+    return BooleanV(num_compare(rand1, rand2) == 0);
 }
 
 Value GreaterEq::evalRator(const Value &rand1, const Value &rand2) { // >=
-    if ((rand1->v_type == V_INT||rand1->v_type == V_RATIONAL) && (rand2->v_type == V_INT||rand2->v_type == V_RATIONAL)) {
-        int a = compareNumericValues(rand1, rand2);
-        if (a == 1||a == 0) {
-            return Value(new Boolean(true));
-        }else{
-            return Value(new Boolean(false));
-        }
-    }
-    else {
-        throw(RuntimeError("Wrong typename"));
-    }
-    //TODO: To complete the less logic
+    return BooleanV(num_compare(rand1, rand2) >= 0);
 }
 
 Value Greater::evalRator(const Value &rand1, const Value &rand2) { // >
-    if ((rand1->v_type == V_INT||rand1->v_type == V_RATIONAL) && (rand2->v_type == V_INT||rand2->v_type == V_RATIONAL)) {
-        int a = compareNumericValues(rand1, rand2);
-        if (a == 1) {
-            return Value(new Boolean(true));
-        }else{
-            return Value(new Boolean(false));
-        }
-    }
-    else {
-        throw(RuntimeError("Wrong typename"));
-    }
-    //TODO: To complete the less logic
+    return BooleanV(num_compare(rand1, rand2) > 0);
 }
 
-Value LessVar::evalRator(const std::vector<Value> &args) { // < with multiple args
-    if (args.empty()) {
-        return Value(new Boolean(true));
-    }
-    for (int i = 0; i < args.size()-1; i++) {
-        Value t = Less(Expr(new LessVar({})), Expr(new LessVar({}))).evalRator(args[i], args[i+1]);
-        Boolean* boolVal = dynamic_cast<Boolean*>(t.get());
-        if (boolVal->b == false){
-            return Value(new Boolean(false));
+// 链式比较：相邻两项逐一比较，遇到不成立的一对即返回 #f
+Value LessVar::evalRator(const Value *args, int argc) { // < with multiple args
+    for (int i = 0; i + 1 < argc; i++) {
+        if (num_compare(args[i], args[i+1]) >= 0) {
+            return BooleanV(false);
         }
     }
-    return Value(new Boolean(true));
+    return BooleanV(true);
 }
 
-Value LessEqVar::evalRator(const std::vector<Value> &args) { // <= with multiple args
-    if (args.empty()) {
-        return Value(new Boolean(true));
-    }
-    for (int i = 0; i < args.size()-1; i++) {
-        Value t = LessEq(Expr(new LessEqVar({})), Expr(new LessEqVar({}))).evalRator(args[i], args[i+1]);
-        Boolean* boolVal = dynamic_cast<Boolean*>(t.get());
-        if (boolVal->b == false){
-            return Value(new Boolean(false));
+Value LessEqVar::evalRator(const Value *args, int argc) { // <= with multiple args
+    for (int i = 0; i + 1 < argc; i++) {
+        if (num_compare(args[i], args[i+1]) > 0) {
+            return BooleanV(false);
         }
     }
-        return Value(new Boolean(true));
+    return BooleanV(true);
 }
 
-Value EqualVar::evalRator(const std::vector<Value> &args) { // = with multiple args
-    if (args.empty()) {
-        return Value(new Boolean(true));
-    }
-    for (int i = 0; i < args.size()-1; i++) {
-        Value t = Equal(Expr(new EqualVar({})), Expr(new EqualVar({}))).evalRator(args[i], args[i+1]);
-        Boolean* boolVal = dynamic_cast<Boolean*>(t.get());
-        if (boolVal->b == false){
-            return Value(new Boolean(false));
+Value EqualVar::evalRator(const Value *args, int argc) { // = with multiple args
+    for (int i = 0; i + 1 < argc; i++) {
+        if (num_compare(args[i], args[i+1]) != 0) {
+            return BooleanV(false);
         }
     }
-    return Value(new Boolean(true));
+    return BooleanV(true);
 }
 
-Value GreaterEqVar::evalRator(const std::vector<Value> &args) { // >= with multiple args
-    if (args.empty()) {
-        return Value(new Boolean(true));
-    }
-    for (int i = 0; i < args.size()-1; i++) {
-        Value t = GreaterEq(Expr(new GreaterEqVar({})), Expr(new GreaterEqVar({}))).evalRator(args[i], args[i+1]);
-        Boolean* boolVal = dynamic_cast<Boolean*>(t.get());
-        if (boolVal->b == false){
-            return Value(new Boolean(false));
+Value GreaterEqVar::evalRator(const Value *args, int argc) { // >= with multiple args
+    for (int i = 0; i + 1 < argc; i++) {
+        if (num_compare(args[i], args[i+1]) < 0) {
+            return BooleanV(false);
         }
     }
-    return Value(new Boolean(true));
+    return BooleanV(true);
 }
 
-Value GreaterVar::evalRator(const std::vector<Value> &args) { // > with multiple args
-    if (args.empty()) {
-        return Value(new Boolean(true));
-    }
-    for (int i = 0; i < args.size()-1; i++) {
-        Value t = Greater(Expr(new GreaterVar({})), Expr(new GreaterVar({}))).evalRator(args[i], args[i+1]);
-        Boolean* boolVal = dynamic_cast<Boolean*>(t.get());
-        if (boolVal->b == false){
-            return Value(new Boolean(false));
+Value GreaterVar::evalRator(const Value *args, int argc) { // > with multiple args
+    for (int i = 0; i + 1 < argc; i++) {
+        if (num_compare(args[i], args[i+1]) <= 0) {
+            return BooleanV(false);
         }
     }
-    return Value(new Boolean(true));
+    return BooleanV(true);
 }
 
 Value Cons::evalRator(const Value &rand1, const Value &rand2) { // cons
@@ -670,12 +506,12 @@ Value Cons::evalRator(const Value &rand1, const Value &rand2) { // cons
     return Value(new Pair(car, cdr));
 }
 
-Value ListFunc::evalRator(const std::vector<Value> &args) { // list function
-    if (args.empty()) {
-        return Value(new Null());
+Value ListFunc::evalRator(const Value *args, int argc) { // list function
+    if (argc == 0) {
+        return NullV();
     }else{
-        Value p(new Null());
-        for (int i = args.size()-1; i >= 0; i--) {
+        Value p = NullV();
+        for (int i = argc-1; i >= 0; i--) {
             p = Value(new Pair(args[i],p));
         }
         return p;
@@ -683,22 +519,20 @@ Value ListFunc::evalRator(const std::vector<Value> &args) { // list function
 }
 
 Value IsList::evalRator(const Value &rand) { // list?
-    if (rand->v_type == V_NULL) {
-        return Value(new Boolean(true));
+    if (rand.type() == V_NULL) {
+        return BooleanV(true);
     }
 
-    if (rand->v_type != V_PAIR) {
-        return Value(new Boolean(false));
+    if (rand.type() != V_PAIR) {
+        return BooleanV(false);
     }
     Pair* pair = dynamic_cast<Pair*>(rand.get());
 
-    if (pair->cdr->v_type == V_NULL) {
-        return Value(new Boolean(true));
+    if (pair->cdr.type() == V_NULL) {
+        return BooleanV(true);
     }
 
-    Value dfs_result = evalRator(pair->cdr);
-    Boolean* bool_1 = dynamic_cast<Boolean*>(dfs_result.get());
-    return Value(new Boolean(bool_1->b));
+    return evalRator(pair->cdr);
 }
 
 Value Car::evalRator(const Value &rand) { // car
@@ -728,7 +562,7 @@ Value SetCar::evalRator(const Value &rand1, const Value &rand2) { // set-car!
         throw(RuntimeError("while this is not a pair,you are a fucker"));
     }else {
         pair->car = rand2;
-        return Value(new Void());
+        return VoidV();
     }
     //TODO: To complete the set-car! logic
 }
@@ -739,67 +573,55 @@ Value SetCdr::evalRator(const Value &rand1, const Value &rand2) { // set-cdr!
         throw(RuntimeError("while this is not a pair,you are a fucker"));
     }else {
         pair->cdr = rand2;
-        return Value(new Void());
+        return VoidV();
     }
     //TODO: To complete the set-cdr! logic
 }
 
 Value IsEq::evalRator(const Value &rand1, const Value &rand2) { // eq?
-    // 检查类型是否为 Integer
-    if (rand1->v_type == V_INT && rand2->v_type == V_INT) {
-        return BooleanV((dynamic_cast<Integer*>(rand1.get())->n) == (dynamic_cast<Integer*>(rand2.get())->n));
-    }
-    // 检查类型是否为 Boolean
-    else if (rand1->v_type == V_BOOL && rand2->v_type == V_BOOL) {
-        return BooleanV((dynamic_cast<Boolean*>(rand1.get())->b) == (dynamic_cast<Boolean*>(rand2.get())->b));
-    }
     // 检查类型是否为 Symbol
-    else if (rand1->v_type == V_SYM && rand2->v_type == V_SYM) {
+    if (rand1.type() == V_SYM && rand2.type() == V_SYM) {
         return BooleanV((dynamic_cast<Symbol*>(rand1.get())->s) == (dynamic_cast<Symbol*>(rand2.get())->s));
     }
-    // 检查类型是否为 Null 或 Void
-    else if ((rand1->v_type == V_NULL && rand2->v_type == V_NULL) ||
-             (rand1->v_type == V_VOID && rand2->v_type == V_VOID)) {
-        return BooleanV(true);
-    } else {
-        return BooleanV(rand1.get() == rand2.get());
-    }
+    // 整数、布尔值、() 和 void 都是立即数，其余为堆对象：直接比较值字
+    return BooleanV(rand1.w == rand2.w);
 }
 
 Value IsBoolean::evalRator(const Value &rand) { // boolean?
-    return BooleanV(rand->v_type == V_BOOL);
+    return BooleanV(rand.type() == V_BOOL);
 }
 
 Value IsFixnum::evalRator(const Value &rand) { // number?
-    return BooleanV(rand->v_type == V_INT);
+    return BooleanV(rand.type() == V_INT || rand.type() == V_BIGNUM);
 }
 
 Value IsNull::evalRator(const Value &rand) { // null?
-    return BooleanV(rand->v_type == V_NULL);
+    return BooleanV(rand.type() == V_NULL);
 }
 
 Value IsPair::evalRator(const Value &rand) { // pair?
-    return BooleanV(rand->v_type == V_PAIR);
+    return BooleanV(rand.type() == V_PAIR);
 }
 
 Value IsProcedure::evalRator(const Value &rand) { // procedure?
-    return BooleanV(rand->v_type == V_PROC);
+    return BooleanV(rand.type() == V_PROC || rand.type() == V_PRIMITIVE);
 }
 
 Value IsSymbol::evalRator(const Value &rand) { // symbol?
-    return BooleanV(rand->v_type == V_SYM);
+    return BooleanV(rand.type() == V_SYM);
 }
 
 Value IsString::evalRator(const Value &rand) { // string?
-    return BooleanV(rand->v_type == V_STRING);
+    return BooleanV(rand.type() == V_STRING);
 }
 
-Value Begin::eval(Assoc &e) {
+
+Value Begin::eval(Env &e) {
     for (const auto& expr : es) {
         if (!expr.get()) continue; // 安全检查
         if (auto* def = dynamic_cast<Define*>(expr.get())) {
             // 如果当前是 define，那么先创建空绑定，留给之后的闭包用
-            e = extend(def->var, VoidV(), e);
+            def->bind(e, VoidV());
         }
     }
 
@@ -813,7 +635,7 @@ Value Begin::eval(Assoc &e) {
             Value val = def->e->eval(e);
 
             // 把创建的空绑定替换为真实值
-            modify(def->var, val, e);
+            def->bind(e, val);
 
             result = VoidV();
         } else {
@@ -823,12 +645,17 @@ Value Begin::eval(Assoc &e) {
 
 	return result;
 }
-Value syntax_to_quoted_value(const Syntax &s_we_own) {
-    // 1. 判断 SyntaxBase 的具体类型（通过 dynamic_cast）
-    SyntaxBase* base = s_we_own.get();
+namespace {
+
+Value quoted_atom(SyntaxBase *base) {
+    // 判断 SyntaxBase 的具体类型（通过 dynamic_cast）
     // 处理整数
     if (auto num = dynamic_cast<Number*>(base)) {
-        return Value(new Integer(num->n));
+        return IntegerV(num->n);
+    }
+    // 处理超出 int 范围的整数
+    else if (auto big = dynamic_cast<BignumSyntax*>(base)) {
+        return BignumV(big->n);
     }
     // 处理有理数
     else if (auto rat = dynamic_cast<RationalSyntax*>(base)) {
@@ -836,11 +663,11 @@ Value syntax_to_quoted_value(const Syntax &s_we_own) {
     }
     // 处理 #t
     else if (dynamic_cast<TrueSyntax*>(base)) {
-        return Value(new Boolean(true));
+        return BooleanV(true);
     }
     // 处理 #f
     else if (dynamic_cast<FalseSyntax*>(base)) {
-        return Value(new Boolean(false));
+        return BooleanV(false);
     }
     // 处理字符串
     else if (auto str = dynamic_cast<StringSyntax*>(base)) {
@@ -850,118 +677,138 @@ Value syntax_to_quoted_value(const Syntax &s_we_own) {
     else if (auto sym = dynamic_cast<SymbolSyntax*>(base)) {
         return Value(new Symbol(sym->s));
     }
-	// 处理列表与pair
-    else if (auto list = dynamic_cast<List*>(base)) {
-        std::vector<Syntax> &elements = list->stxs;
-        Value current = VoidV();
-
-        // 检测 stxs 中是否有点符号
-        bool has_valid_dot = false;
-        int dot_index = -1;
-        int dot_count = 0;
-        for (int i = 0; i < elements.size(); ++i){
-            auto dot_sym = dynamic_cast<SymbolSyntax*>(elements[i].get());
-            if (dot_sym && dot_sym->s == ".") {
-                ++ dot_count;
-                dot_index = i;
-            }
+    // 其他未定义类型
+    else {
+        throw RuntimeError("though i can't find this type,you are a fucker,fuck you!");
+    }
+}
+
+// 一个正在转换的列表：元素从后往前依次 cons 到 acc 上
+struct QuoteFrame {
+    List *list;
+    int next;       // 下一个要转换的元素
+    int dot;        // 带点形式中点的位置，否则为 -1
+    bool tail;      // 带点形式的最终 cdr 还没有转换
+    Value acc;
+};
+
+QuoteFrame quote_frame(List *list) {
+    SyntaxSpan elements = list->stxs;
+    int size = elements.size();
+
+    // 检测 stxs 中是否有点符号
+    int dot_index = -1;
+    int dot_count = 0;
+    for (int i = 0; i < size; ++i) {
+        auto dot_sym = dynamic_cast<SymbolSyntax*>(elements[i].get());
+        if (dot_sym && dot_sym->s == ".") {
+            ++ dot_count;
+            dot_index = i;
         }
-        if (elements.size() >= 3) {
-            if (dot_count == 1 && dot_index == elements.size() - 2) has_valid_dot = true;
-            if (dot_count > 1) {
-                throw RuntimeError("dot_count > 1, you are a fucker,fuck you!");
-            }
-            if (dot_count == 1 && dot_index != elements.size() - 2) {
-                throw RuntimeError("dot position not equal elements.size() - 2, you are a fucker,fuck you!");
-            }
-        } else if (dot_count >= 1) {
-            throw RuntimeError("invalid dot, you are a fucker,fuck you!");
+    }
+    if (size >= 3) {
+        if (dot_count > 1) {
+            throw RuntimeError("dot_count > 1, you are a fucker,fuck you!");
         }
-        if (has_valid_dot) {
-            // 带点形式：处理 . 前面的元素为 car 链，. 后面的元素为最终 cdr
-            current = syntax_to_quoted_value(elements.back());  // . 后面的元素作为最终 cdr
-            for (int i = dot_index - 1; i >= 0; --i) {
-                Value elem = syntax_to_quoted_value(elements[i]);
-                current = Value(new Pair(elem, current));
-            }
-        } else {
-            // 普通列表：最终 cdr 是 Null
-            current = Value(new Null());
-            for (int i = elements.size() - 1; i >= 0; --i) {
-                Value elem = syntax_to_quoted_value(elements[i]);
-                current = Value(new Pair(elem, current));
-            }
+        if (dot_count == 1 && dot_index != size - 2) {
+            throw RuntimeError("dot position not equal elements.size() - 2, you are a fucker,fuck you!");
         }
-        return current;
+    } else if (dot_count >= 1) {
+        throw RuntimeError("invalid dot, you are a fucker,fuck you!");
     }
-    // 其他未定义类型
-    else {
-        throw RuntimeError("though i can't find this type,you are a fucker,fuck you!");
+    // 带点形式：先转换 . 后面的元素作为最终 cdr；普通列表的最终 cdr 是 Null
+    if (dot_count == 1) return QuoteFrame{list, size - 1, dot_index, true, VoidV()};
+    return QuoteFrame{list, size - 1, -1, false, NullV()};
+}
+
+void quote_add(QuoteFrame &f, const Value &elem) {
+    if (f.tail) {
+        f.acc = elem;
+        f.tail = false;
+        f.next = f.dot - 1;
+    } else {
+        f.acc = PairV(elem, f.acc);
+        --f.next;
     }
 }
-Value Quote::eval(Assoc& e) {
-        return syntax_to_quoted_value(this->s);
+
+} // namespace
+
+/**
+ * @brief Convert quoted syntax to a value, with an explicit stack of lists
+ *
+ * Nested lists are converted without recursion, so deeply nested data
+ * does not exhaust the native stack.
+ */
+Value syntax_to_quoted_value(const Syntax &s_we_own) {
+    List *root = s_we_own->list();
+    if (root == nullptr) return quoted_atom(s_we_own.get());
+
+    std::vector<QuoteFrame> frames;
+    frames.push_back(quote_frame(root));
+    while (true) {
+        QuoteFrame &f = frames.back();
+        if (f.next < 0) {
+            // 列表转换完毕，作为元素交给外层
+            Value done = f.acc;
+            frames.pop_back();
+            if (frames.empty()) return done;
+            quote_add(frames.back(), done);
+            continue;
+        }
+        SyntaxBase *item = f.list->stxs[f.next].get();
+        if (List *sub = item->list()) {
+            frames.push_back(quote_frame(sub));   // f 此后失效
+            continue;
+        }
+        quote_add(f, quoted_atom(item));
+    }
+}
+Value Quote::eval(Env& e) {
+        if (value) return *value;
+        throw RuntimeError(error);
     //TODO: To complete the quote logic
 }
 
-Value AndVar::eval(Assoc &e) { // and with short-circuit evaluation
+Value AndVar::eval(Env &e) { // and with short-circuit evaluation
 	if (rands.empty()) {
-        return Value(new Boolean(true));
+        return BooleanV(true);
     }
 	Value result = VoidV();
 	for(int i = 0; i < rands.size(); i++) {
 		result = rands[i]->eval(e);
-		auto is_bool = dynamic_cast<Boolean*>(result.get());
-		if (is_bool) {
-			if (is_bool->b == false) {
-				return Value(new Boolean(false));
-			}
+		if (result.isFalse()) {
+			return BooleanV(false);
 		}
 	}
 	return result;
     //TODO: To complete the and logic
 }
 
-Value OrVar::eval(Assoc &e) { // or with short-circuit evaluation
+Value OrVar::eval(Env &e) { // or with short-circuit evaluation
 	if (rands.empty()) {
-		return Value(new Boolean(false));
+		return BooleanV(false);
 	}
 	Value result = VoidV();
 	for(int i = 0; i < rands.size(); i++) {
 		result = rands[i]->eval(e);
-		auto is_bool = dynamic_cast<Boolean*>(result.get());
-		if (is_bool) {
-			if (is_bool->b != false) {
-				return result;
-			}
-		}
-		else{
+		if (!result.isFalse()) {
 			return result;
 		}
 	}
-	return Value(new Boolean(false));
+	return BooleanV(false);
     //TODO: To complete the or logic
 }
 
 Value Not::evalRator(const Value &rand) { // not
-	auto is_bool = dynamic_cast<Boolean*>(rand.get());
-	if (is_bool) {
-		if (is_bool->b == false) {
-			return Value(new Boolean(true));
-		}else{
-			return Value(new Boolean(false));
-		}
-	}else{
-		return Value(new Boolean(false));
-	}
+	return BooleanV(rand.isFalse());
     //TODO: To complete the not logic
 }
 
-Value If::eval(Assoc &e) {
+Value If::eval(Env &e) {
 	Value result = VoidV();
     Value cond_value = cond->eval(e);
-	auto judger = dynamic_cast<Boolean*>(cond_value.get());
-	if (judger&&judger->b == false) {
+	if (cond_value.isFalse()) {
 		if(alter.get() != nullptr){
 			result = alter->eval(e);
 		}else{
@@ -983,7 +830,7 @@ bool is_else_symbol(const Expr& expr) {
     }
     return false;
 }
-Value Cond::eval(Assoc &env) {
+Value Cond::eval(Env &env) {
     for (const auto& clause : clauses) {
         if (clause.empty()) {
             throw RuntimeError("cond clause cannot be empty!");
@@ -1006,11 +853,7 @@ Value Cond::eval(Assoc &env) {
         //判断完 else 后再 eval，否则对 else 进行 eval，然后抛出 undefined variable
         Value pred_val = clause[0]->eval(env);
 
-        bool is_true = true;
-        auto bool_val = dynamic_cast<Boolean*>(pred_val.get()); // 假设你的 BoolV 类型
-        if (bool_val != nullptr && !bool_val->b) {
-            is_true = false;
-        }
+        bool is_true = !pred_val.isFalse();
 
         if (is_true) {
             if (clause.size() == 1) {
@@ -1032,117 +875,119 @@ Value Cond::eval(Assoc &env) {
     //TODO: To complete the cond logic
 }
 
-Value Lambda::eval(Assoc &env) {
-	if (!e.get()) {
+Value Lambda::eval(Env &env) {
+	if (!info->e.get()) {
         throw RuntimeError("fuck you ,beach!,your body is as empty as a vagina");
     }
-	Procedure* proc = new Procedure(x, e, env);
-    Value ret = ProcedureV(x, e, env);
-	return ret;
+    if (closure) {
+        return *closure;
+    }
+    // 闭包帧只保存函数体用到的自由变量，不引用外层环境
+    Env captured(new Frame(info->captures.size(), Env(nullptr)));
+    for (size_t i = 0; i < info->captures.size(); ++i) {
+        captured->slots[i] = lookup(env, info->captures[i].first, info->captures[i].second);
+    }
+	return ProcedureV(info, captured);
     //TODO: To complete the lambda logic
 }
 
-Value Apply::eval(Assoc &e) {
-	Value proc_val = rator->eval(e);
-    if (!proc_val.get()  || proc_val->v_type != V_PROC) {throw RuntimeError("Attempt to apply a non-procedure");}
-    Procedure* clos_ptr = dynamic_cast<Procedure*>(proc_val.get());
-	 if (!clos_ptr) {
-        throw RuntimeError("Attempt to apply a non-procedure");
+// 尾调用：尾位置的 Apply 不直接求值函数体，而是把 (函数体, 新帧) 存入 pending_tail，
+// 返回 tail_call_marker；最近的非尾 Apply（或 finish_tail_calls）循环执行，C++ 栈深度不变
+namespace {
+Value tail_call_marker = SymbolV("#<tail-call>");  // 按值字比较，只需是唯一的堆对象
+struct {
+    Expr body = Expr(nullptr);
+    Env env = Env(nullptr);
+} pending_tail;
+}
+
+/**
+ * @brief Run pending tail calls until a real value is produced
+ */
+Value finish_tail_calls(Value result) {
+    while (result.w == tail_call_marker.w) {
+        Expr body = pending_tail.body;
+        Env env = std::move(pending_tail.env);
+        // 上一轮的帧已释放，新帧下移到它的位置，尾调用循环不使值栈增长
+        settle_frame(env.get());
+        result = body->eval(env);
     }
-    Expr body = clos_ptr->e;
+    return result;
+}
 
-    std::vector<Value> args;
-    for (const auto& arg_expr : rand) {
-        args.push_back(arg_expr->eval(e));
+namespace {
+// 进入闭包体：尾位置只登记待执行的调用，由最近的非尾 Apply 循环执行
+Value enter_body(const Expr &body, Env &frame, bool tail) {
+    if (tail) {
+        pending_tail.body = body;
+        pending_tail.env = frame;
+        return tail_call_marker;
     }
+    return finish_tail_calls(body->eval(frame));
+}
+}
 
-    if (clos_ptr->parameters.empty()) {
-        // 1. 无参数内置函数
-        if (args.size() == 0) {
-            if (auto* makeVoid = dynamic_cast<MakeVoid*>(body.get())) {
-                return makeVoid->eval(e);  // MakeVoid无参数，直接调用eval
-            }else if (auto* exitFunc = dynamic_cast<Exit*>(body.get())) {
-                return exitFunc->eval(e);  // Exit无参数，直接调用eval
-            }
-        } else if (args.size() == 1) {
-            // 2. 单参数内置函数（isboolean、isfixnum、null?、pair?、procedure?、symbol?、string?、display、not、null?、pair?、islist、car、cdr）
-            if (auto* isBoolean = dynamic_cast<IsBoolean*>(clos_ptr->e.get())) {
-                return isBoolean->evalRator(args[0]);  // boolean? 接收1个参数
-            } else if (auto* isFixnum = dynamic_cast<IsFixnum*>(clos_ptr->e.get())) {
-                return isFixnum->evalRator(args[0]);  // isfixnum 接收1个参数
-            } else if (auto* isNull = dynamic_cast<IsNull*>(clos_ptr->e.get())) {
-                return isNull->evalRator(args[0]);  // null? 接收1个参数
-            } else if (auto* isPair = dynamic_cast<IsPair*>(clos_ptr->e.get())) {
-                return isPair->evalRator(args[0]);  // pair? 接收1个参数
-            } else if (auto* isProcedure = dynamic_cast<IsProcedure*>(clos_ptr->e.get())) {
-                return isProcedure->evalRator(args[0]);  // procedure? 接收1个参数
-            } else if (auto* isSymbol = dynamic_cast<IsSymbol*>(clos_ptr->e.get())) {
-                return isSymbol->evalRator(args[0]);  // symbol? 接收1个参数
-            } else if (auto* isString = dynamic_cast<IsString*>(clos_ptr->e.get())) {
-                return isString->evalRator(args[0]);  // string? 接收1个参数
-            } else if (auto* displayFunc = dynamic_cast<Display*>(clos_ptr->e.get())) {
-                return displayFunc->evalRator(args[0]);  // display 接收1个参数
-            } else if (auto* notFunc = dynamic_cast<Not*>(clos_ptr->e.get())) {
-                return notFunc->evalRator(args[0]);  // not 接收1个参数
-            } else if (auto* isList = dynamic_cast<IsList*>(clos_ptr->e.get())) {
-                return isList->evalRator(args[0]);  // list? 接收1个参数
-            } else if (auto* carFunc = dynamic_cast<Car*>(clos_ptr->e.get())) {
-                return carFunc->evalRator(args[0]);  // car 接收1个参数
-            } else if (auto* cdrFunc = dynamic_cast<Cdr*>(clos_ptr->e.get())) {
-                return cdrFunc->evalRator(args[0]);  // cdr 接收1个参数
-            }
-        } else if (args.size() == 2) {
-            // 3. 双参数内置函数（modulo、expt、eq?、cons、set-car!、set-cdr!）
-            if (auto* moduloFunc = dynamic_cast<Modulo*>(clos_ptr->e.get())) {
-                return moduloFunc->evalRator(args[0], args[1]);  // modulo 接收2个参数
-            } else if (auto* exptFunc = dynamic_cast<Expt*>(clos_ptr->e.get())) {
-                return exptFunc->evalRator(args[0], args[1]);  // expt 接收2个参数
-            } else if (auto* isEq = dynamic_cast<IsEq*>(clos_ptr->e.get())) {
-                return isEq->evalRator(args[0], args[1]);  // eq? 接收2个参数
-            } else if (auto* consFunc = dynamic_cast<Cons*>(clos_ptr->e.get())) {
-                return consFunc->evalRator(args[0], args[1]);  // cons 接收2个参数
-            } else if (auto* setCar = dynamic_cast<SetCar*>(clos_ptr->e.get())) {
-                return setCar->evalRator(args[0], args[1]);  // set-car! 接收2个参数
-            } else if (auto* setCdr = dynamic_cast<SetCdr*>(clos_ptr->e.get())) {
-                return setCdr->evalRator(args[0], args[1]);  // set-cdr! 接收2个参数
-            }
-        } else {
-            // 4. 可变参数内置函数（+、-、*、/、=、<、<=、>、>=、list）
-            if (auto* plusVar = dynamic_cast<PlusVar*>(clos_ptr->e.get())) {
-                return plusVar->evalRator(args);  // + 接收可变参数（vector<Value>）
-            } else if (auto* minusVar = dynamic_cast<MinusVar*>(clos_ptr->e.get())) {
-                return minusVar->evalRator(args);  // - 接收可变参数
-            } else if (auto* multVar = dynamic_cast<MultVar*>(clos_ptr->e.get())) {
-                return multVar->evalRator(args);  // * 接收可变参数
-            } else if (auto* divVar = dynamic_cast<DivVar*>(clos_ptr->e.get())) {
-                return divVar->evalRator(args);  // / 接收可变参数
-            } else if (auto* equalVar = dynamic_cast<EqualVar*>(clos_ptr->e.get())) {
-                return equalVar->evalRator(args);  // = 接收可变参数
-            } else if (auto* lessVar = dynamic_cast<LessVar*>(clos_ptr->e.get())) {
-                return lessVar->evalRator(args);  // < 接收可变参数
-            } else if (auto* lessEqVar = dynamic_cast<LessEqVar*>(clos_ptr->e.get())) {
-                return lessEqVar->evalRator(args);  // <= 接收可变参数
-            } else if (auto* greaterVar = dynamic_cast<GreaterVar*>(clos_ptr->e.get())) {
-                return greaterVar->evalRator(args);  // > 接收可变参数
-            } else if (auto* greaterEqVar = dynamic_cast<GreaterEqVar*>(clos_ptr->e.get())) {
-                return greaterEqVar->evalRator(args);  // >= 接收可变参数
-            } else if (auto* listFunc = dynamic_cast<ListFunc*>(clos_ptr->e.get())) {
-                return listFunc->evalRator(args);  // list 接收可变参数
+Value Apply::eval(Env &e) {
+	Value proc_val = rator->eval(e);
+    if (spec == SPEC_PROCEDURE) {
+        // 单态内联缓存：仍是同一个 lambda 的闭包时，参数个数已检查过，实参直接求值进新帧
+        if (proc_val.type() == V_PROC) {
+            Procedure* clos_ptr = static_cast<Procedure*>(proc_val.get());
+            if (!callee.owner_before(clos_ptr->info) && !clos_ptr->info.owner_before(callee)) {
+                const LambdaInfo &info = *clos_ptr->info;
+                Env param_env(stack_frame(info.frame_size, clos_ptr->env));
+                for (size_t i = 0; i < rand.size(); ++i) {
+                    param_env->slots[i] = rand[i]->eval(e);
+                }
+                box_slots(param_env.get(), info.boxed);
+                if (info.aot != nullptr && !aot_stack_low()) return info.aot(param_env.get());
+                Value result(nullptr);
+                if (jit_call(clos_ptr, param_env, rand.size(), result)) return result;
+                return enter_body(info.e, param_env, tail);
             }
         }
+        spec = SPEC_GENERIC;  // 守卫失败：退回通用路径
+        callee.reset();
+    }
+    ValueType proc_type = proc_val.type();
+    if (proc_type != V_PROC && proc_type != V_PRIMITIVE) {throw RuntimeError("Attempt to apply a non-procedure");}
+
+    if (proc_type == V_PRIMITIVE) {
+        spec = SPEC_GENERIC;
+        // 实参求值到值栈上，内置函数直接读取
+        StackArgs args(rand.size());
+        for (size_t i = 0; i < rand.size(); ++i) {
+            args.slots[i] = rand[i]->eval(e);
+        }
+        return apply_primitive(static_cast<Primitive*>(proc_val.get()), args.slots, rand.size());
     }
 
     // -------------------------- 非内置函数：执行用户lambda函数 --------------------------
 
-    if (args.size() != clos_ptr->parameters.size()) {
+    Procedure* clos_ptr = static_cast<Procedure*>(proc_val.get());
+    const LambdaInfo &info = *clos_ptr->info;
+    Expr body = info.e;
+    if (rand.size() != info.x.size()) {
+        for (const auto& arg_expr : rand) {
+            arg_expr->eval(e);   // 先求值实参，再报告个数不符
+        }
         throw RuntimeError("Wrong number of arguments for lambda");
     }
 
-    Assoc param_env = clos_ptr->env;
-	for (size_t i = 0; i < clos_ptr->parameters.size(); ++i) {
-        param_env = extend(clos_ptr->parameters[i], args[i], param_env);  // 绑定形参和实参
+    // 实参直接求值进值栈上的新帧
+    Env param_env(stack_frame(info.frame_size, clos_ptr->env));
+    for (size_t i = 0; i < rand.size(); ++i) {
+        param_env->slots[i] = rand[i]->eval(e);
     }
-    return body->eval(param_env);
+    box_slots(param_env.get(), info.boxed);
+    if (spec == SPEC_UNINIT) {
+        spec = SPEC_PROCEDURE;
+        callee = clos_ptr->info;
+    }
+    if (info.aot != nullptr && !aot_stack_low()) return info.aot(param_env.get());
+    Value result(nullptr);
+    if (jit_call(clos_ptr, param_env, rand.size(), result)) return result;
+    return enter_body(body, param_env, tail);
 }
 bool does_expr_reference(const Expr& expr, const std::string& var_name) {
     // 1. Parser 将变量解析为 Var 类型，而不是 Symbol 类型：直接匹配变量名
@@ -1183,35 +1028,53 @@ bool does_expr_reference(const Expr& expr, const std::string& var_name) {
 
     // 5. Lambda 表达式：检查函数体（忽略参数名阴影）
     if (auto* lambda_expr = dynamic_cast<Lambda*>(expr.get())) {
-        return does_expr_reference(lambda_expr->e, var_name);
+        return does_expr_reference(lambda_expr->info->e, var_name);
     }
 
     // 6. 其他表达式（数字、布尔、字符串、Null 等）：不引用变量
     return false;
 }
 
-Value Define::eval(Assoc &env) {
-    std::string var_name = this->var;
-    Expr value_expr = this->e;
+void Define::checkName() const {
+    if (primitives.find(var) != primitives.end() || reserved_words.find(var) != reserved_words.end()) {
+        throw RuntimeError("Cannot redefine primitive or reserved word: '" + var + "'");
+    }
+}
 
-    if (primitives.find(var_name) != primitives.end() || reserved_words.find(var_name) != reserved_words.end()) {
-        throw RuntimeError("Cannot redefine primitive or reserved word: '" + var_name + "'");
+// 写入 define 的绑定：全局定义原地更新其绑定单元，局部定义写入解析时分配的槽位
+void Define::bind(Env &env, const Value &v) {
+    if (index < 0) {
+        if (cell == nullptr) {
+            cell = global_env.cell(var);
+        }
+        cell->v = v;
+    } else if (boxed) {
+        unbox(env->slots[index]) = v;
+    } else {
+        env->slots[index] = v;
     }
+}
+
+Value Define::eval(Env &env) {
+    Expr value_expr = this->e;
+
+    checkName();
 
     // 核心修复：总是先创建占位绑定
-    env = extend(var_name, VoidV(), env);
+    bind(env, VoidV());
 
     Value final_val = value_expr->eval(env);
 
     // 用最终值更新占位符
-    modify(var_name, final_val, env);
+    bind(env, final_val);
 
     return VoidV();
 }
 
-Value Let::eval(Assoc &env) {
-    Assoc localEnv = env;
-    for (const auto& binding : bind) {
+Value Let::eval(Env &env) {
+    Env localEnv(new Frame(frame_size, env));
+    for (size_t k = 0; k < bind.size(); ++k) {
+        const auto& binding = bind[k];
         std::string var = binding.first;
         if(var.empty()){
             throw RuntimeError("an block?what a fuckerman you are!! GRRRRRRRRRRRR");
@@ -1230,15 +1093,16 @@ Value Let::eval(Assoc &env) {
         }
         Value boundValue = binding.second->eval(env);
         // 计算绑定
-        localEnv = extend(binding.first, boundValue, localEnv);
+        localEnv->slots[k] = boundValue;
     }
+    box_slots(localEnv.get(), boxed);
     return body->eval(localEnv);
 }
 
-Value Letrec::eval(Assoc &env) {
-    Assoc localEnv = env;
-    for (const auto& binding : bind) {
-        std::string var = binding.first;
+Value Letrec::eval(Env &env) {
+    Env localEnv(new Frame(frame_size, env));
+    for (size_t k = 0; k < bind.size(); ++k) {
+        std::string var = bind[k].first;
         if(var.empty()){
             throw RuntimeError("an block?what a fuckerman you are!! GRRRRRRRRRRRR");
         }
@@ -1252,33 +1116,42 @@ Value Letrec::eval(Assoc &env) {
                 throw RuntimeError("if you keep inputing these invalid symbols ,i will fuck your ass");
             }
         }
-        localEnv = extend(var, VoidV(), localEnv);
+        localEnv->slots[k] = VoidV();
     }
-    for (const auto& binding : bind) {
-        Value boundValue = binding.second->eval(localEnv);
-        // 计算绑定
-        modify(binding.first, boundValue, localEnv);
+    box_slots(localEnv.get(), boxed);
+    for (size_t k = 0; k < bind.size(); ++k) {
+        Value boundValue = bind[k].second->eval(localEnv);
+        // 计算绑定：被闭包捕获的绑定写入 Box
+        Value &slot = localEnv->slots[k];
+        (slot.type() == V_BOX ? unbox(slot) : slot) = boundValue;
     }
     return body->eval(localEnv);
 }
 
 
-Value Set::eval(Assoc &env) {
-    if (find(var, env).get() == nullptr) {
+Value Set::eval(Env &env) {
+    if (depth >= 0) {
+        Value &slot = lookup(env, depth, index);
+        if ((boxed ? unbox(slot) : slot).empty()) {
+            throw RuntimeError("the var has not been defined yet");
+        }
+        Value bond_value = e->eval(env);
+        Value &target = lookup(env, depth, index);
+        (boxed ? unbox(target) : target) = bond_value;
+        return VoidV();
+    }
+    if (cell == nullptr) {
+        cell = global_env.cell(var);
+    }
+    if (cell->v.empty()) {
         throw RuntimeError("the var has not been defined yet");
     }
     Value bond_value = e->eval(env);
-    modify(var, bond_value, env);
+    cell->v = bond_value;
     return VoidV();
 }
 
 Value Display::evalRator(const Value &rand) { // display function
-    if (rand->v_type == V_STRING) {
-        String* str_ptr = dynamic_cast<String*>(rand.get());
-        std::cout << str_ptr->s;
-    } else {
-        rand->show(std::cout);
-    }
-    
+    print_value(scheme_out, rand, true);
     return VoidV();
 }
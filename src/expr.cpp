@@ -1,12 +1,17 @@
 #include "Def.hpp"
 #include "expr.hpp"
+#include "value.hpp"
+#include "RE.hpp"
 #include <cstring>
 #include <cstdlib>
+#include <sstream>
 #include <vector>
 using std::vector;
 using std::string;
 using std::pair;
 
+extern Value syntax_to_quoted_value(const Syntax &);
+
 // 辅助函数：计算最大公约数
 int gcd(int a, int b) {
     while (b != 0) {
@@ -24,11 +29,99 @@ ExprBase* Expr::operator->() const { return ptr.get(); }
 ExprBase& Expr::operator*() { return *ptr; }
 ExprBase* Expr::get() const { return ptr.get(); }
 
+//LEXICAL ADDRESSING
+
+Binding::Binding() : captured(false), assigned(false) {}
+
+Scope::Scope(Scope *p, bool c) : parent(p), capture(c) {}
+
+bool Scope::isGlobal() const { return parent == nullptr; }
+
+// 总是分配新槽位（参数、let 绑定），同名时后绑定的遮蔽前面的
+int Scope::bind(const std::string &name) {
+    names.push_back(name);
+    bindings.push_back(std::make_shared<Binding>());
+    return names.size() - 1;
+}
+
+// 内部 define：本层已有同名槽位则复用
+int Scope::declare(const std::string &name) {
+    for (int i = names.size() - 1; i >= 0; --i) {
+        if (names[i] == name) return i;
+    }
+    return bind(name);
+}
+
+/**
+ * @brief Address a variable from this scope, nullptr if it is global
+ *
+ * Crossing into a capture scope resolves the name where the lambda is
+ * defined and appends it to the closure slots, so a closure only copies
+ * the variables its body (or a lambda nested in it) refers to.
+ */
+std::shared_ptr<Binding> Scope::resolve(const std::string &name, int &depth, int &index) {
+    depth = 0;
+    for (Scope *s = this; !s->isGlobal(); s = s->parent, ++depth) {
+        for (int i = s->names.size() - 1; i >= 0; --i) {
+            if (s->names[i] == name) {
+                index = i;
+                return s->bindings[i];
+            }
+        }
+        if (s->capture) {
+            int outer_depth, outer_index;
+            std::shared_ptr<Binding> binding = s->parent->resolve(name, outer_depth, outer_index);
+            if (!binding) return binding;
+            // 自由变量：闭包帧新增一个槽位，创建闭包时从定义处的环境复制
+            binding->captured = true;
+            s->names.push_back(name);
+            s->bindings.push_back(binding);
+            s->captures.push_back(std::make_pair(outer_depth, outer_index));
+            index = s->names.size() - 1;
+            return binding;
+        }
+    }
+    return std::shared_ptr<Binding>();
+}
+
+// 只判断是否被词法绑定，不登记捕获
+bool Scope::binds(const std::string &name) const {
+    for (const Scope *s = this; !s->isGlobal(); s = s->parent) {
+        for (const auto &n : s->names) {
+            if (n == name) return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Slots of this scope that need a Box; marks the nodes using them
+ *
+ * Called once the whole body is parsed, when every capture and assignment
+ * of the scope's own slots has been seen.
+ */
+std::vector<int> Scope::boxedSlots() const {
+    std::vector<int> slots;
+    for (size_t i = 0; i < bindings.size(); ++i) {
+        const Binding &binding = *bindings[i];
+        if (!binding.captured || !binding.assigned) continue;
+        for (bool *use : binding.uses) *use = true;
+        slots.push_back(i);
+    }
+    return slots;
+}
+
 //BASIC TYPES AND LITERALS
 
+Literal::Literal(ExprType et) : ExprBase(et) {}
+
 Fixnum::Fixnum(int x) : ExprBase(E_FIXNUM), n(x) {}
 
-RationalNum::RationalNum(int num, int den) : ExprBase(E_RATIONAL), numerator(num), denominator(den) {
+BignumLiteral::BignumLiteral(const BigInt &n) : Literal(E_BIGNUM), n(n) {
+    value = std::make_shared<Value>(BignumV(n));
+}
+
+RationalNum::RationalNum(int num, int den) : Literal(E_RATIONAL), numerator(num), denominator(den) {
     // 简化分数
     int g = gcd(abs(numerator), abs(denominator));
     numerator /= g;
@@ -39,9 +132,16 @@ RationalNum::RationalNum(int num, int den) : ExprBase(E_RATIONAL), numerator(num
         numerator = -numerator;
         denominator = -denominator;
     }
+    value = std::make_shared<Value>(RationalV(numerator, denominator));
 }
 
-StringExpr::StringExpr(const std::string &str) : ExprBase(E_STRING), s(str) {}
+StringExpr::StringExpr(const std::string &str) : Literal(E_STRING), s(str) {
+    value = std::make_shared<Value>(StringV(s));
+}
+
+Constant::Constant(const Value &v) : Literal(E_CONST) {
+    value = std::make_shared<Value>(v);
+}
 
 True::True() : ExprBase(E_TRUE) {}
 
@@ -55,7 +155,7 @@ Exit::Exit() : ExprBase(E_EXIT) {}
 
 Unary::Unary(ExprType et, const Expr &expr) : ExprBase(et), rand(expr) {}
 
-Binary::Binary(ExprType et, const Expr &r1, const Expr &r2) : ExprBase(et), rand1(r1), rand2(r2) {}
+Binary::Binary(ExprType et, const Expr &r1, const Expr &r2) : ExprBase(et), rand1(r1), rand2(r2), spec(SPEC_UNINIT) {}
 
 Variadic::Variadic(ExprType et, const std::vector<Expr> &rands) : ExprBase(et), rands(rands) {}
 
@@ -149,7 +249,17 @@ IsString::IsString(const Expr &r1) : Unary(E_STRINGQ, r1) {}
 
 Begin::Begin(const vector<Expr> &vec) : ExprBase(E_BEGIN), es(vec) {}
 
-Quote::Quote(const Syntax &t) : ExprBase(E_QUOTE), s(t) {}
+Quote::Quote(const Syntax &t) : Literal(E_QUOTE) {
+    try {
+        value = std::make_shared<Value>(syntax_to_quoted_value(t));
+    } catch (const RuntimeError &RE) {
+        // 点号位置错误：留到求值时再报错
+        std::ostringstream shown;
+        t->show(shown);
+        text = shown.str();
+        error = RE.what();
+    }
+}
 
 //CONDITIONAL
 
@@ -159,23 +269,41 @@ Cond::Cond(const std::vector<std::vector<Expr>> &cls) : ExprBase(E_COND), clause
 
 //VARIABLE AND FUNCITON DEFINITION
 
-Var::Var(const string &s) : ExprBase(E_VAR), x(s) {}
+Var::Var(const string &s) : ExprBase(E_VAR), x(s), depth(-1), index(-1), boxed(false), cell(nullptr) {}
+
+Var::Var(const string &s, int d, int i) : ExprBase(E_VAR), x(s), depth(d), index(i), boxed(false), cell(nullptr) {}
 
-Apply::Apply(const Expr &expr, const vector<Expr> &vec) : ExprBase(E_APPLY), rator(expr), rand(vec) {}
+Apply::Apply(const Expr &expr, const vector<Expr> &vec)
+    : ExprBase(E_APPLY), rator(expr), rand(vec), tail(false), spec(SPEC_UNINIT) {}
 
-Lambda::Lambda(const vector<string> &vec, const Expr &expr) : ExprBase(E_LAMBDA), x(vec), e(expr) {}
+LambdaInfo::LambdaInfo(const vector<string> &vec, const Expr &expr, int size, const vector<int> &boxed,
+                       const vector<pair<int, int>> &captures)
+    : x(vec), e(expr), frame_size(size), boxed(boxed), captures(captures), calls(0), aot(nullptr) {}
+
+Lambda::Lambda(const vector<string> &vec, const Expr &expr, int size, const vector<int> &boxed,
+               const vector<pair<int, int>> &captures)
+    : ExprBase(E_LAMBDA), info(std::make_shared<LambdaInfo>(vec, expr, size, boxed, captures)) {
+    // 没有自由变量的 lambda 每次求值结果都一样，只分配一次
+    if (captures.empty()) {
+        closure = std::make_shared<Value>(ProcedureV(info, Env(nullptr)));
+    }
+}
 
-Define::Define(const string &variable, const Expr &expr) : ExprBase(E_DEFINE), var(variable), e(expr) {}
+Define::Define(const string &variable, const Expr &expr, int slot)
+    : ExprBase(E_DEFINE), var(variable), e(expr), index(slot), boxed(false), cell(nullptr) {}
 
 //BINDING CONSTRUCTS
 
-Let::Let(const vector<pair<string, Expr>> &vec, const Expr &e) : ExprBase(E_LET), bind(vec), body(e) {}
+Let::Let(const vector<pair<string, Expr>> &vec, const Expr &e, int size, const vector<int> &boxed)
+    : ExprBase(E_LET), bind(vec), body(e), frame_size(size), boxed(boxed) {}
 
-Letrec::Letrec(const vector<pair<string, Expr>> &vec, const Expr &expr) : ExprBase(E_LETREC), bind(vec), body(expr) {}
+Letrec::Letrec(const vector<pair<string, Expr>> &vec, const Expr &expr, int size, const vector<int> &boxed)
+    : ExprBase(E_LETREC), bind(vec), body(expr), frame_size(size), boxed(boxed) {}
 
 //ASSIGNMENT
 
-Set::Set(const std::string &var, const Expr &e) : ExprBase(E_SET), var(var), e(e) {}
+Set::Set(const std::string &var, const Expr &e, int d, int i)
+    : ExprBase(E_SET), var(var), e(e), depth(d), index(i), boxed(false), cell(nullptr) {}
 
 //I/O OPERATIONS
 
@@ -7,7 +7,7 @@ public:
     int numerator;
     int denominator;
     RationalNum(int num, int den);
-    virtual Value eval(Assoc &) override;
+    virtual Value eval(Env &) override;
 };p
  * @brief Expression structures for the Scheme interpreter
  * @author luke36
@@ -26,7 +26,7 @@ public:
 struct ExprBase{
     ExprType e_type;
     ExprBase(ExprType);
-    virtual Value eval(Assoc &) = 0;
+    virtual Value eval(Env &) = 0;
     virtual ~ExprBase() = default;
 };
 
@@ -39,10 +39,77 @@ public:
     ExprBase* get() const;
 };
 
+/**
+ * @brief Type feedback state of a self-specializing node
+ *
+ * A node starts SPEC_UNINIT and specializes on what its first execution
+ * sees: two fixnum operands for arithmetic and comparison nodes, a closure
+ * of one particular lambda for Apply. When a guard of the specialized path
+ * fails the node falls back to SPEC_GENERIC for good, so a polymorphic site
+ * pays for one failed guard and then runs the generic path as before.
+ */
+enum Specialization { SPEC_UNINIT, SPEC_FIXNUM, SPEC_PROCEDURE, SPEC_GENERIC };
+
+// ================================================================================
+//                             LEXICAL ADDRESSING
+// ================================================================================
+
+/**
+ * @brief Parse-time facts about one frame slot
+ *
+ * A variable that is captured by a nested lambda and also assigned after
+ * its frame is created (set!, internal define, letrec) is kept in a Box, so
+ * that the frame and every closure copy share one location.
+ */
+struct Binding {
+    bool captured;             ///< Copied into the closure frame of a nested lambda
+    bool assigned;             ///< Written after the frame is created
+    std::vector<bool *> uses;  ///< boxed flags of the Var/Set/Define nodes addressing the slot
+    Binding();
+};
+
+/**
+ * @brief Compile-time scope used by the parser to address variables
+ *
+ * Every lambda, let and letrec body gets its own Scope, which mirrors the
+ * runtime Frame created for it. A lambda body's parent is a capture Scope
+ * standing for the closure frame: a free variable is added to it the first
+ * time the body refers to it, and the closure copies just those slots out of
+ * the defining environment. The outermost Scope (no parent) stands for the
+ * global environment and never owns slots.
+ */
+struct Scope {
+    std::vector<std::string> names;  ///< Slot index -> variable name
+    std::vector<std::shared_ptr<Binding>> bindings;  ///< Slot index -> binding, shared by capture slots
+    std::vector<std::pair<int, int>> captures;  ///< Capture scope: (depth, index) of each slot in the defining env
+    Scope *parent;                   ///< Enclosing scope, nullptr for global
+    bool capture;                    ///< Closure frame of a lambda
+    Scope(Scope *, bool = false);
+    bool isGlobal() const;
+    int bind(const std::string &);
+    int declare(const std::string &);
+    std::shared_ptr<Binding> resolve(const std::string &, int &, int &);
+    bool binds(const std::string &) const;
+    std::vector<int> boxedSlots() const;
+};
+
 // ================================================================================
 //                             BASIC TYPES AND LITERALS
 // ================================================================================
 
+/**
+ * @brief Datum whose Value is built once, when the node is constructed
+ *
+ * Every evaluation returns the same shared Value, so a string or quoted list
+ * costs nothing per evaluation. value.hpp includes this file, hence the
+ * indirection through shared_ptr (as for Procedure::code). Fixnums and
+ * booleans are immediate Values and need no such cache.
+ */
+struct Literal : ExprBase {
+  std::shared_ptr<Value> value;   ///< Precomputed datum, null if it must be rebuilt
+  Literal(ExprType);
+};
+
 /**
  * @brief Integer literal expression
  * Represents fixed-point numbers (integers)
@@ -50,28 +117,45 @@ public:
 struct Fixnum : ExprBase {
   int n;
   Fixnum(int);
-  virtual Value eval(Assoc &) override;
+  virtual Value eval(Env &) override;
 };
 
 /**
  * @brief Rational number literal expression
  * Represents rational numbers as numerator/denominator
  */
-struct RationalNum : ExprBase {
+struct RationalNum : Literal {
   int numerator;
   int denominator;
   RationalNum(int num, int den);
-  virtual Value eval(Assoc &) override;
+  virtual Value eval(Env &) override;
+};
+
+/**
+ * @brief Integer literal outside the fixnum range
+ */
+struct BignumLiteral : Literal {
+  BigInt n;
+  BignumLiteral(const BigInt &);
+  virtual Value eval(Env &) override;
 };
 
 /**
  * @brief String literal expression
  * Represents string values
  */
-struct StringExpr : ExprBase {
+struct StringExpr : Literal {
   std::string s;
   StringExpr(const std::string &);
-  virtual Value eval(Assoc &) override;
+  virtual Value eval(Env &) override;
+};
+
+/**
+ * @brief Number computed by the constant folder (see optimizer.hpp)
+ */
+struct Constant : Literal {
+  Constant(const Value &);
+  virtual Value eval(Env &) override;
 };
 
 /**
@@ -79,7 +163,7 @@ struct StringExpr : ExprBase {
  */
 struct True : ExprBase {
   True();
-  virtual Value eval(Assoc &) override;
+  virtual Value eval(Env &) override;
 };
 
 /**
@@ -87,17 +171,17 @@ struct True : ExprBase {
  */
 struct False : ExprBase {
   False();
-  virtual Value eval(Assoc &) override;
+  virtual Value eval(Env &) override;
 };
 
 struct MakeVoid : ExprBase {
     MakeVoid();
-    virtual Value eval(Assoc &) override;
+    virtual Value eval(Env &) override;
 };
 
 struct Exit : ExprBase {
     Exit();
-    virtual Value eval(Assoc &) override;
+    virtual Value eval(Env &) override;
 };
 
 // ================================================================================
@@ -108,22 +192,23 @@ struct Unary : ExprBase {
     Expr rand;
     Unary(ExprType, const Expr &);
     virtual Value evalRator(const Value &) = 0;
-    virtual Value eval(Assoc &) override;
+    virtual Value eval(Env &) override;
 };
 
 struct Binary : ExprBase {
     Expr rand1;
     Expr rand2;
+    Specialization spec;   ///< Operand types seen by the arithmetic and comparison nodes
     Binary(ExprType, const Expr &, const Expr &);
     virtual Value evalRator(const Value &, const Value &) = 0;
-    virtual Value eval(Assoc &) override;
+    virtual Value eval(Env &) override;
 };
 
 struct Variadic : ExprBase {
     std::vector<Expr> rands;
     Variadic(ExprType, const std::vector<Expr> &);
-    virtual Value evalRator(const std::vector<Value> &) = 0;
-    virtual Value eval(Assoc &) override;
+    virtual Value evalRator(const Value *, int) = 0;
+    virtual Value eval(Env &) override;
 };
 
 // ================================================================================
@@ -133,16 +218,19 @@ struct Variadic : ExprBase {
 struct Plus : Binary {
     Plus(const Expr &, const Expr &);
     virtual Value evalRator(const Value &, const Value &) override;
+    virtual Value eval(Env &) override;
 };
 
 struct Minus : Binary {
     Minus(const Expr &, const Expr &);
     virtual Value evalRator(const Value &, const Value &) override;
+    virtual Value eval(Env &) override;
 };
 
 struct Mult : Binary {
     Mult(const Expr &, const Expr &);
     virtual Value evalRator(const Value &, const Value &) override;
+    virtual Value eval(Env &) override;
 };
 
 struct Div : Binary {
@@ -162,22 +250,22 @@ struct Expt : Binary {
 
 struct PlusVar : Variadic {
     PlusVar(const std::vector<Expr> &);
-    virtual Value evalRator(const std::vector<Value> &) override;
+    virtual Value evalRator(const Value *, int) override;
 };
 
 struct MinusVar : Variadic {
     MinusVar(const std::vector<Expr> &);
-    virtual Value evalRator(const std::vector<Value> &) override;
+    virtual Value evalRator(const Value *, int) override;
 };
 
 struct MultVar : Variadic {
     MultVar(const std::vector<Expr> &);
-    virtual Value evalRator(const std::vector<Value> &) override;
+    virtual Value evalRator(const Value *, int) override;
 };
 
 struct DivVar : Variadic {
     DivVar(const std::vector<Expr> &);
-    virtual Value evalRator(const std::vector<Value> &) override;
+    virtual Value evalRator(const Value *, int) override;
 };
 
 // ================================================================================
@@ -187,51 +275,56 @@ struct DivVar : Variadic {
 struct Less : Binary {
     Less(const Expr &, const Expr &);
     virtual Value evalRator(const Value &, const Value &) override;
+    virtual Value eval(Env &) override;
 };
 
 struct LessEq : Binary {
     LessEq(const Expr &, const Expr &);
     virtual Value evalRator(const Value &, const Value &) override;
+    virtual Value eval(Env &) override;
 };
 
 struct Equal : Binary {
     Equal(const Expr &, const Expr &);
     virtual Value evalRator(const Value &, const Value &) override;
+    virtual Value eval(Env &) override;
 };
 
 struct GreaterEq : Binary {
     GreaterEq(const Expr &, const Expr &);
     virtual Value evalRator(const Value &, const Value &) override;
+    virtual Value eval(Env &) override;
 };
 
 struct Greater : Binary {
     Greater(const Expr &, const Expr &);
     virtual Value evalRator(const Value &, const Value &) override;
+    virtual Value eval(Env &) override;
 };
 
 struct LessVar : Variadic {
     LessVar(const std::vector<Expr> &);
-    virtual Value evalRator(const std::vector<Value> &) override;
+    virtual Value evalRator(const Value *, int) override;
 };
 
 struct LessEqVar : Variadic {
     LessEqVar(const std::vector<Expr> &);
-    virtual Value evalRator(const std::vector<Value> &) override;
+    virtual Value evalRator(const Value *, int) override;
 };
 
 struct EqualVar : Variadic {
     EqualVar(const std::vector<Expr> &);
-    virtual Value evalRator(const std::vector<Value> &) override;
+    virtual Value evalRator(const Value *, int) override;
 };
 
 struct GreaterEqVar : Variadic {
     GreaterEqVar(const std::vector<Expr> &);
-    virtual Value evalRator(const std::vector<Value> &) override;
+    virtual Value evalRator(const Value *, int) override;
 };
 
 struct GreaterVar : Variadic {
     GreaterVar(const std::vector<Expr> &);
-    virtual Value evalRator(const std::vector<Value> &) override;
+    virtual Value evalRator(const Value *, int) override;
 };
 
 // ================================================================================
@@ -255,7 +348,7 @@ struct Cdr : Unary {
 
 struct ListFunc : Variadic {
     ListFunc(const std::vector<Expr> &);
-    virtual Value evalRator(const std::vector<Value> &) override;
+    virtual Value evalRator(const Value *, int) override;
 };
 
 struct SetCar : Binary {
@@ -280,13 +373,13 @@ struct Not : Unary {
 struct AndVar : ExprBase {
     std::vector<Expr> rands;
     AndVar(const std::vector<Expr> &);
-    virtual Value eval(Assoc &) override;  
+    virtual Value eval(Env &) override;  
 };
 
 struct OrVar : ExprBase {
     std::vector<Expr> rands;
     OrVar(const std::vector<Expr> &);
-    virtual Value eval(Assoc &) override;
+    virtual Value eval(Env &) override;
 };
 
 // ================================================================================
@@ -345,13 +438,21 @@ struct IsString : Unary {
 struct Begin : ExprBase {
     std::vector<Expr> es;
     Begin(const std::vector<Expr> &);
-    virtual Value eval(Assoc &) override;
+    virtual Value eval(Env &) override;
 };
 
-struct Quote : ExprBase {
-  Syntax s;
+/**
+ * @brief Quoted datum, converted to a Value by the parser
+ *
+ * A datum with a misplaced dot keeps a null value and is rejected on
+ * every evaluation, as the error belongs to the evaluation. The syntax
+ * tree is freed after parsing, so only its text and the error are kept.
+ */
+struct Quote : Literal {
+  std::string text;    ///< The datum as written, when it could not be converted
+  std::string error;
   Quote(const Syntax &);
-  virtual Value eval(Assoc &) override;
+  virtual Value eval(Env &) override;
 };
 
 // ================================================================================
@@ -363,44 +464,85 @@ struct If : ExprBase {
   Expr conseq;
   Expr alter;
   If(const Expr &, const Expr &, const Expr &);
-  virtual Value eval(Assoc &) override;
+  virtual Value eval(Env &) override;
 };
 
 struct Cond : ExprBase {
     std::vector<std::vector<Expr>> clauses;
     Cond(const std::vector<std::vector<Expr>> &);
-    virtual Value eval(Assoc &) override;
+    virtual Value eval(Env &) override;
 };
 
 // ================================================================================
 //                             VARIABLE AND FUNCITION DEFINITION
 // ================================================================================
 
+struct LambdaInfo;
+struct JitCode;
+struct FlatBody;
+
 struct Var : ExprBase {
     std::string x;
+    int depth;   ///< Frames to walk up, -1 for a global variable
+    int index;   ///< Slot in the target frame
+    bool boxed;  ///< The slot holds a Box
+    GlobalCell *cell;   ///< Cached global binding, filled on first lookup
     Var(const std::string &);
-    virtual Value eval(Assoc &) override;
+    Var(const std::string &, int, int);
+    virtual Value eval(Env &) override;
 };
 
 struct Apply : ExprBase {
     Expr rator;
     std::vector<Expr> rand;
+    bool tail;   ///< In tail position of a lambda body (marked by the parser)
+    Specialization spec;             ///< SPEC_PROCEDURE once a closure has been called here
+    std::weak_ptr<LambdaInfo> callee;   ///< Lambda of that closure, the inline cache key
     Apply(const Expr &, const std::vector<Expr> &);
-    virtual Value eval(Assoc &) override;
+    virtual Value eval(Env &) override;
+};
+
+/**
+ * @brief Native body of a lambda compiled ahead of time, called on its call frame
+ */
+typedef Value (*AotEntry)(Frame *);
+
+/**
+ * @brief Immutable description of a lambda, shared by all its closures
+ */
+struct LambdaInfo {
+    std::vector<std::string> x;    ///< Parameter names
+    Expr e;                        ///< Body
+    int frame_size;                ///< Slots needed by a call frame
+    std::vector<int> boxed;        ///< Call frame slots that hold a Box
+    std::vector<std::pair<int, int>> captures;  ///< (depth, index) in the defining env of each closure slot
+    std::shared_ptr<Chunk> code;   ///< Bytecode of the body, compiled on demand by the VM
+    std::shared_ptr<FlatBody> flat;   ///< Flattened body, built on demand by the flat evaluator
+    int calls;                     ///< Calls counted by the JIT until it compiles the body
+    std::shared_ptr<JitCode> jit;  ///< Native code, null until the call threshold is reached
+    AotEntry aot;                  ///< Body compiled by scmc (see aot.hpp), nullptr otherwise
+    LambdaInfo(const std::vector<std::string> &, const Expr &, int, const std::vector<int> &,
+               const std::vector<std::pair<int, int>> &);
 };
 
 struct Lambda : ExprBase {
-    std::vector<std::string> x;
-    Expr e;
-    Lambda(const std::vector<std::string> &, const Expr &);
-    virtual Value eval(Assoc &) override;
+    std::shared_ptr<LambdaInfo> info;
+    std::shared_ptr<Value> closure;   ///< The one Procedure of a lambda without free variables
+    Lambda(const std::vector<std::string> &, const Expr &, int, const std::vector<int> &,
+           const std::vector<std::pair<int, int>> &);
+    virtual Value eval(Env &) override;
 };
 
 struct Define : ExprBase {
     std::string var;
     Expr e;
-    Define(const std::string &, const Expr &);
-    virtual Value eval(Assoc &) override;
+    int index;   ///< Slot in the current frame, -1 for a global definition
+    bool boxed;  ///< The slot holds a Box
+    GlobalCell *cell;   ///< Cached global binding, filled on first evaluation
+    Define(const std::string &, const Expr &, int);
+    void checkName() const;
+    void bind(Env &, const Value &);
+    virtual Value eval(Env &) override;
 };
 
 // ================================================================================
@@ -410,15 +552,19 @@ struct Define : ExprBase {
 struct Let : ExprBase {
     std::vector<std::pair<std::string, Expr>> bind;
     Expr body;
-    Let(const std::vector<std::pair<std::string, Expr>> &, const Expr &);
-    virtual Value eval(Assoc &) override;
+    int frame_size;
+    std::vector<int> boxed;   ///< Slots that hold a Box
+    Let(const std::vector<std::pair<std::string, Expr>> &, const Expr &, int, const std::vector<int> &);
+    virtual Value eval(Env &) override;
 };
 
 struct Letrec : ExprBase {
     std::vector<std::pair<std::string, Expr>> bind;
     Expr body;
-    Letrec(const std::vector<std::pair<std::string, Expr>> &, const Expr &);
-    virtual Value eval(Assoc &) override;
+    int frame_size;
+    std::vector<int> boxed;   ///< Slots that hold a Box
+    Letrec(const std::vector<std::pair<std::string, Expr>> &, const Expr &, int, const std::vector<int> &);
+    virtual Value eval(Env &) override;
 };
 
 // ================================================================================
@@ -428,8 +574,12 @@ struct Letrec : ExprBase {
 struct Set : ExprBase {
     std::string var;
     Expr e;
-    Set(const std::string &, const Expr &);
-    virtual Value eval(Assoc &) override;
+    int depth;   ///< Frames to walk up, -1 for a global variable
+    int index;   ///< Slot in the target frame
+    bool boxed;  ///< The slot holds a Box
+    GlobalCell *cell;   ///< Cached global binding, filled on first evaluation
+    Set(const std::string &, const Expr &, int, int);
+    virtual Value eval(Env &) override;
 };
 
 // ================================================================================
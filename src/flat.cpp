@@ -0,0 +1,505 @@
+/**
+ * @file flat.cpp
+ * @brief Flattening of Expr trees and the flat evaluator (see flat.hpp)
+ *
+ * The evaluator recurses on the C++ stack like ExprBase::eval. Its dispatch
+ * function keeps only the cheap cases inline and calls out for the rest, so
+ * a deep non-tail recursion needs no more stack than the tree walker. A tail
+ * call returns a marker to the nearest non-tail call, which runs it in a loop.
+ */
+
+#include "flat.hpp"
+#include "RE.hpp"
+#include "jit.hpp"
+#include <cctype>
+
+extern GlobalEnv global_env;
+Value apply_primitive(Primitive *, const Value *, int);
+Value finish_tail_calls(Value);
+
+namespace {
+
+// ============================================================================
+// Flattening
+// ============================================================================
+
+// Let::eval / Letrec::eval reject these names at runtime; leave them to the tree walker
+bool is_checked_name(const std::string &var) {
+    if (var.empty()) return false;
+    char first = var[0];
+    if (isdigit(static_cast<unsigned char>(first)) || first == '.' || first == '@') return false;
+    for (char c : var) {
+        if (c == '#' || c == '\'' || c == '"' || c == '`' || isspace(static_cast<unsigned char>(c))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_else_clause(const std::vector<Expr> &clause) {
+    Var *var = dynamic_cast<Var *>(clause[0].get());
+    return var != nullptr && var->x == "else";
+}
+
+class Flattener {
+    FlatBody &body;
+
+    int32_t add(uint8_t tag, int32_t a = 0, int32_t b = 0, int32_t c = 0, uint8_t flags = 0) {
+        body.nodes.push_back(FlatNode{tag, flags, a, b, c});
+        return body.nodes.size() - 1;
+    }
+
+    int32_t node(ExprBase *e) {
+        body.exprs.push_back(e);
+        return body.exprs.size() - 1;
+    }
+
+    int32_t fallback(ExprBase *e) { return add(FLAT_EVAL, 0, 0, node(e)); }
+
+    // 子节点先全部展平，再把它们的下标连续放进 lists，返回起点
+    int32_t list(const std::vector<int32_t> &children) {
+        int32_t start = body.lists.size();
+        body.lists.insert(body.lists.end(), children.begin(), children.end());
+        return start;
+    }
+
+    int32_t flattenVar(Var *var) {
+        return add(E_VAR, var->depth, var->index, node(var), var->boxed ? FLAT_BOXED : 0);
+    }
+
+    int32_t flattenBegin(Begin *begin, bool tail) {
+        std::vector<int32_t> children;
+        bool defines = false;
+        for (size_t i = 0; i < begin->es.size(); ++i) {
+            ExprBase *expr = begin->es[i].get();
+            if (!expr) continue;
+            if (auto *def = dynamic_cast<Define *>(expr)) {
+                // Begin::eval 只求值并写入预先创建的绑定，不再检查名字
+                defines = true;
+                children.push_back(add(E_DEFINE, flatten(def->e.get(), false), 0, node(def), FLAT_DEFINES));
+            } else {
+                children.push_back(flatten(expr, tail && i + 1 == begin->es.size()));
+            }
+        }
+        return add(E_BEGIN, list(children), children.size(), 0, defines ? FLAT_DEFINES : 0);
+    }
+
+    // 子句体有多个表达式时展平为不带 define 预绑定的 E_BEGIN
+    int32_t clauseBody(const std::vector<Expr> &clause, bool tail) {
+        if (clause.size() == 2) return flatten(clause[1].get(), tail);
+        std::vector<int32_t> children;
+        for (size_t j = 1; j < clause.size(); ++j) {
+            children.push_back(flatten(clause[j].get(), tail && j + 1 == clause.size()));
+        }
+        return add(E_BEGIN, list(children), children.size());
+    }
+
+    int32_t flattenCond(Cond *cond, bool tail) {
+        for (const auto &clause : cond->clauses) {
+            if (clause.empty()) return fallback(cond);
+        }
+        std::vector<int32_t> pairs;
+        for (const auto &clause : cond->clauses) {
+            bool is_else = is_else_clause(clause);
+            pairs.push_back(is_else ? NO_NODE : flatten(clause[0].get(), false));
+            if (clause.size() > 1) {
+                pairs.push_back(clauseBody(clause, tail));
+            } else {
+                pairs.push_back(is_else ? add(E_VOID) : NO_NODE);
+            }
+        }
+        return add(E_COND, list(pairs), cond->clauses.size());
+    }
+
+    int32_t flattenApply(Apply *apply, bool tail) {
+        int32_t rator = flatten(apply->rator.get(), false);
+        std::vector<int32_t> rands;
+        for (const auto &arg : apply->rand) {
+            rands.push_back(flatten(arg.get(), false));
+        }
+        return add(E_APPLY, rator, list(rands), rands.size(), tail ? FLAT_TAIL : 0);
+    }
+
+    template <class LetNode>
+    int32_t flattenLet(LetNode *let, bool tail) {
+        for (const auto &binding : let->bind) {
+            if (!is_checked_name(binding.first)) return fallback(let);
+        }
+        std::vector<int32_t> binds;
+        for (const auto &binding : let->bind) {
+            binds.push_back(flatten(binding.second.get(), false));
+        }
+        int32_t start = list(binds);
+        return add(let->e_type, flatten(let->body.get(), tail), start, node(let));
+    }
+
+    int32_t flattenAndOr(ExprBase *e, const std::vector<Expr> &rands, bool tail) {
+        std::vector<int32_t> children;
+        for (size_t i = 0; i < rands.size(); ++i) {
+            children.push_back(flatten(rands[i].get(), tail && i + 1 == rands.size()));
+        }
+        return add(e->e_type, list(children), children.size());
+    }
+
+public:
+    explicit Flattener(FlatBody &b) : body(b) {}
+
+    int32_t flatten(ExprBase *e, bool tail) {
+        if (!e) return add(E_VOID);
+        switch (e->e_type) {
+            case E_FIXNUM:
+                return add(E_FIXNUM, static_cast<Fixnum *>(e)->n);
+            case E_TRUE:
+            case E_FALSE:
+                return add(e->e_type);
+            case E_VAR:
+                return flattenVar(static_cast<Var *>(e));
+            case E_SET: {
+                Set *set = static_cast<Set *>(e);
+                return add(E_SET, flatten(set->e.get(), false), 0, node(set));
+            }
+            case E_DEFINE: {
+                Define *def = static_cast<Define *>(e);
+                return add(E_DEFINE, flatten(def->e.get(), false), 0, node(def));
+            }
+            case E_IF: {
+                If *ife = static_cast<If *>(e);
+                int32_t test = flatten(ife->cond.get(), false);
+                int32_t conseq = flatten(ife->conseq.get(), tail);
+                return add(E_IF, test, conseq, flatten(ife->alter.get(), tail));
+            }
+            case E_COND:
+                return flattenCond(static_cast<Cond *>(e), tail);
+            case E_BEGIN:
+                return flattenBegin(static_cast<Begin *>(e), tail);
+            case E_LET:
+                return flattenLet(static_cast<Let *>(e), tail);
+            case E_LETREC:
+                return flattenLet(static_cast<Letrec *>(e), tail);
+            case E_APPLY:
+                return flattenApply(static_cast<Apply *>(e), tail);
+            case E_AND:
+                return flattenAndOr(e, static_cast<AndVar *>(e)->rands, tail);
+            case E_OR:
+                return flattenAndOr(e, static_cast<OrVar *>(e)->rands, tail);
+            default:
+                break;
+        }
+        Literal *lit = dynamic_cast<Literal *>(e);
+        if (e->e_type == E_VOID && dynamic_cast<MakeVoid *>(e)) {
+            return add(E_VOID);
+        } else if (lit != nullptr && lit->value) {
+            body.consts.push_back(*lit->value);
+            return add(E_CONST, body.consts.size() - 1);
+        } else if (auto *u = dynamic_cast<Unary *>(e)) {
+            return add(e->e_type, flatten(u->rand.get(), false), 0, node(u));
+        } else if (auto *b = dynamic_cast<Binary *>(e)) {
+            int32_t rand1 = flatten(b->rand1.get(), false);
+            int32_t rand2 = flatten(b->rand2.get(), false);
+            return add(e->e_type, rand1, rand2, node(b), FLAT_BINARY);
+        } else if (auto *v = dynamic_cast<Variadic *>(e)) {
+            std::vector<int32_t> rands;
+            for (const auto &rand : v->rands) {
+                rands.push_back(flatten(rand.get(), false));
+            }
+            int32_t start = list(rands);
+            return add(e->e_type, start, rands.size(), node(v), FLAT_VARIADIC);
+        }
+        // lambda, exit, and quote of a datum the parser could not convert
+        return fallback(e);
+    }
+};
+
+// ============================================================================
+// Evaluation
+// ============================================================================
+
+Value tail_call_marker = SymbolV("#<flat-tail-call>");  // 按值字比较，只需是唯一的堆对象
+
+// 尾调用登记的被调过程与新帧，由最近的非尾调用循环执行
+struct {
+    Value proc = Value(nullptr);
+    Env env = Env(nullptr);
+} pending;
+
+Value eval(const FlatBody &, int32_t, Env &);
+
+const FlatBody &body_of(LambdaInfo &info) {
+    if (!info.flat) info.flat = flatten(info.e, true);
+    return *info.flat;
+}
+
+Value finish(Value result) {
+    while (result.w == tail_call_marker.w) {
+        // proc 持有 LambdaInfo，函数体在本轮循环内不会被释放
+        Value proc = std::move(pending.proc);
+        Env env = std::move(pending.env);
+        settle_frame(env.get());
+        const FlatBody &body = body_of(*static_cast<Procedure *>(proc.get())->info);
+        result = eval(body, body.root, env);
+    }
+    return result;
+}
+
+// 以下函数都不内联进 eval，递归时每层只多占一个小栈帧
+
+__attribute__((noinline)) Value evalVar(const FlatBody &body, const FlatNode &n, Env &env) {
+    Var *var = static_cast<Var *>(body.exprs[n.c]);
+    if (n.a < 0) {
+        if (var->cell != nullptr && !var->cell->v.empty()) return var->cell->v;
+        return var->eval(env);
+    }
+    Value &slot = lookup(env, n.a, n.b);
+    Value &v = (n.flags & FLAT_BOXED) ? unbox(slot) : slot;
+    if (v.empty()) return var->eval(env);   // 报告未定义的变量
+    return v;
+}
+
+__attribute__((noinline)) Value evalApply(const FlatBody &body, const FlatNode &n, Env &env) {
+    Value proc = eval(body, n.a, env);
+    ValueType type = proc.type();
+    if (type != V_PROC && type != V_PRIMITIVE) {
+        throw RuntimeError("Attempt to apply a non-procedure");
+    }
+    if (type == V_PRIMITIVE) {
+        StackArgs args(n.c);
+        for (int32_t i = 0; i < n.c; ++i) {
+            args.slots[i] = eval(body, body.lists[n.b + i], env);
+        }
+        return apply_primitive(static_cast<Primitive *>(proc.get()), args.slots, n.c);
+    }
+    Procedure *closure = static_cast<Procedure *>(proc.get());
+    LambdaInfo &info = *closure->info;
+    if (n.c != static_cast<int32_t>(info.x.size())) {
+        for (int32_t i = 0; i < n.c; ++i) {
+            eval(body, body.lists[n.b + i], env);
+        }
+        throw RuntimeError("Wrong number of arguments for lambda");
+    }
+    // 实参直接求值进值栈上的新帧
+    Env frame(stack_frame(info.frame_size, closure->env));
+    for (int32_t i = 0; i < n.c; ++i) {
+        frame->slots[i] = eval(body, body.lists[n.b + i], env);
+    }
+    box_slots(frame.get(), info.boxed);
+    Value result(nullptr);
+    if (jit_call(closure, frame, n.c, result)) return result;
+    if (n.flags & FLAT_TAIL) {
+        pending.proc = std::move(proc);
+        pending.env = std::move(frame);
+        return tail_call_marker;
+    }
+    const FlatBody &callee = body_of(info);
+    result = eval(callee, callee.root, frame);
+    // 不经过 finish 的栈帧，深的非尾递归每层少用一些栈
+    return result.w == tail_call_marker.w ? finish(std::move(result)) : result;
+}
+
+__attribute__((noinline)) Value evalBegin(const FlatBody &body, const FlatNode &n, Env &env) {
+    const int32_t *children = body.lists.data() + n.a;
+    if (n.flags & FLAT_DEFINES) {
+        // 先创建空绑定，留给之后的闭包用
+        for (int32_t i = 0; i < n.b; ++i) {
+            const FlatNode &child = body.nodes[children[i]];
+            if (child.tag == E_DEFINE && (child.flags & FLAT_DEFINES)) {
+                static_cast<Define *>(body.exprs[child.c])->bind(env, VoidV());
+            }
+        }
+    }
+    if (n.b == 0) return VoidV();
+    for (int32_t i = 0; i + 1 < n.b; ++i) {
+        eval(body, children[i], env);
+    }
+    return eval(body, children[n.b - 1], env);
+}
+
+__attribute__((noinline)) Value evalCond(const FlatBody &body, const FlatNode &n, Env &env) {
+    const int32_t *pairs = body.lists.data() + n.a;
+    for (int32_t i = 0; i < n.b; ++i) {
+        int32_t test = pairs[2 * i], then = pairs[2 * i + 1];
+        if (test == NO_NODE) return eval(body, then, env);
+        Value v = eval(body, test, env);
+        if (v.isFalse()) continue;
+        if (then == NO_NODE) return v;
+        return eval(body, then, env);
+    }
+    return VoidV();
+}
+
+__attribute__((noinline)) Value evalAndOr(const FlatBody &body, const FlatNode &n, Env &env) {
+    bool is_and = n.tag == E_AND;
+    if (n.b == 0) return BooleanV(is_and);
+    const int32_t *children = body.lists.data() + n.a;
+    for (int32_t i = 0; i + 1 < n.b; ++i) {
+        Value v = eval(body, children[i], env);
+        if (v.isFalse() == is_and) return v;
+    }
+    return eval(body, children[n.b - 1], env);
+}
+
+__attribute__((noinline)) Value evalLet(const FlatBody &body, const FlatNode &n, Env &env) {
+    Let *let = static_cast<Let *>(body.exprs[n.c]);
+    const int32_t *binds = body.lists.data() + n.b;
+    Env local(new Frame(let->frame_size, env));
+    for (size_t k = 0; k < let->bind.size(); ++k) {
+        local->slots[k] = eval(body, binds[k], env);
+    }
+    box_slots(local.get(), let->boxed);
+    return eval(body, n.a, local);
+}
+
+__attribute__((noinline)) Value evalLetrec(const FlatBody &body, const FlatNode &n, Env &env) {
+    Letrec *letrec = static_cast<Letrec *>(body.exprs[n.c]);
+    const int32_t *binds = body.lists.data() + n.b;
+    Env local(new Frame(letrec->frame_size, env));
+    for (size_t k = 0; k < letrec->bind.size(); ++k) {
+        local->slots[k] = VoidV();
+    }
+    box_slots(local.get(), letrec->boxed);
+    for (size_t k = 0; k < letrec->bind.size(); ++k) {
+        Value v = eval(body, binds[k], local);
+        Value &slot = local->slots[k];
+        (slot.type() == V_BOX ? unbox(slot) : slot) = v;
+    }
+    return eval(body, n.a, local);
+}
+
+__attribute__((noinline)) Value evalDefine(const FlatBody &body, const FlatNode &n, Env &env) {
+    Define *def = static_cast<Define *>(body.exprs[n.c]);
+    if (!(n.flags & FLAT_DEFINES)) {
+        def->checkName();
+        def->bind(env, VoidV());
+    }
+    Value v = eval(body, n.a, env);
+    def->bind(env, v);
+    return VoidV();
+}
+
+__attribute__((noinline)) Value evalSet(const FlatBody &body, const FlatNode &n, Env &env) {
+    Set *set = static_cast<Set *>(body.exprs[n.c]);
+    if (set->depth >= 0) {
+        Value &slot = lookup(env, set->depth, set->index);
+        if ((set->boxed ? unbox(slot) : slot).empty()) {
+            throw RuntimeError("the var has not been defined yet");
+        }
+        Value v = eval(body, n.a, env);
+        Value &target = lookup(env, set->depth, set->index);
+        (set->boxed ? unbox(target) : target) = v;
+        return VoidV();
+    }
+    if (set->cell == nullptr) {
+        set->cell = global_env.cell(set->var);
+    }
+    if (set->cell->v.empty()) {
+        throw RuntimeError("the var has not been defined yet");
+    }
+    Value v = eval(body, n.a, env);
+    set->cell->v = v;
+    return VoidV();
+}
+
+__attribute__((noinline)) Value evalUnary(const FlatBody &body, const FlatNode &n, Env &env) {
+    Value v = eval(body, n.a, env);
+    switch (n.tag) {
+        case E_CAR:
+            if (v.type() == V_PAIR) return static_cast<Pair *>(v.get())->car;
+            break;
+        case E_CDR:
+            if (v.type() == V_PAIR) return static_cast<Pair *>(v.get())->cdr;
+            break;
+        case E_NOT:
+            return BooleanV(v.isFalse());
+        case E_NULLQ:
+            return BooleanV(v.w == Value::NULL_WORD);
+        case E_PAIRQ:
+            return BooleanV(v.type() == V_PAIR);
+        default:
+            break;
+    }
+    return static_cast<Unary *>(body.exprs[n.c])->evalRator(v);
+}
+
+// 两个 fixnum 的算术与比较直接完成，溢出和其他类型交给节点的 evalRator
+__attribute__((noinline)) Value evalBinary(const FlatBody &body, const FlatNode &n, Env &env) {
+    Value v1 = eval(body, n.a, env);
+    Value v2 = eval(body, n.b, env);
+    if (v1.isFixnum() && v2.isFixnum()) {
+        int x = v1.fixnum(), y = v2.fixnum(), r;
+        switch (n.tag) {
+            case E_PLUS:
+                if (!__builtin_add_overflow(x, y, &r)) return IntegerV(r);
+                break;
+            case E_MINUS:
+                if (!__builtin_sub_overflow(x, y, &r)) return IntegerV(r);
+                break;
+            case E_MUL:
+                if (!__builtin_mul_overflow(x, y, &r)) return IntegerV(r);
+                break;
+            case E_LT: return BooleanV(x < y);
+            case E_LE: return BooleanV(x <= y);
+            case E_EQ: return BooleanV(x == y);
+            case E_GE: return BooleanV(x >= y);
+            case E_GT: return BooleanV(x > y);
+            default: break;
+        }
+    }
+    return static_cast<Binary *>(body.exprs[n.c])->evalRator(v1, v2);
+}
+
+__attribute__((noinline)) Value evalVariadic(const FlatBody &body, const FlatNode &n, Env &env) {
+    StackArgs args(n.b);
+    for (int32_t i = 0; i < n.b; ++i) {
+        args.slots[i] = eval(body, body.lists[n.a + i], env);
+    }
+    return static_cast<Variadic *>(body.exprs[n.c])->evalRator(args.slots, n.b);
+}
+
+Value eval(const FlatBody &body, int32_t i, Env &env) {
+  again:
+    const FlatNode &n = body.nodes[i];
+    switch (n.tag) {
+        case E_FIXNUM: return IntegerV(n.a);
+        case E_CONST: return body.consts[n.a];
+        case E_TRUE: return BooleanV(true);
+        case E_FALSE: return BooleanV(false);
+        case E_VOID: return VoidV();
+        case E_VAR:
+            // 当前帧中的局部变量最常见，直接读取
+            if (n.a == 0 && n.flags == 0 && !env->slots[n.b].empty()) return env->slots[n.b];
+            return evalVar(body, n, env);
+        case E_IF:
+            // 分支在本层继续求值，不再递归
+            i = eval(body, n.a, env).isFalse() ? n.c : n.b;
+            goto again;
+        case E_APPLY: return evalApply(body, n, env);
+        case E_BEGIN: return evalBegin(body, n, env);
+        case E_COND: return evalCond(body, n, env);
+        case E_AND:
+        case E_OR: return evalAndOr(body, n, env);
+        case E_LET: return evalLet(body, n, env);
+        case E_LETREC: return evalLetrec(body, n, env);
+        case E_DEFINE: return evalDefine(body, n, env);
+        case E_SET: return evalSet(body, n, env);
+        case FLAT_EVAL:
+            // 节点内尾位置的调用由树遍历解释器登记
+            return finish_tail_calls(body.exprs[n.c]->eval(env));
+        default:
+            break;
+    }
+    if (n.flags & FLAT_BINARY) return evalBinary(body, n, env);
+    if (n.flags & FLAT_VARIADIC) return evalVariadic(body, n, env);
+    return evalUnary(body, n, env);
+}
+
+} // namespace
+
+std::shared_ptr<FlatBody> flatten(const Expr &expr, bool body) {
+    std::shared_ptr<FlatBody> flat(new FlatBody());
+    flat->root = Flattener(*flat).flatten(expr.get(), body);
+    return flat;
+}
+
+Value flat_eval(const Expr &expr, Env &top) {
+    std::shared_ptr<FlatBody> body = flatten(expr, false);
+    return finish(eval(*body, body->root, top));
+}
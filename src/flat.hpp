@@ -0,0 +1,91 @@
+#ifndef FLAT_HPP
+#define FLAT_HPP
+
+/**
+ * @file flat.hpp
+ * @brief Flattened expression trees evaluated by tag dispatch
+ *
+ * flatten() copies the Expr tree of a lambda body (or of one top-level
+ * form) into a FlatBody: every node is a 16-byte FlatNode in one array,
+ * children are 32-bit indices into that array, and the evaluator switches
+ * on the node's ExprType instead of making a virtual call through a
+ * scattered shared_ptr. A hot loop then walks a few cache lines of nodes.
+ *
+ * Like the bytecode VM, the flat evaluator shares Frames and Procedures
+ * with the tree walker, and node kinds it does not flatten (exit, lambda,
+ * let with unusual variable names, ...) are run through ExprBase::eval.
+ * Lambda bodies are flattened on their first call.
+ */
+
+#include "Def.hpp"
+#include "expr.hpp"
+#include "value.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// Tag of a node run through ExprBase::eval, after the ExprType values
+const uint8_t FLAT_EVAL = E_DISPLAY + 1;
+
+// FlatNode::flags
+const uint8_t FLAT_BOXED = 1;     ///< E_VAR: the slot holds a Box
+const uint8_t FLAT_TAIL = 2;      ///< E_APPLY: in tail position of a lambda body
+const uint8_t FLAT_DEFINES = 4;   ///< E_BEGIN: pre-bind the internal defines; E_DEFINE: one of them
+const uint8_t FLAT_BINARY = 8;    ///< A primitive with two operands
+const uint8_t FLAT_VARIADIC = 16; ///< A primitive with a list of operands
+
+/**
+ * @brief One expression; the meaning of a, b and c depends on the tag
+ *
+ *   E_FIXNUM              a  the integer
+ *   E_CONST               a  index in FlatBody::consts
+ *   E_VAR                 a  depth (-1 for a global), b slot, c the Var
+ *   E_IF                  a  test, b consequent, c alternative
+ *   E_BEGIN, E_AND, E_OR  a  first child in FlatBody::lists, b number of children
+ *   E_COND                a  first of b (test, body) pairs in lists; NO_NODE for
+ *                           the test of else, or the body of a test-only clause
+ *   E_APPLY               a  operator, b first operand in lists, c number of operands
+ *   E_LET, E_LETREC       a  body, b first binding in lists, c the Let/Letrec
+ *   E_DEFINE, E_SET       a  value, c the Define/Set
+ *   unary primitives      a  operand, c the node
+ *   binary primitives     a, b operands, c the node
+ *   variadic primitives   a  first operand in lists, b number of operands, c the node
+ *   FLAT_EVAL             c  the node
+ * "The node" is an index in FlatBody::exprs. The arithmetic and comparison
+ * tags are shared by the binary and variadic nodes; the flags tell them apart.
+ */
+struct FlatNode {
+    uint8_t tag;      ///< ExprType, or FLAT_EVAL
+    uint8_t flags;
+    int32_t a;
+    int32_t b;
+    int32_t c;
+};
+
+const int32_t NO_NODE = -1;
+
+/**
+ * @brief The flattened nodes of one lambda body or top-level form
+ *
+ * exprs are borrowed from the Expr tree, which the owner of the body (a
+ * LambdaInfo, or the caller of flat_eval) keeps alive.
+ */
+struct FlatBody {
+    std::vector<FlatNode> nodes;
+    std::vector<int32_t> lists;     ///< Children of nodes with a variable number of them
+    std::vector<Value> consts;
+    std::vector<ExprBase *> exprs;
+    int32_t root;
+};
+
+/**
+ * @brief Flatten a top-level form, or a lambda body whose last call is a tail call
+ */
+std::shared_ptr<FlatBody> flatten(const Expr &, bool body);
+
+/**
+ * @brief Evaluate a top-level form with the flat evaluator
+ */
+Value flat_eval(const Expr &, Env &);
+
+#endif // FLAT_HPP
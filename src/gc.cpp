@@ -0,0 +1,196 @@
+/**
+ * @file gc.cpp
+ * @brief Cycle collector for reference-counted runtime objects
+ */
+
+#include "gc.hpp"
+#include <new>
+#include <vector>
+
+GcStats gc_stats = {0, 0, 0, 0, 0};
+
+namespace {
+
+GcObject *tracked_head = nullptr;   // most recently tracked object
+std::size_t allocations = 0;        // tracked objects created since the last collection
+std::size_t threshold = 10000;      // allocations that trigger the next collection
+bool collecting = false;
+
+// gc_release 期间引用计数归零的对象；首次使用时创建且不析构，静态初始化与析构期间也可用
+std::vector<GcObject *> *deferred = nullptr;
+
+const int REACHABLE = -1;
+
+// Size-classed allocator: objects up to MAX_SMALL bytes are carved from
+// ARENA_BLOCK-sized blocks and recycled through one free list per class.
+const std::size_t GRANULE = 16;
+const std::size_t MAX_SMALL = 256;
+const std::size_t ARENA_BLOCK = 64 * 1024;
+
+struct FreeCell {
+    FreeCell *next;
+};
+
+FreeCell *free_lists[MAX_SMALL / GRANULE + 1];
+char *bump = nullptr;       // next free byte of the current block
+char *bump_end = nullptr;
+
+struct SubtractInternal : GcVisitor {
+    void visit(GcObject *o) override {
+        if (o->tracked) --o->gc_refs;
+    }
+};
+
+struct MarkReachable : GcVisitor {
+    std::vector<GcObject *> &work;
+    explicit MarkReachable(std::vector<GcObject *> &w) : work(w) {}
+    void visit(GcObject *o) override {
+        if (o->tracked && o->gc_refs != REACHABLE) {
+            o->gc_refs = REACHABLE;
+            work.push_back(o);
+        }
+    }
+};
+
+} // namespace
+
+GcObject::GcObject(bool track)
+    : refs(0), tracked(track), gc_refs(0), gc_prev(nullptr), gc_next(nullptr) {
+    ++gc_stats.heap_objects;
+    if (!track) return;
+    // collect before linking: an object under construction has no references yet
+    if (++allocations >= threshold) {
+        gc_collect();
+    }
+    gc_next = tracked_head;
+    if (tracked_head != nullptr) tracked_head->gc_prev = this;
+    tracked_head = this;
+    ++gc_stats.tracked_objects;
+}
+
+GcObject::~GcObject() {
+    --gc_stats.heap_objects;
+    if (!tracked) return;
+    if (gc_prev != nullptr) gc_prev->gc_next = gc_next;
+    else tracked_head = gc_next;
+    if (gc_next != nullptr) gc_next->gc_prev = gc_prev;
+    --gc_stats.tracked_objects;
+}
+
+void GcObject::traceRefs(GcVisitor &) {}
+
+void GcObject::clearRefs() {}
+
+void *GcObject::operator new(std::size_t size) {
+    gc_stats.heap_bytes += size;
+    if (size > MAX_SMALL) {
+        return ::operator new(size);
+    }
+    std::size_t cls = (size + GRANULE - 1) / GRANULE;
+    if (FreeCell *cell = free_lists[cls]) {
+        free_lists[cls] = cell->next;
+        return cell;
+    }
+    std::size_t bytes = cls * GRANULE;
+    if (bump == nullptr || static_cast<std::size_t>(bump_end - bump) < bytes) {
+        // the tail of the old block is abandoned; blocks are never returned
+        bump = static_cast<char *>(::operator new(ARENA_BLOCK));
+        bump_end = bump + ARENA_BLOCK;
+    }
+    void *p = bump;
+    bump += bytes;
+    return p;
+}
+
+// sized delete: the virtual destructor passes the size of the dynamic type
+void GcObject::operator delete(void *p, std::size_t size) {
+    gc_stats.heap_bytes -= size;
+    if (size > MAX_SMALL) {
+        ::operator delete(p);
+        return;
+    }
+    FreeCell *cell = static_cast<FreeCell *>(p);
+    std::size_t cls = (size + GRANULE - 1) / GRANULE;
+    cell->next = free_lists[cls];
+    free_lists[cls] = cell;
+}
+
+bool gc_releasing = false;
+
+void gc_defer(GcObject *o) {
+    if (deferred == nullptr) deferred = new std::vector<GcObject *>();
+    deferred->push_back(o);
+}
+
+void gc_release_deferred() {
+    if (deferred != nullptr) {
+        while (!deferred->empty()) {
+            GcObject *next = deferred->back();
+            deferred->pop_back();
+            delete next;
+        }
+    }
+    gc_releasing = false;
+}
+
+/**
+ * @brief Free every tracked object unreachable from outside the heap
+ * @return Number of objects reclaimed
+ */
+std::size_t gc_collect() {
+    if (collecting) return 0;
+    collecting = true;
+
+    // 1. references held by other tracked objects do not keep an object alive
+    for (GcObject *o = tracked_head; o != nullptr; o = o->gc_next) {
+        o->gc_refs = o->refs;
+    }
+    SubtractInternal subtract;
+    for (GcObject *o = tracked_head; o != nullptr; o = o->gc_next) {
+        o->traceRefs(subtract);
+    }
+
+    // 2. objects still referenced from outside are roots; mark what they reach
+    std::vector<GcObject *> work;
+    for (GcObject *o = tracked_head; o != nullptr; o = o->gc_next) {
+        if (o->gc_refs > 0) {
+            o->gc_refs = REACHABLE;
+            work.push_back(o);
+        }
+    }
+    MarkReachable mark(work);
+    while (!work.empty()) {
+        GcObject *o = work.back();
+        work.pop_back();
+        o->traceRefs(mark);
+    }
+
+    // 3. hold the garbage, break its references, then let the counts free it
+    std::vector<GcObject *> garbage;
+    for (GcObject *o = tracked_head; o != nullptr; o = o->gc_next) {
+        if (o->gc_refs != REACHABLE) {
+            garbage.push_back(o);
+            ++o->refs;
+        }
+    }
+    for (GcObject *o : garbage) {
+        o->clearRefs();
+    }
+    for (GcObject *o : garbage) {
+        if (--o->refs == 0) gc_release(o);
+    }
+
+    ++gc_stats.collections;
+    gc_stats.freed += garbage.size();
+    allocations = 0;
+    threshold = gc_stats.tracked_objects > 10000 ? gc_stats.tracked_objects : 10000;
+    collecting = false;
+    return garbage.size();
+}
+
+void gc_print_stats(std::ostream &os) {
+    os << "heap: " << gc_stats.heap_objects << " objects, "
+       << gc_stats.heap_bytes << " bytes (" << gc_stats.tracked_objects << " tracked)\n"
+       << "gc: " << gc_stats.collections << " collections, "
+       << gc_stats.freed << " objects reclaimed\n";
+}
@@ -0,0 +1,95 @@
+#ifndef GC_HPP
+#define GC_HPP
+
+/**
+ * @file gc.hpp
+ * @brief Memory management of runtime objects (values and frames)
+ *
+ * Every heap object carries an intrusive reference count, so most garbage
+ * is freed as soon as the last Value/Env pointing at it goes away. Objects
+ * that can hold references (pairs, procedures, frames) are additionally
+ * "tracked" on a list scanned by a tracing collector, which reclaims the
+ * reference cycles counting cannot: a closure stored in its own frame by
+ * define/letrec, or a list closed with set-cdr!.
+ *
+ * A collection first subtracts from each tracked object's count the
+ * references held by other tracked objects. References that remain come
+ * from outside the heap -- global_env, the evaluator's and the VM's stacks,
+ * C++ temporaries -- so those objects are exactly the root set. Everything
+ * not reachable from a root is garbage.
+ *
+ * GcObject::operator new serves objects from size-classed arenas; freed
+ * cells go back to the free list of their class, so the fixed-size pairs,
+ * procedures and frames are recycled without calling malloc.
+ */
+
+#include <cstddef>
+#include <ostream>
+
+struct GcObject;
+
+/**
+ * @brief Callback used to enumerate the references held by an object
+ */
+struct GcVisitor {
+    virtual void visit(GcObject *) = 0;
+    virtual ~GcVisitor() = default;
+};
+
+/**
+ * @brief Base of every collected runtime object
+ */
+struct GcObject {
+    int refs;                    ///< Number of Value/Env handles pointing here
+    bool tracked;                ///< May hold references; on the collector's list
+    int gc_refs;                 ///< Scratch count during a collection
+    GcObject *gc_prev, *gc_next; ///< Links of the tracked-object list
+    explicit GcObject(bool);
+    GcObject(const GcObject &) = delete;
+    GcObject &operator=(const GcObject &) = delete;
+    virtual ~GcObject();
+    virtual void traceRefs(GcVisitor &);
+    virtual void clearRefs();
+    static void *operator new(std::size_t);
+    static void operator delete(void *, std::size_t);
+};
+
+/**
+ * @brief Heap statistics, updated on every allocation and collection
+ */
+struct GcStats {
+    std::size_t heap_bytes;       ///< Bytes held by live runtime objects
+    std::size_t heap_objects;     ///< Live runtime objects
+    std::size_t tracked_objects;  ///< Live objects on the collector's list
+    std::size_t collections;      ///< Collections run so far
+    std::size_t freed;            ///< Objects reclaimed by the collector so far
+};
+
+extern GcStats gc_stats;
+
+std::size_t gc_collect();
+
+void gc_print_stats(std::ostream &);
+
+extern bool gc_releasing;           ///< A gc_release is destroying an object
+void gc_defer(GcObject *);          ///< Queue an object freed during gc_release
+void gc_release_deferred();         ///< Free the queued objects
+
+/**
+ * @brief Free an object whose reference count dropped to zero
+ *
+ * Objects whose counts drop to zero while it is being destroyed are
+ * queued and freed one after another, so releasing a long list or a
+ * long chain of frames does not recurse once per element.
+ */
+inline void gc_release(GcObject *o) {
+    if (gc_releasing) {
+        gc_defer(o);
+        return;
+    }
+    gc_releasing = true;
+    delete o;
+    gc_release_deferred();
+}
+
+#endif // GC_HPP
@@ -0,0 +1,482 @@
+/**
+ * @file jit.cpp
+ * @brief Template JIT for hot lambda bodies (Linux x86-64)
+ *
+ * Native calling convention: `uintptr_t fn(uintptr_t *args, uintptr_t limit)`.
+ * args holds the tagged words of the parameters and may be overwritten (a
+ * self tail call reuses it); limit is the lowest stack address the code may
+ * reach. The result is a tagged fixnum, boolean or void word, or 0 when the
+ * code bailed out. Register use inside the body:
+ *   rbx  args of the current call       r12  stack limit
+ *   rax  value of the last expression   rcx, rdx  scratch
+ */
+
+#include "jit.hpp"
+#include "RE.hpp"
+#include <vector>
+
+#if defined(ENABLE_JIT) && defined(__x86_64__) && defined(__linux__)
+#define JIT_NATIVE 1
+#include <sys/mman.h>
+#include <pthread.h>
+#else
+#define JIT_NATIVE 0
+#endif
+
+extern GlobalEnv global_env;
+Value finish_tail_calls(Value);
+
+JitOptions jit_options = {true, false, 1000};
+
+typedef uintptr_t (*NativeFn)(uintptr_t *, uintptr_t);
+
+/**
+ * @brief Native code of one lambda body
+ */
+struct JitCode {
+    NativeFn entry;                     ///< nullptr if the body is not compilable
+    void *memory;                       ///< Executable mapping holding the code
+    size_t size;
+    std::vector<GlobalCell *> self;     ///< Globals the body calls as itself
+    int bailouts;                       ///< Runs abandoned so far
+    JitCode() : entry(nullptr), memory(nullptr), size(0), bailouts(0) {}
+    ~JitCode();
+};
+
+JitCode::~JitCode() {
+#if JIT_NATIVE
+    if (memory != nullptr) munmap(memory, size);
+#endif
+}
+
+namespace {
+
+const int MAX_PARAMS = 15;                  // [rbx + 8*i] keeps an 8-bit displacement
+const int MAX_BAILOUTS = 8;                 // then the lambda stays interpreted
+const uintptr_t STACK_BUDGET = 1 << 20;     // native recursion gets at most 1 MiB
+const uintptr_t STACK_RESERVE = 64 << 10;   // left untouched at the bottom of the stack
+
+// 全局名字当前是否绑定到这个 lambda 的闭包（未定义的名字其单元为空值）
+bool holds(const GlobalCell *cell, const LambdaInfo &info) {
+    return cell->v.isHeap() && cell->v.get()->v_type == V_PROC &&
+           static_cast<Procedure *>(cell->v.get())->info.get() == &info;
+}
+
+#if JIT_NATIVE
+
+/**
+ * @brief Byte buffer with rel32 labels
+ */
+class Assembler {
+public:
+    std::vector<unsigned char> code;
+
+    void byte(unsigned b) { code.push_back(static_cast<unsigned char>(b)); }
+
+    void bytes(std::initializer_list<unsigned> bs) {
+        for (unsigned b : bs) byte(b);
+    }
+
+    void imm32(uint32_t v) {
+        for (int i = 0; i < 4; ++i) byte((v >> (8 * i)) & 0xff);
+    }
+
+    void imm64(uint64_t v) {
+        for (int i = 0; i < 8; ++i) byte((v >> (8 * i)) & 0xff);
+    }
+
+    int label() {
+        labels.push_back(-1);
+        return labels.size() - 1;
+    }
+
+    void bind(int l) { labels[l] = code.size(); }
+
+    // 跳转/调用指令的 rel32 操作数，先占位，finish() 时回填
+    void rel32(int l) {
+        fixups.push_back(std::make_pair(code.size(), l));
+        imm32(0);
+    }
+
+    void finish() {
+        for (const auto &f : fixups) {
+            int32_t rel = labels[f.second] - static_cast<int>(f.first + 4);
+            for (int i = 0; i < 4; ++i) code[f.first + i] = (static_cast<uint32_t>(rel) >> (8 * i)) & 0xff;
+        }
+    }
+
+private:
+    std::vector<int> labels;
+    std::vector<std::pair<size_t, int>> fixups;
+};
+
+enum Kind { K_FIXNUM, K_ANY };   // 表达式结果是否一定是 fixnum
+
+/**
+ * @brief Emits the templates for one lambda body
+ *
+ * check() walks the body first, so compile() only runs on supported forms.
+ */
+class Emitter {
+    const LambdaInfo &info;
+    Assembler &a;
+    std::vector<GlobalCell *> &self;
+    int entry, check_args, bail;
+
+    bool selfCall(ExprBase *e) {
+        Apply *apply = dynamic_cast<Apply *>(e);
+        if (apply == nullptr || apply->rand.size() != info.x.size()) return false;
+        Var *var = dynamic_cast<Var *>(apply->rator.get());
+        if (var == nullptr || var->depth >= 0) return false;
+        GlobalCell *cell = global_env.cell(var->x);
+        if (!holds(cell, info)) return false;
+        for (GlobalCell *c : self) {
+            if (c == cell) return true;
+        }
+        self.push_back(cell);
+        return true;
+    }
+
+    static bool arithmetic(ExprType t) { return t == E_PLUS || t == E_MINUS || t == E_MUL; }
+
+    static bool comparison(ExprType t) {
+        return t == E_LT || t == E_LE || t == E_EQ || t == E_GE || t == E_GT;
+    }
+
+    // 叶子节点：直接装入 rax 或 rcx，不占用栈
+    static bool leaf(ExprBase *e) {
+        return e->e_type == E_FIXNUM || e->e_type == E_VAR;
+    }
+
+    void loadLeaf(ExprBase *e, bool into_rcx) {
+        if (e->e_type == E_FIXNUM) {
+            bytes({0x48, into_rcx ? 0xB9u : 0xB8u});                       // movabs r, imm64
+            a.imm64(IntegerV(static_cast<Fixnum *>(e)->n).w);
+        } else {
+            bytes({0x48, 0x8B, into_rcx ? 0x4Bu : 0x43u, static_cast<unsigned>(8 * static_cast<Var *>(e)->index)});  // mov r, [rbx+8i]
+        }
+    }
+
+    void bytes(std::initializer_list<unsigned> bs) { a.bytes(bs); }
+
+    void jump(unsigned cc, int l) {   // 0F 8x rel32
+        bytes({0x0F, cc});
+        a.rel32(l);
+    }
+
+    void requireFixnum(Kind k) {
+        if (k == K_FIXNUM) return;
+        bytes({0xA8, 0x01});   // test al, 1
+        jump(0x84, bail);      // jz bail
+    }
+
+    // rand1 -> rax, rand2 -> rcx
+    void operands(Binary *b) {
+        Kind k1 = compile(b->rand1.get(), false);
+        requireFixnum(k1);
+        if (leaf(b->rand2.get())) {
+            loadLeaf(b->rand2.get(), true);
+            return;
+        }
+        bytes({0x50});                                   // push rax
+        Kind k2 = compile(b->rand2.get(), false);
+        requireFixnum(k2);
+        bytes({0x48, 0x89, 0xC1});                       // mov rcx, rax
+        bytes({0x58});                                   // pop rax
+    }
+
+    void emitArithmetic(Binary *b) {
+        operands(b);
+        bytes({0x48, 0xD1, 0xF8});                       // sar rax, 1
+        bytes({0x48, 0xD1, 0xF9});                       // sar rcx, 1
+        switch (b->e_type) {
+            case E_PLUS: bytes({0x48, 0x01, 0xC8}); break;          // add rax, rcx
+            case E_MINUS: bytes({0x48, 0x29, 0xC8}); break;         // sub rax, rcx
+            default: bytes({0x48, 0x0F, 0xAF, 0xC1}); break;        // imul rax, rcx
+        }
+        bytes({0x48, 0x63, 0xD0});                       // movsxd rdx, eax
+#ifdef INT32_WRAP
+        bytes({0x48, 0x89, 0xD0});                       // mov rax, rdx：按 32 位回绕
+#else
+        bytes({0x48, 0x39, 0xC2});                       // cmp rdx, rax
+        jump(0x85, bail);                                // 超出 int：交给解释器提升为大整数
+#endif
+        bytes({0x48, 0x8D, 0x44, 0x00, 0x01});           // lea rax, [rax+rax+1]
+    }
+
+    void emitComparison(Binary *b) {
+        operands(b);
+        unsigned cmov;
+        switch (b->e_type) {
+            case E_LT: cmov = 0x4C; break;
+            case E_LE: cmov = 0x4E; break;
+            case E_EQ: cmov = 0x44; break;
+            case E_GE: cmov = 0x4D; break;
+            default: cmov = 0x4F; break;
+        }
+        // 带标签的 fixnum 字保持大小顺序，可直接比较
+        bytes({0x48, 0x39, 0xC8});                       // cmp rax, rcx
+        bytes({0xB8});                                   // mov eax, #f
+        a.imm32(Value::FALSE_WORD);
+        bytes({0xBA});                                   // mov edx, #t
+        a.imm32(Value::TRUE_WORD);
+        bytes({0x0F, cmov, 0xC2});                       // cmovcc eax, edx
+    }
+
+    void emitIf(If *e, bool tail) {
+        int alter = a.label(), end = a.label();
+        compile(e->cond.get(), false);
+        bytes({0x48, 0x83, 0xF8, static_cast<unsigned>(Value::FALSE_WORD)});   // cmp rax, #f
+        jump(0x84, alter);
+        compile(e->conseq.get(), tail);
+        bytes({0xE9});                                   // jmp end
+        a.rel32(end);
+        a.bind(alter);
+        compile(e->alter.get(), tail);
+        a.bind(end);
+    }
+
+    // 实参从右到左压栈，rsp 即指向新的 args 数组
+    void emitSelfCall(Apply *e, bool tail) {
+        int n = e->rand.size();
+        for (int i = n - 1; i >= 0; --i) {
+            compile(e->rand[i].get(), false);
+            bytes({0x50});                               // push rax
+        }
+        if (tail && e->tail) {
+            // 尾调用：覆盖当前 args 后跳回参数检查
+            for (int i = 0; i < n; ++i) {
+                bytes({0x58});                           // pop rax
+                bytes({0x48, 0x89, 0x43, static_cast<unsigned>(8 * i)});   // mov [rbx+8i], rax
+            }
+            bytes({0xE9});
+            a.rel32(check_args);
+            return;
+        }
+        bytes({0x48, 0x89, 0xE7});                       // mov rdi, rsp
+        bytes({0x4C, 0x89, 0xE6});                       // mov rsi, r12
+        bytes({0xE8});                                   // call entry
+        a.rel32(entry);
+        bytes({0x48, 0x81, 0xC4});                       // add rsp, 8n
+        a.imm32(8 * n);
+        bytes({0x48, 0x85, 0xC0});                       // test rax, rax
+        jump(0x84, bail);                                // 被调用者放弃：整个调用交给解释器
+    }
+
+public:
+    Emitter(const LambdaInfo &i, Assembler &as, std::vector<GlobalCell *> &s)
+        : info(i), a(as), self(s), entry(as.label()), check_args(as.label()), bail(as.label()) {}
+
+    /**
+     * @brief Whether every subform of e has a template
+     */
+    bool check(ExprBase *e) {
+        if (e == nullptr) return false;
+        if (e->e_type == E_FIXNUM || e->e_type == E_TRUE || e->e_type == E_FALSE) return true;
+        if (e->e_type == E_VOID) return dynamic_cast<MakeVoid *>(e) != nullptr;
+        if (e->e_type == E_VAR) {
+            Var *var = static_cast<Var *>(e);
+            return var->depth == 0 && !var->boxed && var->index < static_cast<int>(info.x.size());
+        }
+        if (arithmetic(e->e_type) || comparison(e->e_type)) {
+            Binary *b = dynamic_cast<Binary *>(e);
+            return b != nullptr && check(b->rand1.get()) && check(b->rand2.get()) &&
+                   operand(b->rand1.get()) && operand(b->rand2.get());
+        }
+        if (e->e_type == E_IF) {
+            If *i = static_cast<If *>(e);
+            return check(i->cond.get()) && check(i->conseq.get()) && check(i->alter.get());
+        }
+        if (e->e_type == E_APPLY && selfCall(e)) {
+            for (const auto &arg : static_cast<Apply *>(e)->rand) {
+                if (!check(arg.get())) return false;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    // 常量 #t/#f/void 作算术操作数必然出错，留给解释器报告
+    static bool operand(ExprBase *e) {
+        return e->e_type != E_TRUE && e->e_type != E_FALSE && e->e_type != E_VOID;
+    }
+
+    Kind compile(ExprBase *e, bool tail) {
+        switch (e->e_type) {
+            case E_FIXNUM:
+            case E_VAR:
+                loadLeaf(e, false);
+                return K_FIXNUM;   // 入口已检查参数都是 fixnum
+            case E_TRUE:
+            case E_FALSE:
+            case E_VOID:
+                bytes({0xB8});   // mov eax, imm32
+                a.imm32(e->e_type == E_TRUE ? Value::TRUE_WORD
+                        : e->e_type == E_FALSE ? Value::FALSE_WORD : Value::VOID_WORD);
+                return K_ANY;
+            case E_IF:
+                emitIf(static_cast<If *>(e), tail);
+                return K_ANY;
+            case E_APPLY:
+                emitSelfCall(static_cast<Apply *>(e), tail);
+                return K_ANY;
+            default:
+                break;
+        }
+        if (arithmetic(e->e_type)) {
+            emitArithmetic(static_cast<Binary *>(e));
+            return K_FIXNUM;
+        }
+        emitComparison(static_cast<Binary *>(e));
+        return K_ANY;
+    }
+
+    void function() {
+        int epilogue = a.label();
+        a.bind(entry);
+        bytes({0x55});                                   // push rbp
+        bytes({0x48, 0x89, 0xE5});                       // mov rbp, rsp
+        bytes({0x53});                                   // push rbx
+        bytes({0x41, 0x54});                             // push r12
+        bytes({0x48, 0x89, 0xFB});                       // mov rbx, rdi
+        bytes({0x49, 0x89, 0xF4});                       // mov r12, rsi
+        a.bind(check_args);
+        bytes({0x4C, 0x39, 0xE4});                       // cmp rsp, r12
+        jump(0x82, bail);                                // jb bail：栈预算用完
+        for (size_t i = 0; i < info.x.size(); ++i) {
+            bytes({0xF6, 0x43, static_cast<unsigned>(8 * i), 0x01});   // test byte [rbx+8i], 1
+            jump(0x84, bail);                            // 参数不是 fixnum
+        }
+        compile(info.e.get(), true);
+        a.bind(epilogue);
+        bytes({0x48, 0x8D, 0x65, 0xF0});                 // lea rsp, [rbp-16]
+        bytes({0x41, 0x5C});                             // pop r12
+        bytes({0x5B});                                   // pop rbx
+        bytes({0x5D});                                   // pop rbp
+        bytes({0xC3});                                   // ret
+        a.bind(bail);
+        bytes({0x31, 0xC0});                             // xor eax, eax
+        bytes({0xE9});
+        a.rel32(epilogue);
+        a.finish();
+    }
+};
+
+std::shared_ptr<JitCode> compile(const LambdaInfo &info) {
+    std::shared_ptr<JitCode> jit(new JitCode());
+    if (info.x.size() > static_cast<size_t>(MAX_PARAMS) || !info.boxed.empty() ||
+        info.frame_size != static_cast<int>(info.x.size())) {
+        return jit;
+    }
+    Assembler a;
+    Emitter emitter(info, a, jit->self);
+    if (!emitter.check(info.e.get())) {
+        jit->self.clear();
+        return jit;
+    }
+    emitter.function();
+    // 先写入可写映射，再改为只读可执行
+    size_t size = a.code.size();
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return jit;
+    std::copy(a.code.begin(), a.code.end(), static_cast<unsigned char *>(memory));
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return jit;
+    }
+    jit->memory = memory;
+    jit->size = size;
+    jit->entry = reinterpret_cast<NativeFn>(memory);
+    return jit;
+}
+
+// 栈的最低可用地址；主线程的栈大小按 RLIMIT_STACK 计算
+uintptr_t stack_floor() {
+    static uintptr_t floor = 0;
+    if (floor == 0) {
+        pthread_attr_t attr;
+        void *addr = nullptr;
+        size_t size = 0;
+        if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+            pthread_attr_getstack(&attr, &addr, &size);
+            pthread_attr_destroy(&attr);
+        }
+        floor = reinterpret_cast<uintptr_t>(addr) + STACK_RESERVE;
+    }
+    return floor;
+}
+
+bool checking = false;   // --jit-check 正在用解释器复算，期间不进入本地代码
+
+// 本地代码没有副作用，复算一次不会改变程序行为
+void verify(Procedure *proc, Env &frame, int argc, const Value &native) {
+    checking = true;
+    Value expected(nullptr);
+    try {
+        expected = finish_tail_calls(proc->info->e->eval(frame));
+    } catch (...) {
+        checking = false;
+        throw;
+    }
+    checking = false;
+    // 本地代码只产生立即数，值相同当且仅当值字相同
+    if (expected.w != native.w) {
+        std::cerr << "jit mismatch: (";
+        for (int i = 0; i < argc; ++i) {
+            if (i > 0) std::cerr << ' ';
+            frame->slots[i].show(std::cerr);
+        }
+        std::cerr << ") native ";
+        native.show(std::cerr);
+        std::cerr << ", interpreter ";
+        expected.show(std::cerr);
+        std::cerr << "\n";
+    }
+}
+
+#else
+
+std::shared_ptr<JitCode> compile(const LambdaInfo &) {
+    return std::shared_ptr<JitCode>(new JitCode());
+}
+
+#endif
+
+} // namespace
+
+bool jit_call(Procedure *proc, Env &frame, int argc, Value &result) {
+    LambdaInfo &info = *proc->info;
+    JitCode *jit = info.jit.get();
+    if (jit == nullptr) {
+        if (!jit_options.enabled || ++info.calls < jit_options.threshold) return false;
+        info.jit = compile(info);
+        jit = info.jit.get();
+    }
+#if JIT_NATIVE
+    if (jit->entry == nullptr || checking) return false;
+    // 自调用按全局名字直接跳转：名字必须仍绑定到这个 lambda 的闭包（本地代码不会修改全局变量）
+    for (GlobalCell *cell : jit->self) {
+        if (!holds(cell, info)) return false;
+    }
+    uintptr_t args[MAX_PARAMS];
+    for (int i = 0; i < argc; ++i) {
+        const Value &arg = frame->slots[i];
+        if (!arg.isFixnum()) return false;
+        args[i] = arg.w;
+    }
+    char here;
+    uintptr_t sp = reinterpret_cast<uintptr_t>(&here);
+    uintptr_t limit = sp - STACK_BUDGET > stack_floor() ? sp - STACK_BUDGET : stack_floor();
+    uintptr_t word = jit->entry(args, limit);
+    if (word == 0) {
+        // 放弃得太频繁（结果常需大整数、递归太深）就不再尝试
+        if (++jit->bailouts >= MAX_BAILOUTS) jit->entry = nullptr;
+        return false;
+    }
+    result = Value::raw(word);
+    if (jit_options.check) verify(proc, frame, argc, result);
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,39 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+
+/**
+ * @file jit.hpp
+ * @brief Template JIT compiling hot lambda bodies to x86-64 machine code
+ *
+ * Every call of a Procedure is counted on its LambdaInfo. Past the threshold
+ * the body is compiled once, by stitching fixed machine code templates, if it
+ * only uses what the templates cover: fixnum parameters and constants, the
+ * binary + - * < <= = >= >, if, and calls of the procedure itself through its
+ * global name. Native code works on tagged fixnum words and never allocates;
+ * on a case it cannot finish (an overflow that must become a bignum, a
+ * non-fixnum operand, too deep a recursion) it bails out and the call is
+ * interpreted from the start. Built only on Linux x86-64 with ENABLE_JIT,
+ * elsewhere every call is interpreted.
+ */
+
+#include "value.hpp"
+
+/**
+ * @brief Command-line controls of the JIT
+ */
+struct JitOptions {
+    bool enabled;    ///< --no-jit clears it
+    bool check;      ///< --jit-check: compare every native result with the interpreter
+    int threshold;   ///< Calls of a lambda before its body is compiled
+};
+extern JitOptions jit_options;
+
+/**
+ * @brief Run a call natively if its lambda is (or just became) compiled
+ * @param frame The callee frame, arguments in its first slots
+ * @param result Set to the value of the call when true is returned
+ * @return false if the call must be interpreted
+ */
+bool jit_call(Procedure *, Env &frame, int argc, Value &result);
+
+#endif // JIT_HPP
@@ -1,82 +1,60 @@
-#include "Def.hpp"
-#include "syntax.hpp"
-#include "expr.hpp"
-#include "value.hpp"
-#include "RE.hpp"
-#include <sstream>
+#include "gc.hpp"
+#include "jit.hpp"
+#include "output.hpp"
+#include "printer.hpp"
+#include "repl.hpp"
+#include <cerrno>
+#include <cstring>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <unistd.h>
+#include <vector>
 
-extern std::map<std::string, ExprType> primitives;
-extern std::map<std::string, ExprType> reserved_words;
-extern Assoc global_env;
-
-bool isExplicitVoidCall(Expr expr) {
-    MakeVoid* make_void_expr = dynamic_cast<MakeVoid*>(expr.get());
-    if (make_void_expr != nullptr) {
-        return true;
-    }
-
-    Apply* apply_expr = dynamic_cast<Apply*>(expr.get());
-    if (apply_expr != nullptr) {
-        Var* var_expr = dynamic_cast<Var*>(apply_expr->rator.get());
-        if (var_expr != nullptr && var_expr->x == "void") {
-            return true;
+int main(int argc, char *argv[]) {
+    // code [选项] [file.scm ...]：给出文件时按顺序执行这些文件，否则从标准输入读入
+    // --vm: 使用字节码虚拟机执行，默认为树遍历解释
+    // --flat: 使用展平为连续数组的表达式树执行
+    // --gc-stats: 退出时向 stderr 输出堆大小与回收次数
+    // --no-optimize: 关闭常量折叠
+    // --dump-optimized: 求值前把折叠后的形式输出到 stderr
+    // --no-jit: 不把热点 lambda 编译为本地代码
+    // --jit-check: 首次调用即编译，并用解释器复算每个本地调用，不一致时向 stderr 报告
+    // --print-shared: 输出时给所有共享的序对加标号（默认只给环上的序对加）
+    ReplOptions opts;
+    bool gc_stats_on_exit = false;
+    std::vector<std::unique_ptr<Reader>> files;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--vm") == 0) opts.use_vm = true;
+        else if (strcmp(argv[i], "--flat") == 0) opts.use_flat = true;
+        else if (strcmp(argv[i], "--gc-stats") == 0) gc_stats_on_exit = true;
+        else if (strcmp(argv[i], "--no-optimize") == 0) opts.optimize = false;
+        else if (strcmp(argv[i], "--dump-optimized") == 0) opts.dump_optimized = true;
+        else if (strcmp(argv[i], "--no-jit") == 0) jit_options.enabled = false;
+        else if (strcmp(argv[i], "--jit-check") == 0) {
+            jit_options.check = true;
+            jit_options.threshold = 1;
+        } else if (strcmp(argv[i], "--print-shared") == 0) {
+            print_shared_labels = true;
+        } else if (strncmp(argv[i], "--", 2) != 0) {
+            // 先打开全部文件，有一个打不开就什么也不执行
+            files.emplace_back(Reader::open(argv[i]));
+            if (files.back() == nullptr) {
+                std::cerr << argv[0] << ": " << argv[i] << ": " << strerror(errno) << "\n";
+                return 1;
+            }
         }
     }
-
-    Begin* begin_expr = dynamic_cast<Begin*>(expr.get());
-    if (begin_expr != nullptr && !begin_expr->es.empty()) {
-        return isExplicitVoidCall(begin_expr->es.back());
-    }
-
-    If* if_expr = dynamic_cast<If*>(expr.get());
-    if (if_expr != nullptr) {
-        return isExplicitVoidCall(if_expr->conseq) || isExplicitVoidCall(if_expr->alter);
+    if (files.empty()) {
+        Reader reader(STDIN_FILENO);
+        REPL(reader, opts);
     }
-
-    Cond* cond_expr = dynamic_cast<Cond*>(expr.get());
-    if (cond_expr != nullptr) {
-        for (const auto& clause : cond_expr->clauses) {
-            if (clause.size() > 1 && isExplicitVoidCall(clause.back())) {
-                return true;
-            }
-        }
+    for (auto &file : files) {
+        if (!REPL(*file, opts)) break; // (exit) 结束整个程序
     }
-    return false;
-}
-
-void REPL(){
-    // read - evaluation - print loop
-    global_env = empty();
-    while (1){
-        // #ifndef ONLINE_JUDGE
-        //     std::cout << "scm> ";
-        // #endif
-        Syntax stx = readSyntax(std :: cin); // read
-        try{
-            Expr expr = stx -> parse(global_env); // parse
-            // stx -> show(std :: cout); // syntax print
-            Value val = expr -> eval(global_env);
-            if (val -> v_type == V_TERMINATE)
-                break;
-            if (val -> v_type != V_VOID || isExplicitVoidCall(expr)) {
-                val -> show(std :: cout);
-                puts("");// value print
-            }
-        }
-        catch (const RuntimeError &RE){
-            #ifndef ONLINE_JUDGE
-                std :: cout << RE.what();
-            #endif
-            std :: cout << "RuntimeError" << "\n";
-        }
-        // puts("");
+    output_flush();
+    if (gc_stats_on_exit) {
+        gc_collect();
+        gc_print_stats(std::cerr);
     }
-}
-
-
-int main(int argc, char *argv[]) {
-    REPL();
     return 0;
 }
@@ -0,0 +1,40 @@
+#ifndef NUMBER_HPP
+#define NUMBER_HPP
+
+/**
+ * @file number.hpp
+ * @brief Numeric kernels shared by the arithmetic and comparison primitives
+ *
+ * Each operand is classified as a fixnum, a rational, a bignum or a big
+ * rational, and the pair of kinds selects a kernel compiled for exactly that
+ * combination. Two fixnums never reach the table: the operation is done in
+ * 64 bits and only a result outside the int range is promoted to a Bignum
+ * (or wrapped to 32 bits when built with INT32_WRAP, matching the reference
+ * judge). Rationals follow the same scheme one level up: checked 64-bit
+ * parts, reduced lazily, promoted to BigRational only when they overflow.
+ */
+
+#include "value.hpp"
+
+bool isNumber(const Value &);
+bool isInteger(const Value &);
+
+Value num_add(const Value &, const Value &);
+Value num_sub(const Value &, const Value &);
+Value num_mul(const Value &, const Value &);
+Value num_div(const Value &, const Value &);
+
+/**
+ * @brief Three-way numeric comparison
+ * @return Negative, zero or positive as the first operand is less than,
+ *         equal to or greater than the second
+ */
+int num_compare(const Value &, const Value &);
+
+/**
+ * @brief Remainder of integer division, with the sign of the dividend
+ */
+Value num_modulo(const Value &, const Value &);
+Value num_expt(const Value &, const Value &);
+
+#endif // NUMBER_HPP
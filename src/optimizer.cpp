@@ -0,0 +1,404 @@
+/**
+ * @file optimizer.cpp
+ * @brief Constant folding over parsed Expr trees
+ *
+ * The parser only builds a primitive node such as Plus when the operator
+ * name is not lexically bound (see List::parse), and such nodes never look
+ * at a global redefinition, so a shadowed `+` is already an Apply here and
+ * is left alone. Evaluating a primitive node whose operands are constants
+ * therefore gives exactly the value the evaluator would compute. Only
+ * primitives without side effects are folded, and only when the result is
+ * a number or a boolean; an operation that raises an error is kept so the
+ * error still happens when (and if) the form is evaluated.
+ *
+ * Folding a node costs as much as evaluating it and then some (the
+ * replacement node is allocated), so only code that can run more than
+ * once -- lambda bodies -- is rewritten; the rest of a top-level form is
+ * merely walked to reach the lambdas inside it.
+ */
+
+#include "optimizer.hpp"
+#include "value.hpp"
+#include "number.hpp"
+#include "RE.hpp"
+#include <map>
+#include <stdexcept>
+
+extern std::map<std::string, ExprType> primitives;
+
+namespace {
+
+/**
+ * @brief Value of a node that always evaluates to the same datum
+ */
+bool constant_value(ExprBase *e, Value &v) {
+    switch (e->e_type) {
+        case E_FIXNUM:
+            v = IntegerV(static_cast<Fixnum *>(e)->n);
+            return true;
+        case E_TRUE:
+        case E_FALSE:
+            v = BooleanV(e->e_type == E_TRUE);
+            return true;
+        default:
+            break;
+    }
+    Literal *lit = dynamic_cast<Literal *>(e);
+    if (lit == nullptr || !lit->value) return false;
+    v = *lit->value;
+    return true;
+}
+
+bool is_constant(const Expr &e) {
+    Value v(nullptr);
+    return e.get() != nullptr && constant_value(e.get(), v);
+}
+
+// 没有副作用的原语：参数全为常量时可以在解析后直接求值
+bool is_pure(ExprType t) {
+    switch (t) {
+        case E_PLUS: case E_MINUS: case E_MUL: case E_DIV: case E_MODULO: case E_EXPT:
+        case E_LT: case E_LE: case E_EQ: case E_GE: case E_GT:
+        case E_NOT: case E_AND: case E_OR:
+        case E_EQQ: case E_BOOLQ: case E_INTQ: case E_NULLQ: case E_PAIRQ:
+        case E_PROCQ: case E_SYMBOLQ: case E_LISTQ: case E_STRINGQ:
+            return true;
+        default:
+            return false;
+    }
+}
+
+Expr constant_expr(const Value &v) {
+    if (v.isFixnum()) return Expr(new Fixnum(v.fixnum()));
+    if (v.type() == V_BOOL) return v.isFalse() ? Expr(new False()) : Expr(new True());
+    return Expr(new Constant(v));
+}
+
+bool is_else(const Expr &e) {
+    Var *var = dynamic_cast<Var *>(e.get());
+    return var != nullptr && var->x == "else";
+}
+
+Expr fold(const Expr &, bool);
+
+void fold_all(std::vector<Expr> &es, bool hot) {
+    for (auto &e : es) {
+        if (e.get() != nullptr) e = fold(e, hot);
+    }
+}
+
+/**
+ * @brief Evaluate a pure primitive node whose operands are all constants
+ */
+Expr fold_primitive(const Expr &expr, const Expr *rands, size_t n, bool hot) {
+    if (!hot || !is_pure(expr->e_type)) return expr;
+    for (size_t i = 0; i < n; ++i) {
+        if (!is_constant(rands[i])) return expr;
+    }
+    try {
+        Env env(nullptr);
+        Value v = expr->eval(env);
+        if (isNumber(v) || v.type() == V_BOOL) return constant_expr(v);
+    } catch (const RuntimeError &) {
+    } catch (const std::runtime_error &) {
+    }
+    return expr;
+}
+
+Expr fold_if(If *e, const Expr &expr, bool hot) {
+    e->cond = fold(e->cond, hot);
+    if (e->conseq.get() != nullptr) e->conseq = fold(e->conseq, hot);
+    if (e->alter.get() != nullptr) e->alter = fold(e->alter, hot);
+    Value test(nullptr);
+    if (!hot || !constant_value(e->cond.get(), test)) return expr;
+    Expr taken = test.isFalse() ? e->alter : e->conseq;
+    return taken.get() != nullptr ? taken : Expr(new MakeVoid());
+}
+
+// 常量为假的子句删去；第一个常量为真的子句之后的子句永远不会被检查
+Expr fold_cond(Cond *e, const Expr &expr, bool hot) {
+    for (auto &clause : e->clauses) {
+        if (clause.empty()) return expr;   // 留给 Cond::eval 报错
+        fold_all(clause, hot);
+    }
+    if (!hot) return expr;
+    std::vector<std::vector<Expr>> kept;
+    for (auto &clause : e->clauses) {
+        Value test(nullptr);
+        bool always = is_else(clause[0]);
+        if (!always && constant_value(clause[0].get(), test)) {
+            if (test.isFalse()) continue;
+            always = true;
+        }
+        kept.push_back(clause);
+        if (always) break;
+    }
+    if (kept.empty()) return Expr(new MakeVoid());
+    const std::vector<Expr> &first = kept[0];
+    bool first_taken = is_else(first[0]) || is_constant(first[0]);
+    if (first_taken && first.size() <= 2) {
+        if (first.size() == 2) return first[1];
+        return is_else(first[0]) ? Expr(new MakeVoid()) : first[0];
+    }
+    e->clauses = kept;
+    return expr;
+}
+
+// 非末尾的常量或 lambda 的值被丢弃且没有副作用
+Expr fold_begin(Begin *e, const Expr &expr, bool hot) {
+    fold_all(e->es, hot);
+    if (!hot) return expr;
+    std::vector<Expr> kept;
+    for (size_t i = 0; i < e->es.size(); ++i) {
+        const Expr &sub = e->es[i];
+        bool last = i + 1 == e->es.size();
+        bool lambda = sub.get() != nullptr && sub->e_type == E_LAMBDA &&
+                      static_cast<Lambda *>(sub.get())->info->e.get() != nullptr;
+        if (!last && (sub.get() == nullptr || is_constant(sub) || lambda)) continue;
+        kept.push_back(sub);
+    }
+    e->es = kept;
+    // 单独的 define 仍需 Begin 预先建立绑定
+    if (kept.size() == 1 && kept[0].get() != nullptr && kept[0]->e_type != E_DEFINE) return kept[0];
+    return expr;
+}
+
+Expr fold(const Expr &expr, bool hot) {
+    ExprBase *e = expr.get();
+    switch (e->e_type) {
+        case E_IF:
+            return fold_if(static_cast<If *>(e), expr, hot);
+        case E_COND:
+            return fold_cond(static_cast<Cond *>(e), expr, hot);
+        case E_BEGIN:
+            return fold_begin(static_cast<Begin *>(e), expr, hot);
+        case E_AND:
+            fold_all(static_cast<AndVar *>(e)->rands, hot);
+            return fold_primitive(expr, static_cast<AndVar *>(e)->rands.data(), static_cast<AndVar *>(e)->rands.size(), hot);
+        case E_OR:
+            fold_all(static_cast<OrVar *>(e)->rands, hot);
+            return fold_primitive(expr, static_cast<OrVar *>(e)->rands.data(), static_cast<OrVar *>(e)->rands.size(), hot);
+        case E_APPLY: {
+            Apply *app = static_cast<Apply *>(e);
+            app->rator = fold(app->rator, hot);
+            fold_all(app->rand, hot);
+            return expr;
+        }
+        case E_LAMBDA: {
+            Lambda *lambda = static_cast<Lambda *>(e);
+            lambda->info->e = fold(lambda->info->e, true);
+            return expr;
+        }
+        case E_DEFINE: {
+            Define *def = static_cast<Define *>(e);
+            def->e = fold(def->e, hot);
+            return expr;
+        }
+        case E_SET: {
+            Set *set = static_cast<Set *>(e);
+            set->e = fold(set->e, hot);
+            return expr;
+        }
+        case E_LET: {
+            Let *let = static_cast<Let *>(e);
+            for (auto &b : let->bind) b.second = fold(b.second, hot);
+            let->body = fold(let->body, hot);
+            return expr;
+        }
+        case E_LETREC: {
+            Letrec *letrec = static_cast<Letrec *>(e);
+            for (auto &b : letrec->bind) b.second = fold(b.second, hot);
+            letrec->body = fold(letrec->body, hot);
+            return expr;
+        }
+        default:
+            break;
+    }
+    if (Unary *u = dynamic_cast<Unary *>(e)) {
+        u->rand = fold(u->rand, hot);
+        return fold_primitive(expr, &u->rand, 1, hot);
+    }
+    if (Binary *b = dynamic_cast<Binary *>(e)) {
+        b->rand1 = fold(b->rand1, hot);
+        b->rand2 = fold(b->rand2, hot);
+        Expr rands[] = {b->rand1, b->rand2};
+        return fold_primitive(expr, rands, 2, hot);
+    }
+    if (Variadic *v = dynamic_cast<Variadic *>(e)) {
+        fold_all(v->rands, hot);
+        return fold_primitive(expr, v->rands.data(), v->rands.size(), hot);
+    }
+    return expr;
+}
+
+// ============================================================================
+// --dump-optimized
+// ============================================================================
+
+std::string primitive_name(ExprType t) {
+    for (const auto &entry : primitives) {
+        if (entry.second == t) return entry.first;
+    }
+    return "?";
+}
+
+void dump_list(std::ostream &os, const std::vector<Expr> &es) {
+    for (const auto &e : es) {
+        os << ' ';
+        dump_expr(os, e);
+    }
+}
+
+void dump_bindings(std::ostream &os, const std::vector<std::pair<std::string, Expr>> &bind) {
+    os << " (";
+    for (size_t i = 0; i < bind.size(); ++i) {
+        if (i > 0) os << ' ';
+        os << '(' << bind[i].first << ' ';
+        dump_expr(os, bind[i].second);
+        os << ')';
+    }
+    os << ") ";
+}
+
+} // namespace
+
+Expr optimize(const Expr &expr) {
+    return fold(expr, false);
+}
+
+void dump_expr(std::ostream &os, const Expr &expr) {
+    ExprBase *e = expr.get();
+    if (e == nullptr) return;
+    Value v(nullptr);
+    if (e->e_type == E_QUOTE) {
+        Quote *q = static_cast<Quote *>(e);
+        os << "(quote ";
+        if (q->value) {
+            os << *q->value;
+        } else {
+            os << q->text;
+        }
+        os << ')';
+        return;
+    }
+    if (constant_value(e, v)) {
+        os << v;
+        return;
+    }
+    switch (e->e_type) {
+        case E_VAR:
+            os << static_cast<Var *>(e)->x;
+            return;
+        case E_VOID:
+            os << "(void)";
+            return;
+        case E_EXIT:
+            os << "(exit)";
+            return;
+        case E_IF: {
+            If *ife = static_cast<If *>(e);
+            os << "(if ";
+            dump_expr(os, ife->cond);
+            os << ' ';
+            dump_expr(os, ife->conseq);
+            if (ife->alter.get() != nullptr) {
+                os << ' ';
+                dump_expr(os, ife->alter);
+            }
+            os << ')';
+            return;
+        }
+        case E_COND:
+            os << "(cond";
+            for (const auto &clause : static_cast<Cond *>(e)->clauses) {
+                os << " (";
+                for (size_t i = 0; i < clause.size(); ++i) {
+                    if (i > 0) os << ' ';
+                    dump_expr(os, clause[i]);
+                }
+                os << ')';
+            }
+            os << ')';
+            return;
+        case E_BEGIN:
+            os << "(begin";
+            dump_list(os, static_cast<Begin *>(e)->es);
+            os << ')';
+            return;
+        case E_AND:
+            os << "(and";
+            dump_list(os, static_cast<AndVar *>(e)->rands);
+            os << ')';
+            return;
+        case E_OR:
+            os << "(or";
+            dump_list(os, static_cast<OrVar *>(e)->rands);
+            os << ')';
+            return;
+        case E_APPLY: {
+            Apply *app = static_cast<Apply *>(e);
+            os << '(';
+            dump_expr(os, app->rator);
+            dump_list(os, app->rand);
+            os << ')';
+            return;
+        }
+        case E_LAMBDA: {
+            Lambda *lambda = static_cast<Lambda *>(e);
+            os << "(lambda (";
+            for (size_t i = 0; i < lambda->info->x.size(); ++i) {
+                if (i > 0) os << ' ';
+                os << lambda->info->x[i];
+            }
+            os << ") ";
+            dump_expr(os, lambda->info->e);
+            os << ')';
+            return;
+        }
+        case E_DEFINE: {
+            Define *def = static_cast<Define *>(e);
+            os << "(define " << def->var << ' ';
+            dump_expr(os, def->e);
+            os << ')';
+            return;
+        }
+        case E_SET: {
+            Set *set = static_cast<Set *>(e);
+            os << "(set! " << set->var << ' ';
+            dump_expr(os, set->e);
+            os << ')';
+            return;
+        }
+        case E_LET: {
+            Let *let = static_cast<Let *>(e);
+            os << "(let";
+            dump_bindings(os, let->bind);
+            dump_expr(os, let->body);
+            os << ')';
+            return;
+        }
+        case E_LETREC: {
+            Letrec *letrec = static_cast<Letrec *>(e);
+            os << "(letrec";
+            dump_bindings(os, letrec->bind);
+            dump_expr(os, letrec->body);
+            os << ')';
+            return;
+        }
+        default:
+            break;
+    }
+    os << '(' << primitive_name(e->e_type);
+    if (Unary *u = dynamic_cast<Unary *>(e)) {
+        os << ' ';
+        dump_expr(os, u->rand);
+    } else if (Binary *b = dynamic_cast<Binary *>(e)) {
+        os << ' ';
+        dump_expr(os, b->rand1);
+        os << ' ';
+        dump_expr(os, b->rand2);
+    } else if (Variadic *var = dynamic_cast<Variadic *>(e)) {
+        dump_list(os, var->rands);
+    }
+    os << ')';
+}
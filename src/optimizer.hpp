@@ -0,0 +1,28 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+/**
+ * @file optimizer.hpp
+ * @brief Constant folding pass run between parsing and evaluation
+ *
+ * Inside lambda bodies, primitive applications whose operands are all
+ * constants are replaced by their result, if/cond with a constant test keep
+ * only the branch taken, and constant subforms whose value is discarded are
+ * dropped from begin. A top-level form runs once and is left as parsed.
+ */
+
+#include "expr.hpp"
+#include <ostream>
+
+/**
+ * @brief Fold the constant parts of a parsed top-level form
+ * @return The rewritten form; nodes that cannot be simplified are reused
+ */
+Expr optimize(const Expr &);
+
+/**
+ * @brief Print an Expr tree back as an s-expression (--dump-optimized)
+ */
+void dump_expr(std::ostream &, const Expr &);
+
+#endif // OPTIMIZER_HPP
@@ -0,0 +1,99 @@
+/**
+ * @file output.cpp
+ * @brief Standard output of Scheme programs (see output.hpp)
+ */
+
+#include "output.hpp"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+const size_t OUTPUT_BUFFER_SIZE = 1 << 20;
+
+void write_all(int fd, const char *s, size_t n) {
+    while (n > 0) {
+        ssize_t done = write(fd, s, n);
+        if (done < 0) {
+            if (errno == EINTR) continue;
+            return;     // 输出被关闭（如管道另一端退出）时丢弃
+        }
+        s += done;
+        n -= done;
+    }
+}
+
+} // namespace
+
+OutputBuffer::OutputBuffer(int fd, size_t size)
+    : fd(fd), line_buffered(isatty(fd)), buffer(size), used(0) {
+    if (!line_buffered) setp(buffer.data(), buffer.data() + buffer.size());
+}
+
+OutputBuffer::~OutputBuffer() {
+    flush();
+}
+
+void OutputBuffer::flush() {
+    if (line_buffered) {
+        write_all(fd, buffer.data(), used);
+        used = 0;
+    } else {
+        write_all(fd, pbase(), pptr() - pbase());
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+}
+
+OutputBuffer::int_type OutputBuffer::overflow(int_type c) {
+    if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+    if (line_buffered) {
+        // 终端：没有 put area，每个字符都经过这里
+        buffer[used++] = traits_type::to_char_type(c);
+        if (c == '\n' || used == buffer.size()) flush();
+    } else {
+        flush();
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return c;
+}
+
+std::streamsize OutputBuffer::xsputn(const char *s, std::streamsize n) {
+    if (line_buffered) {
+        for (std::streamsize i = 0; i < n; ++i) overflow(traits_type::to_int_type(s[i]));
+        return n;
+    }
+    if (n > epptr() - pptr()) {
+        flush();
+        if (static_cast<size_t>(n) >= buffer.size()) {
+            write_all(fd, s, n);
+            return n;
+        }
+    }
+    memcpy(pptr(), s, n);
+    pbump(static_cast<int>(n));
+    return n;
+}
+
+int OutputBuffer::sync() {
+    flush();
+    return 0;
+}
+
+namespace {
+
+// 先于 scheme_out 构造，程序退出时最后析构并写出剩余的输出
+OutputBuffer output_buffer(STDOUT_FILENO, OUTPUT_BUFFER_SIZE);
+
+} // namespace
+
+std::ostream scheme_out(&output_buffer);
+
+void output_flush() {
+    output_buffer.flush();
+}
+
+void output_flush_interactive() {
+    if (output_buffer.interactive()) output_buffer.flush();
+}
@@ -0,0 +1,58 @@
+#ifndef OUTPUT_HPP
+#define OUTPUT_HPP
+
+/**
+ * @file output.hpp
+ * @brief Standard output of Scheme programs through one explicit buffer
+ *
+ * Everything a program prints (values shown by the REPL, display, error
+ * reports) goes to scheme_out, which appends it to one large buffer. The
+ * buffer is written to stdout when it fills and at exit; when stdout is a
+ * terminal it is also written after every newline, so an interactive
+ * session sees each result as soon as it is printed.
+ */
+
+#include <cstddef>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+class OutputBuffer : public std::streambuf {
+public:
+    OutputBuffer(int fd, size_t size);
+    ~OutputBuffer();
+
+    /**
+     * @brief Write everything buffered so far
+     */
+    void flush();
+
+    /// Whether output goes to a terminal and is written line by line
+    bool interactive() const { return line_buffered; }
+
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char *s, std::streamsize n) override;
+    int sync() override;
+
+private:
+    int fd;
+    bool line_buffered;      // 输出到终端时每个换行都写出
+    std::vector<char> buffer;
+    size_t used;             // 逐行写出时不使用 put area，已缓冲的字节数
+};
+
+/// Standard output of the running program
+extern std::ostream scheme_out;
+
+/**
+ * @brief Write the buffered output of the program to stdout
+ */
+void output_flush();
+
+/**
+ * @brief On a terminal, write out a partial line before waiting for input
+ */
+void output_flush_interactive();
+
+#endif // OUTPUT_HPP
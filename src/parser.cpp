@@ -28,25 +28,144 @@ extern std::map<std::string, ExprType> reserved_words;
 /**
  * @brief Helper function: Parse list of syntax nodes to vector of Expr (for parameters/body)
  */
-vector<Expr> parse_expr_list(const vector<Syntax>& stxs, Assoc &env) {
+vector<Expr> parse_expr_list(SyntaxSpan stxs, Scope &scope) {
     vector<Expr> exprs;
+    exprs.reserve(stxs.size());
     for (const auto& stx : stxs) {
-        exprs.push_back(stx->parse(env));
+        exprs.push_back(stx->parse(scope));
     }
     return exprs;
 }
 
-// 检查变量名是否在当前环境中已定义（用于处理遮蔽）
-bool is_bound(const std::string& name, Assoc& env) {
-    // find 函数通常定义在 Def.hpp/Def.cpp 中，返回 Value
-    // 如果未找到通常返回 nullptr 或空指针
-    return find(name, env).get() != nullptr;
+// 检查变量名是否被词法作用域绑定（用于处理遮蔽）
+bool is_bound(const std::string& name, const Scope &scope) {
+    return scope.binds(name);
+}
+
+/**
+ * @brief Helper function: If stx is (define name ...) or (define (name ...) ...), return name
+ */
+const string* define_target(const Syntax &stx, Scope &scope) {
+    List* lst = dynamic_cast<List*>(stx.get());
+    if (!lst || lst->stxs.size() < 2) return nullptr;
+    SymbolSyntax* head = dynamic_cast<SymbolSyntax*>(lst->stxs[0].get());
+    if (!head || head->s != "define" || is_bound(head->s, scope)) return nullptr;
+    if (SymbolSyntax* var = dynamic_cast<SymbolSyntax*>(lst->stxs[1].get())) return &var->s;
+    List* func_list = dynamic_cast<List*>(lst->stxs[1].get());
+    if (!func_list || func_list->stxs.empty()) return nullptr;
+    SymbolSyntax* name = dynamic_cast<SymbolSyntax*>(func_list->stxs[0].get());
+    return name ? &name->s : nullptr;
+}
+
+/**
+ * @brief Helper function: Build a Define, recording the assignment of a local slot
+ */
+Expr define_local(const string& name, const Expr& value, int slot, Scope &scope) {
+    Define* def = new Define(name, value, slot);
+    if (slot >= 0) {
+        scope.bindings[slot]->assigned = true;
+        scope.bindings[slot]->uses.push_back(&def->boxed);
+    }
+    return Expr(def);
+}
+
+/**
+ * @brief Helper function: Parse a body (lambda/let/letrec/begin)
+ *
+ * Internal defines are declared before any subform is parsed, so that
+ * mutually recursive local functions address each other's slots
+ * (Begin::eval pre-binds them the same way at runtime).
+ */
+vector<Expr> parse_body(SyntaxSpan stxs, Scope &scope) {
+    if (!scope.isGlobal()) {
+        for (const auto& stx : stxs) {
+            if (const string* name = define_target(stx, scope)) {
+                scope.declare(*name);
+            }
+        }
+    }
+    return parse_expr_list(stxs, scope);
+}
+
+/**
+ * @brief Helper function: Mark the applications in tail position of a lambda body
+ *
+ * Apply::eval returns a pending call instead of recursing for marked nodes.
+ * Only forms that return their subexpression's value unchanged pass the
+ * tail position down; cond tests are not marked since their value is inspected.
+ */
+void mark_tail(const Expr& expr) {
+    ExprBase* e = expr.get();
+    if (e == nullptr) return;
+    switch (e->e_type) {
+        case E_APPLY:
+            static_cast<Apply*>(e)->tail = true;
+            break;
+        case E_IF: {
+            If* if_expr = static_cast<If*>(e);
+            mark_tail(if_expr->conseq);
+            mark_tail(if_expr->alter);
+            break;
+        }
+        case E_COND:
+            for (const auto& clause : static_cast<Cond*>(e)->clauses) {
+                if (clause.size() > 1) mark_tail(clause.back());
+            }
+            break;
+        case E_BEGIN: {
+            Begin* begin_expr = static_cast<Begin*>(e);
+            if (!begin_expr->es.empty()) mark_tail(begin_expr->es.back());
+            break;
+        }
+        case E_LET:
+            mark_tail(static_cast<Let*>(e)->body);
+            break;
+        case E_LETREC:
+            mark_tail(static_cast<Letrec*>(e)->body);
+            break;
+        case E_AND: {
+            AndVar* and_expr = static_cast<AndVar*>(e);
+            if (!and_expr->rands.empty()) mark_tail(and_expr->rands.back());
+            break;
+        }
+        case E_OR: {
+            OrVar* or_expr = static_cast<OrVar*>(e);
+            if (!or_expr->rands.empty()) mark_tail(or_expr->rands.back());
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Helper function: Plain identifiers are addressed lexically; anything
+ * else keeps Var's checks for numeric or malformed symbols at eval time
+ */
+bool is_plain_identifier(const std::string& s) {
+    if (s.empty()) return false;
+    char first = s[0];
+    if (isdigit(static_cast<unsigned char>(first)) || first == '.' || first == '@') return false;
+    for (char c : s) {
+        if (c == '#' || c == '\'' || c == '"' || c == '`' || isspace(static_cast<unsigned char>(c))) {
+            return false;
+        }
+    }
+    // Var::eval 会把 "-1/-2" 这类符号当作有理数字面量
+    size_t slash_pos = s.find('/');
+    if (slash_pos != std::string::npos && slash_pos > 0 && slash_pos < s.size() - 1) {
+        try {
+            std::stoll(s.substr(0, slash_pos));
+            if (std::stoll(s.substr(slash_pos + 1)) != 0) return false;
+        } catch (...) {}
+    }
+    return true;
 }
 
 /**
  * @brief Helper function: Parse lambda parameter list (Syntax List → vector<string>)
  */
-vector<string> parse_lambda_params(const std::vector<Syntax>& param_stx, Assoc &env) {
+vector<string> parse_lambda_params(SyntaxSpan param_stx) {
     vector<string> params;
 
     //WARNING: 根据定义并不会有以下形式出现，是不是 AI 生成的呃呃？
@@ -76,7 +195,7 @@ vector<string> parse_lambda_params(const std::vector<Syntax>& param_stx, Assoc &
 /**
  * @brief Helper function: Check if list is function shorthand (define (name args...) body...)
  */
-bool is_define_shorthand(const vector<Syntax>& stxs) {
+bool is_define_shorthand(SyntaxSpan stxs) {
     if (stxs.size() < 2) return false;
     // Second element must be a List starting with Symbol (e.g., (sum3 a b c))
     List* func_list = dynamic_cast<List*>(stxs[1].get());
@@ -87,39 +206,50 @@ bool is_define_shorthand(const vector<Syntax>& stxs) {
 /**
  * @brief Default parse method (should be overridden by subclasses)
  */
-Expr Syntax::parse(Assoc &env) {
+Expr Syntax::parse(Scope &scope) {
     throw RuntimeError("Unimplemented parse method");
 }
 
-Expr Number::parse(Assoc &env) {
+Expr Number::parse(Scope &scope) {
     return Expr(new Fixnum(n));
 }
 
-Expr RationalSyntax::parse(Assoc &env) {
+Expr BignumSyntax::parse(Scope &scope) {
+    return Expr(new BignumLiteral(n));
+}
+
+Expr RationalSyntax::parse(Scope &scope) {
     // Parse rational number (e.g., 1/2 → RationalExpr)
     return Expr(new RationalNum(numerator, denominator));
 }
 
-Expr SymbolSyntax::parse(Assoc &env) {
+Expr SymbolSyntax::parse(Scope &scope) {
+    int depth, index;
+    std::shared_ptr<Binding> binding;
+    if (is_plain_identifier(s) && (binding = scope.resolve(s, depth, index))) {
+        Var* var = new Var(s, depth, index);
+        binding->uses.push_back(&var->boxed);
+        return Expr(var);
+    }
     return Expr(new Var(s));
 }
 
-Expr StringSyntax::parse(Assoc &env) {
+Expr StringSyntax::parse(Scope &scope) {
     return Expr(new StringExpr(s));
 }
 
-Expr TrueSyntax::parse(Assoc &env) {
+Expr TrueSyntax::parse(Scope &scope) {
     return Expr(new True());
 }
 
-Expr FalseSyntax::parse(Assoc &env) {
+Expr FalseSyntax::parse(Scope &scope) {
     return Expr(new False());
 }
 
-Expr List::parse(Assoc &env) {
+Expr List::parse(Scope &scope) {
     if (stxs.empty()) {
         // Empty list → (quote ())
-        return Expr(new Quote(Syntax(new List())));
+        return Expr(new Quote(Syntax(this)));
     }
 
     // Step 1: Check if first element is Symbol (for special forms/primitives/variables)
@@ -129,14 +259,14 @@ Expr List::parse(Assoc &env) {
     // 如果第一个元素不是符号，或者是一个被遮蔽的变量，则视为普通函数调用 (Apply)
     bool is_shadowed = false;
     if (id != nullptr) {
-        is_shadowed = is_bound(id->s, env);
+        is_shadowed = is_bound(id->s, scope);
     }
     // 如果不是符号，或者是被遮蔽的变量，直接跳到 Apply
     if (id == nullptr || is_shadowed) {
         // Non-symbol first element → function application (Apply)
         // e.g., ((lambda (x) x) 5) → Apply(lambda_expr, {5})
-        Expr func = stxs[0]->parse(env);
-        vector<Expr> params = parse_expr_list(vector<Syntax>(stxs.begin()+1, stxs.end()), env);
+        Expr func = stxs[0]->parse(scope);
+        vector<Expr> params = parse_expr_list(stxs.from(1), scope);
         return Expr(new Apply(func, params));
     }
 
@@ -162,24 +292,28 @@ Expr List::parse(Assoc &env) {
                     string func_name = dynamic_cast<SymbolSyntax*>(func_list->stxs[0].get())->s;
 
                     // Parse parameters: (args...) → vector<string>
-                    vector<Syntax> param_stxs(func_list->stxs.begin()+1, func_list->stxs.end());
-                    vector<string> lambda_params = parse_lambda_params(param_stxs, env);
+                    vector<string> lambda_params = parse_lambda_params(func_list->stxs.from(1));
+
+                    // 先声明函数名，函数体内的递归调用才能找到它的槽位
+                    int slot = scope.isGlobal() ? -1 : scope.declare(func_name);
 
-                    Assoc body_env = env;
+                    Scope closure_scope(&scope, true);
+                    Scope body_scope(&closure_scope);
                     for (const auto& p : lambda_params) {
-                        // 绑定一个占位符（如 Void），只为了标记该变量名已存在
-                        body_env = extend(p, Value(new Void()), body_env);
+                        body_scope.bind(p);
                     }
 
                     // Parse body: stxs[2..end] → wrapped in Begin
-                    vector<Expr> lambda_body = parse_expr_list(vector<Syntax>(stxs.begin()+2, stxs.end()), body_env);
+                    vector<Expr> lambda_body = parse_body(stxs.from(2), body_scope);
                     Expr body = (lambda_body.size() == 1) ? lambda_body[0] : Expr(new Begin(lambda_body));
+                    mark_tail(body);
 
                     // Create lambda expression
-                    Expr lambda = Expr(new Lambda(lambda_params, body));
+                    Expr lambda = Expr(new Lambda(lambda_params, body, body_scope.names.size(),
+                                                  body_scope.boxedSlots(), closure_scope.captures));
 
                     // Return Define expression: (define func_name lambda)
-                    return Expr(new Define(func_name, lambda));
+                    return define_local(func_name, lambda, slot, scope);
                 }
 
                 // Normal variable define: (define var expr)
@@ -187,8 +321,9 @@ Expr List::parse(Assoc &env) {
                 if (!var_stx) throw RuntimeError("define first argument must be symbol");
                 string var_name = var_stx->s;
                 if (stxs.size() != 3) throw RuntimeError("define requires exactly 2 arguments for variable");
-                Expr value_expr = stxs[2]->parse(env);
-                return Expr(new Define(var_name, value_expr));
+                int slot = scope.isGlobal() ? -1 : scope.declare(var_name);
+                Expr value_expr = stxs[2]->parse(scope);
+                return define_local(var_name, value_expr, slot, scope);
             }
 
             case E_LAMBDA: {
@@ -197,34 +332,36 @@ Expr List::parse(Assoc &env) {
 
                 // Parse parameters
                 List* func_list = dynamic_cast<List*>(stxs[1].get());
-                vector<Syntax> param_stxs(func_list->stxs.begin(), func_list->stxs.end());
-                vector<string> lambda_params = parse_lambda_params(param_stxs, env);
+                vector<string> lambda_params = parse_lambda_params(func_list->stxs);
 
-                Assoc body_env = env;
+                Scope closure_scope(&scope, true);
+                Scope body_scope(&closure_scope);
                 for (const auto& p : lambda_params) {
-                    // 绑定占位符，标记遮蔽
-                    body_env = extend(p, Value(new Void()), body_env);
+                    // 参数占据帧的前几个槽位
+                    body_scope.bind(p);
                 }
 
                 // Parse body (wrap multiple expressions in Begin)
-                vector<Expr> lambda_body = parse_expr_list(vector<Syntax>(stxs.begin()+2, stxs.end()), body_env);
+                vector<Expr> lambda_body = parse_body(stxs.from(2), body_scope);
                 Expr body = (lambda_body.size() == 1) ? lambda_body[0] : Expr(new Begin(lambda_body));
+                mark_tail(body);
 
-                return Expr(new Lambda(lambda_params, body));
+                return Expr(new Lambda(lambda_params, body, body_scope.names.size(),
+                                       body_scope.boxedSlots(), closure_scope.captures));
             }
 
             case E_IF: {
                 // (if cond conseq [alter])
                 if (stxs.size() < 3 || stxs.size() > 4) throw RuntimeError("if requires 2 or 3 arguments");
-                Expr cond = stxs[1]->parse(env);
-                Expr conseq = stxs[2]->parse(env);
-                Expr alter = (stxs.size() == 4) ? stxs[3]->parse(env) : Expr(new MakeVoid());
+                Expr cond = stxs[1]->parse(scope);
+                Expr conseq = stxs[2]->parse(scope);
+                Expr alter = (stxs.size() == 4) ? stxs[3]->parse(scope) : Expr(new MakeVoid());
                 return Expr(new If(cond, conseq, alter));
             }
 
             case E_BEGIN: {
                 // (begin expr1 expr2 ...)
-                vector<Expr> begin_body = parse_expr_list(vector<Syntax>(stxs.begin()+1, stxs.end()), env);
+                vector<Expr> begin_body = parse_body(stxs.from(1), scope);
                 return Expr(new Begin(begin_body));
             }
 
@@ -236,7 +373,7 @@ Expr List::parse(Assoc &env) {
                     if (!ex_list) {
                         throw RuntimeError("cond clauses must be lists");
                     }
-                    std::vector<Expr> pre_clau = parse_expr_list(ex_list->stxs, env);
+                    std::vector<Expr> pre_clau = parse_expr_list(ex_list->stxs, scope);
                     clau.push_back(pre_clau);
                 }
                 return Expr(new Cond(clau));
@@ -259,20 +396,19 @@ Expr List::parse(Assoc &env) {
                     if (!var_stx) {
                         throw RuntimeError("let binding variable must be a symbol");
                     }
-                    Expr bind_expr = single_bind->stxs[1]->parse(env);
+                    Expr bind_expr = single_bind->stxs[1]->parse(scope);
                     let_binds.emplace_back(var_stx->s, bind_expr);
                 }
 
 
-                Assoc body_env = env;
+                Scope body_scope(&scope);
                 for (const auto& bind : let_binds) {
-                    body_env = extend(bind.first, Value(new Void()), body_env);
+                    body_scope.bind(bind.first);
                 }
 
-                vector<Syntax> let_body_stxs(stxs.begin() + 2, stxs.end());
-                vector<Expr> body_exprs = parse_expr_list(let_body_stxs, body_env);
+                vector<Expr> body_exprs = parse_body(stxs.from(2), body_scope);
                 Expr let_body = (body_exprs.size() == 1) ? body_exprs[0] : Expr(new Begin(body_exprs));
-                return Expr(new Let(let_binds, let_body));
+                return Expr(new Let(let_binds, let_body, body_scope.names.size(), body_scope.boxedSlots()));
             }
             case E_LETREC :{
                 if (stxs.size() < 3) throw RuntimeError("let requires at least 2 arguments (binding list + body)");
@@ -281,14 +417,15 @@ Expr List::parse(Assoc &env) {
                     throw RuntimeError("letrec binding list must be a list of (var expr) pairs");
                 }
 
-                // 先收集所有变量名，构建 body_env
-                Assoc body_env = env;
+                // 先收集所有变量名，构建 body_scope
+                Scope body_scope(&scope);
                 // 我们需要遍历 stxs[1] 来预先获取所有名字
                 for (const auto& bind_stx : bind_list->stxs) {
                     List* single_bind = dynamic_cast<List*>(bind_stx.get());
                     // ... 安全检查 ...
                     SymbolSyntax* var_stx = dynamic_cast<SymbolSyntax*>(single_bind->stxs[0].get());
-                    body_env = extend(var_stx->s, Value(new Void()), body_env);
+                    // 绑定在闭包创建之后才赋值
+                    body_scope.bindings[body_scope.bind(var_stx->s)]->assigned = true;
                 }
 
                 std::vector<std::pair<std::string, Expr>> let_binds;
@@ -302,18 +439,17 @@ Expr List::parse(Assoc &env) {
                         throw RuntimeError("letrec binding variable must be a symbol");
                     }
 
-                    // 解析绑定表达式（用当前 env 解析，后续在 Letrec::eval 中求值）
-                    Expr bind_expr = single_bind->stxs[1]->parse(body_env);
+                    // 解析绑定表达式（用 body_scope 解析，后续在 Letrec::eval 中求值）
+                    Expr bind_expr = single_bind->stxs[1]->parse(body_scope);
                     let_binds.emplace_back(var_stx->s, bind_expr);
                 }
 
                 // Step 2: 解析 body（多表达式用 Begin 包裹，和 lambda 的 body 处理逻辑一致）
-                vector<Syntax> let_body_stxs(stxs.begin() + 2, stxs.end());
-                vector<Expr> body_exprs = parse_expr_list(let_body_stxs, body_env);
+                vector<Expr> body_exprs = parse_body(stxs.from(2), body_scope);
                 Expr let_body = (body_exprs.size() == 1) ? body_exprs[0] : Expr(new Begin(body_exprs));
 
                 // Step 3: 构造 Let 对象（body 已处理为单个表达式：要么是原始表达式，要么是 Begin）
-                return Expr(new Letrec(let_binds, let_body));
+                return Expr(new Letrec(let_binds, let_body, body_scope.names.size(), body_scope.boxedSlots()));
             }
             case E_SET : {
                 if (stxs.size()!=3) throw RuntimeError("set requires 2 arguments (binding list + body)");
@@ -322,28 +458,56 @@ Expr List::parse(Assoc &env) {
                     throw RuntimeError("let binding variable must be a symbol");
                 }
                 std::string var = var_stx->s;
-                Expr expr = stxs[2]->parse(env);
-                return Expr(new Set(var, expr));
+                int depth = -1, index = -1;
+                std::shared_ptr<Binding> binding;
+                if (!is_plain_identifier(var) || !(binding = scope.resolve(var, depth, index))) {
+                    depth = index = -1;
+                }
+                Expr expr = stxs[2]->parse(scope);
+                Set* set = new Set(var, expr, depth, index);
+                if (binding) {
+                    binding->assigned = true;
+                    binding->uses.push_back(&set->boxed);
+                }
+                return Expr(set);
             }
             default:
                 throw RuntimeError("Unknown reserved word: " + op);
         }
     }
 
-    vector<Expr> params = parse_expr_list(vector<Syntax>(stxs.begin()+1, stxs.end()), env);
+    vector<Expr> params = parse_expr_list(stxs.from(1), scope);
     if (primitives.count(op) != 0) {
         ExprType op_type = primitives[op];
         switch (op_type) {
-            // 可变参数算术/比较函数
-            case E_PLUS: return Expr(new PlusVar(params));
-            case E_MINUS: return Expr(new MinusVar(params));
-            case E_MUL: return Expr(new MultVar(params));
-            case E_DIV: return Expr(new DivVar(params));
-            case E_LT: return Expr(new LessVar(params));
-            case E_LE: return Expr(new LessEqVar(params));
-            case E_EQ: return Expr(new EqualVar(params));
-            case E_GE: return Expr(new GreaterEqVar(params));
-            case E_GT: return Expr(new GreaterVar(params));
+            // 可变参数算术/比较函数；恰好两个参数时用 Binary 节点，求值时不必构造参数数组
+            case E_PLUS:
+                if (params.size() == 2) return Expr(new Plus(params[0], params[1]));
+                return Expr(new PlusVar(params));
+            case E_MINUS:
+                if (params.size() == 2) return Expr(new Minus(params[0], params[1]));
+                return Expr(new MinusVar(params));
+            case E_MUL:
+                if (params.size() == 2) return Expr(new Mult(params[0], params[1]));
+                return Expr(new MultVar(params));
+            case E_DIV:
+                if (params.size() == 2) return Expr(new Div(params[0], params[1]));
+                return Expr(new DivVar(params));
+            case E_LT:
+                if (params.size() == 2) return Expr(new Less(params[0], params[1]));
+                return Expr(new LessVar(params));
+            case E_LE:
+                if (params.size() == 2) return Expr(new LessEq(params[0], params[1]));
+                return Expr(new LessEqVar(params));
+            case E_EQ:
+                if (params.size() == 2) return Expr(new Equal(params[0], params[1]));
+                return Expr(new EqualVar(params));
+            case E_GE:
+                if (params.size() == 2) return Expr(new GreaterEq(params[0], params[1]));
+                return Expr(new GreaterEqVar(params));
+            case E_GT:
+                if (params.size() == 2) return Expr(new Greater(params[0], params[1]));
+                return Expr(new GreaterVar(params));
             case E_AND: return Expr(new AndVar(params));
             case E_OR: return Expr(new OrVar(params));
             case E_LIST: return Expr(new ListFunc(params));
@@ -0,0 +1,200 @@
+/**
+ * @file printer.cpp
+ * @brief Iterative printer of values (see printer.hpp)
+ */
+
+#include "printer.hpp"
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+bool print_shared_labels = false;
+
+namespace {
+
+// 序对在 marks 中的状态；非负数为已输出的标号
+const int ENTERED = -1;     // 正在遍历它的 car 与 cdr
+const int DONE = -2;        // 遍历完毕，不需要标号
+const int WANTED = -3;      // 需要标号，还没有输出
+
+const std::size_t CHUNK = 64 << 10;     // 缓冲区超过这个长度就先写出
+
+const Pair *pair_of(const Value &v) {
+    ValueBase *p = v.get();
+    return p != nullptr && p->v_type == V_PAIR ? static_cast<const Pair *>(p) : nullptr;
+}
+
+class Printer {
+public:
+    void print(std::ostream &, const Value &, bool display);
+
+private:
+    std::string out;                                    // 复用的输出缓冲区
+    std::ostringstream scratch;                         // 少见类型仍由各自的 show 格式化
+    std::unordered_map<const Pair *, int> marks;        // 引用多于一个的序对
+    std::vector<std::pair<const Pair *, bool>> walk;    // 找标号时的显式栈，second 表示离开
+    std::vector<const Value *> tails;                   // 各层未输出完的列表的剩余部分
+    bool labeled = false;                               // 本次输出有需要标号的序对
+    int labels = 0;
+
+    void findLabels(const Value &);
+    int *label(const Pair *);
+    void atom(const Value &);
+    void integer(long long);
+};
+
+// 深度优先、先 car 后 cdr，与输出顺序一致：遍历中再次遇到尚未离开的序对即为环
+void Printer::findLabels(const Value &root) {
+    walk.assign(1, {pair_of(root), false});
+    while (!walk.empty()) {
+        const Pair *p = walk.back().first;
+        bool leaving = walk.back().second;
+        walk.pop_back();
+        if (leaving) {
+            int &state = marks[p];
+            if (state == ENTERED) state = DONE;
+            continue;
+        }
+        // 只有一个引用的序对不会被第二次遇到，不必记录
+        if (p->refs > 1) {
+            auto inserted = marks.insert({p, ENTERED});
+            if (!inserted.second) {
+                int &state = inserted.first->second;
+                if (state == ENTERED || (state == DONE && print_shared_labels)) {
+                    state = WANTED;
+                    labeled = true;
+                }
+                continue;
+            }
+            walk.push_back({p, true});
+        }
+        if (const Pair *cdr = pair_of(p->cdr)) walk.push_back({cdr, false});
+        if (const Pair *car = pair_of(p->car)) walk.push_back({car, false});
+    }
+}
+
+// 需要标号的序对返回它的状态，否则返回 nullptr
+int *Printer::label(const Pair *p) {
+    if (!labeled || p->refs < 2) return nullptr;
+    auto it = marks.find(p);
+    if (it == marks.end() || it->second == DONE) return nullptr;
+    return &it->second;
+}
+
+void Printer::integer(long long n) {
+    char buf[24];
+    char *end = buf + sizeof buf, *s = end;
+    unsigned long long u = n < 0 ? 0ULL - static_cast<unsigned long long>(n) : n;
+    do {
+        *--s = static_cast<char>('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    if (n < 0) *--s = '-';
+    out.append(s, end);
+}
+
+void Printer::atom(const Value &v) {
+    if (v.isFixnum()) {
+        integer(v.fixnum());
+        return;
+    }
+    switch (v.w) {
+        case Value::FALSE_WORD: out += "#f"; return;
+        case Value::TRUE_WORD: out += "#t"; return;
+        case Value::NULL_WORD: out += "()"; return;
+        case Value::VOID_WORD: out += "#<void>"; return;
+    }
+    ValueBase *p = v.get();
+    switch (p->v_type) {
+        case V_SYM:
+            out += static_cast<Symbol *>(p)->s;
+            break;
+        case V_STRING:
+            out += '"';
+            out += static_cast<String *>(p)->s;
+            out += '"';
+            break;
+        default:
+            scratch.str(std::string());
+            p->show(scratch);
+            out += scratch.str();
+    }
+}
+
+void Printer::print(std::ostream &os, const Value &root, bool display) {
+    static const Value close = NullV();     // 输出点对的 cdr 之后只剩右括号
+    out.clear();
+    if (display && root.type() == V_STRING) {
+        out = static_cast<String *>(root.get())->s;
+    } else {
+        if (pair_of(root) != nullptr) findLabels(root);
+        const Value *v = &root;
+        while (v != nullptr) {
+            // 输出一个元素；序对先输出左括号，余下的 cdr 入栈
+            const Pair *p = pair_of(*v);
+            int *mark = p != nullptr ? label(p) : nullptr;
+            if (p == nullptr) {
+                atom(*v);
+            } else if (mark != nullptr && *mark >= 0) {
+                out += '#';
+                integer(*mark);
+                out += '#';
+            } else {
+                if (mark != nullptr) {
+                    *mark = labels++;
+                    out += '#';
+                    integer(*mark);
+                    out += '=';
+                }
+                out += '(';
+                tails.push_back(&p->cdr);
+                v = &p->car;
+                continue;
+            }
+            if (out.size() >= CHUNK) {
+                os.write(out.data(), out.size());
+                out.clear();
+            }
+            // 元素之后：依次接着输出所在各层列表的剩余部分
+            v = nullptr;
+            while (!tails.empty()) {
+                const Value *rest = tails.back();
+                if (rest->w == Value::NULL_WORD) {
+                    out += ')';
+                    tails.pop_back();
+                    continue;
+                }
+                const Pair *next = pair_of(*rest);
+                if (next != nullptr && label(next) == nullptr) {
+                    out += ' ';
+                    tails.back() = &next->cdr;
+                    v = &next->car;
+                } else {
+                    // 不是表的结尾，或 cdr 带标号：写成点对
+                    out += " . ";
+                    tails.back() = &close;
+                    v = rest;
+                }
+                break;
+            }
+        }
+    }
+    os.write(out.data(), out.size());
+
+    if (!marks.empty()) {
+        // 大表之后换一个新表，免得每次 clear 都要清空大量的桶
+        if (marks.size() > 1024) std::unordered_map<const Pair *, int>().swap(marks);
+        else marks.clear();
+    }
+    labeled = false;
+    labels = 0;
+}
+
+} // namespace
+
+void print_value(std::ostream &os, const Value &v, bool display) {
+    static Printer &printer = *new Printer();   // 不随程序退出析构
+    printer.print(os, v, display);
+}
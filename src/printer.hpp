@@ -0,0 +1,34 @@
+#ifndef PRINTER_HPP
+#define PRINTER_HPP
+
+/**
+ * @file printer.hpp
+ * @brief Iterative printer of values with datum labels
+ *
+ * Lists are printed with an explicit stack of pending tails, so the C++
+ * stack use does not depend on the length or depth of a structure. Text
+ * is formatted into one reused byte buffer and handed to the stream in a
+ * single write.
+ *
+ * A pair that is reached again while it is still being printed (a cycle
+ * made with set-car!/set-cdr!) is printed once as #n=(...) and then
+ * referred to as #n#, so printing always terminates. With
+ * print_shared_labels set, every pair reached more than once gets a
+ * label, as write-shared does in R7RS. Finding the labels takes one pass
+ * over the pairs; only pairs with more than one reference can be reached
+ * twice, so only those are remembered.
+ */
+
+#include "value.hpp"
+#include <ostream>
+
+/// Label every shared pair, not only the ones on a cycle (--print-shared)
+extern bool print_shared_labels;
+
+/**
+ * @brief Write the external representation of a value
+ * @param display Print a string argument without quotes, as display does
+ */
+void print_value(std::ostream &, const Value &, bool display = false);
+
+#endif // PRINTER_HPP
@@ -0,0 +1,71 @@
+/**
+ * @file reader.cpp
+ * @brief Source text of the reader (see reader.hpp)
+ */
+
+#include "reader.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t CHUNK = 64 << 10;      // 每次 read(2) 最多读入的字节数
+
+} // namespace
+
+Reader::Reader(const char *data, size_t size)
+    : p(data), lim(data + size), fd(-1), owned_fd(-1), map(nullptr), map_size(0) {}
+
+Reader::Reader(const std::string &text) : Reader(text.data(), text.size()) {}
+
+Reader::Reader(int fd) : p(nullptr), lim(nullptr), fd(fd), owned_fd(-1), map(nullptr), map_size(0) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) return;
+    // 普通文件整体映射，从描述符当前的位置开始读
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    if (offset < 0 || offset >= st.st_size) return;
+    void *m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m == MAP_FAILED) return;
+    madvise(m, st.st_size, MADV_SEQUENTIAL);
+    map = m;
+    map_size = st.st_size;
+    p = static_cast<const char *>(m) + offset;
+    lim = static_cast<const char *>(m) + map_size;
+    this->fd = -1;
+}
+
+Reader::~Reader() {
+    if (map != nullptr) munmap(map, map_size);
+    if (owned_fd >= 0) close(owned_fd);
+}
+
+std::unique_ptr<Reader> Reader::open(const char *path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return nullptr;
+    std::unique_ptr<Reader> reader(new Reader(fd));
+    reader->owned_fd = fd;
+    return reader;
+}
+
+bool Reader::fill() {
+    if (fd < 0) return false;
+    // 丢掉已经读过的部分，未读的字节移到缓冲区开头
+    size_t keep = lim - p;
+    buffer.erase(0, buffer.size() - keep);
+    buffer.resize(keep + CHUNK);
+    ssize_t n;
+    do {
+        n = read(fd, &buffer[keep], CHUNK);
+    } while (n < 0 && errno == EINTR);
+    buffer.resize(keep + (n > 0 ? n : 0));
+    p = buffer.data();
+    lim = p + buffer.size();
+    if (n <= 0) {
+        fd = -1;    // 输入结束（或出错），之后不再读取
+        return false;
+    }
+    return true;
+}
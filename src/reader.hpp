@@ -0,0 +1,68 @@
+#ifndef READER_HPP
+#define READER_HPP
+
+/**
+ * @file reader.hpp
+ * @brief Source text of the reader as one contiguous byte range
+ *
+ * readSyntax scans the text with plain pointers over [pos(), end()).
+ * A Reader over a string or an mmap'd regular file holds all of it from
+ * the start; over a pipe or a terminal it fills the range with whatever
+ * each read(2) returns, so forms typed interactively are evaluated as
+ * soon as they are complete. Filling keeps the unconsumed bytes, so a
+ * token can always be rescanned from its first byte after fill().
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+class Reader {
+public:
+    /// Text in memory; it is not copied and must outlive the reader
+    Reader(const char *data, size_t size);
+    explicit Reader(const std::string &text);
+    /// An open descriptor (not closed): mmap'd if it is a regular file, read incrementally otherwise
+    explicit Reader(int fd);
+    ~Reader();
+
+    Reader(const Reader &) = delete;
+    Reader &operator=(const Reader &) = delete;
+
+    /**
+     * @brief Open a file for reading
+     * @return nullptr if it cannot be opened (errno tells why)
+     */
+    static std::unique_ptr<Reader> open(const char *path);
+
+    const char *pos() const { return p; }
+    const char *end() const { return lim; }
+    void advance(const char *to) { p = to; }
+
+    int peek() { return p < lim || fill() ? static_cast<unsigned char>(*p) : EOF; }
+    int get() {
+        int c = peek();
+        if (c != EOF) ++p;
+        return c;
+    }
+
+    /**
+     * @brief Make more bytes available after end(), keeping those from pos()
+     * @return false at the end of the input
+     *
+     * pos() and end() may move: callers keep offsets from pos(), not pointers.
+     */
+    bool fill();
+
+private:
+    const char *p;
+    const char *lim;
+    int fd;                  // 增量读取的描述符，-1 表示全部内容已在内存中
+    int owned_fd;            // open() 打开、析构时关闭的描述符
+    void *map;               // mmap 得到的区域
+    size_t map_size;
+    std::string buffer;      // 增量读取的缓冲区
+};
+
+#endif // READER_HPP
@@ -0,0 +1,89 @@
+/**
+ * @file repl.cpp
+ * @brief Read-eval-print loop (see repl.hpp)
+ */
+
+#include "repl.hpp"
+#include "syntax.hpp"
+#include "value.hpp"
+#include "RE.hpp"
+#include "bytecode.hpp"
+#include "flat.hpp"
+#include "optimizer.hpp"
+#include "output.hpp"
+#include <iostream>
+
+// 按节点类型分派，只在少见的 E_VOID 上做一次 dynamic_cast
+bool isExplicitVoidCall(const Expr &expr) {
+    if (expr.get() == nullptr) return false; // 没有 else 分支的 if
+    switch (expr->e_type) {
+        case E_VOID:
+            return dynamic_cast<MakeVoid*>(expr.get()) != nullptr;
+        case E_APPLY: {
+            Var* var_expr = dynamic_cast<Var*>(static_cast<Apply*>(expr.get())->rator.get());
+            return var_expr != nullptr && var_expr->x == "void";
+        }
+        case E_BEGIN: {
+            Begin* begin_expr = static_cast<Begin*>(expr.get());
+            return !begin_expr->es.empty() && isExplicitVoidCall(begin_expr->es.back());
+        }
+        case E_IF: {
+            If* if_expr = static_cast<If*>(expr.get());
+            return isExplicitVoidCall(if_expr->conseq) || isExplicitVoidCall(if_expr->alter);
+        }
+        case E_COND:
+            for (const auto& clause : static_cast<Cond*>(expr.get())->clauses) {
+                if (clause.size() > 1 && isExplicitVoidCall(clause.back())) {
+                    return true;
+                }
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+bool REPL(Reader &reader, const ReplOptions &opts){
+    // read - evaluation - print loop
+    Scope global_scope(nullptr);
+    Env top_env(nullptr);
+    SyntaxArena arena;
+    for (int form = 0; ; ++form){
+        // #ifndef ONLINE_JUDGE
+        //     std::cout << "scm> ";
+        // #endif
+        output_flush_interactive(); // 终端上等待输入前写出未换行的输出
+        if (readEnd(reader)) break; // 输入结束
+        Syntax stx = readSyntax(reader, arena); // read
+        try{
+            Expr expr = stx -> parse(global_scope); // parse
+            arena.clear(); // 语法树解析完即释放（出错时留到下一个形式）
+            // stx -> show(std :: cout); // syntax print
+            // 是否显式调用 void 要按折叠前的形式判断
+            bool explicit_void = isExplicitVoidCall(expr);
+            if (opts.optimize) expr = optimize(expr);
+            if (opts.dump_optimized) {
+                dump_expr(std :: cerr, expr);
+                std :: cerr << "\n";
+            }
+            if (opts.prepare != nullptr) opts.prepare(form, expr);
+            Value val = opts.use_vm ? vm_eval(expr, top_env)
+                      : opts.use_flat ? flat_eval(expr, top_env)
+                      : expr -> eval(top_env);
+            if (val.type() == V_TERMINATE)
+                return false;
+            if (val.type() != V_VOID || explicit_void) {
+                val.show(scheme_out);
+                scheme_out << '\n'; // value print
+            }
+        }
+        catch (const RuntimeError &RE){
+            #ifndef ONLINE_JUDGE
+                scheme_out << RE.what();
+            #endif
+            scheme_out << "RuntimeError" << "\n";
+        }
+        // puts("");
+    }
+    return true;
+}
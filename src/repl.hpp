@@ -0,0 +1,40 @@
+#ifndef REPL_HPP
+#define REPL_HPP
+
+/**
+ * @file repl.hpp
+ * @brief Read-eval-print loop shared by the interpreter and compiled programs
+ *
+ * Forms are read one at a time; each is parsed, optionally constant-folded
+ * and evaluated, and its value printed unless it is void. A RuntimeError
+ * prints "RuntimeError" and the loop goes on with the next form; (exit) or
+ * the end of the input stops it. All output goes through scheme_out.
+ */
+
+#include "expr.hpp"
+#include "reader.hpp"
+
+/**
+ * @brief Options of the read-eval-print loop, set from the command line
+ */
+struct ReplOptions {
+    bool use_vm = false;          ///< Run forms on the bytecode VM
+    bool use_flat = false;        ///< Run forms on the flat evaluator (see flat.hpp)
+    bool optimize = true;         ///< Constant-fold each form before evaluating it
+    bool dump_optimized = false;  ///< Print each form after folding to stderr
+    /// Called with the index of each form (counted from 0) and its final Expr before evaluation
+    void (*prepare)(int, const Expr &) = nullptr;
+};
+
+/**
+ * @brief Whether the form is a (void) call whose result must be printed
+ */
+bool isExplicitVoidCall(const Expr &expr);
+
+/**
+ * @brief Run every form of the input
+ * @return false if the program stopped with (exit), true at the end of the input
+ */
+bool REPL(Reader &, const ReplOptions &);
+
+#endif // REPL_HPP
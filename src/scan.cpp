@@ -0,0 +1,203 @@
+/**
+ * @file scan.cpp
+ * @brief Byte-class scanning kernels of the reader (see scan.hpp)
+ */
+
+#include "scan.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// ============================================================================
+// Byte classes: a scalar test and, on x86, the same test on 16 and 32 bytes
+// (0xff in each byte of the class)
+// ============================================================================
+
+#ifdef SCAN_X86
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+// ' ' 与 '\t' '\n' '\v' '\f' '\r'（C locale 下的 isspace）
+struct Space {
+    static bool byte(unsigned char c) {
+        return scan_is_space(c);
+    }
+#ifdef SCAN_X86
+    SSE2 static __m128i sse2(__m128i x) {
+        // 减去 '\t' 后无符号不大于 4 即在 '\t'..'\r' 之间
+        __m128i t = _mm_sub_epi8(x, _mm_set1_epi8('\t'));
+        __m128i controls = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8('\r' - '\t')), t);
+        return _mm_or_si128(controls, _mm_cmpeq_epi8(x, _mm_set1_epi8(' ')));
+    }
+    AVX2 static __m256i avx2(__m256i x) {
+        __m256i t = _mm256_sub_epi8(x, _mm256_set1_epi8('\t'));
+        __m256i controls = _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8('\r' - '\t')), t);
+        return _mm256_or_si256(controls, _mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')));
+    }
+#endif
+};
+
+// 记号的结束：空白、括号与分号（双引号不结束记号）
+struct Delimiter {
+    static bool byte(unsigned char c) {
+        return Space::byte(c) || (c | 1) == ')' || c == '[' || c == ']' || c == ';';
+    }
+#ifdef SCAN_X86
+    SSE2 static __m128i sse2(__m128i x) {
+        // '(' 与 ')' 只差最低位
+        __m128i parens = _mm_cmpeq_epi8(_mm_or_si128(x, _mm_set1_epi8(1)), _mm_set1_epi8(')'));
+        __m128i brackets = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('[')), _mm_cmpeq_epi8(x, _mm_set1_epi8(']')));
+        __m128i semicolons = _mm_cmpeq_epi8(x, _mm_set1_epi8(';'));
+        return _mm_or_si128(_mm_or_si128(Space::sse2(x), parens), _mm_or_si128(brackets, semicolons));
+    }
+    AVX2 static __m256i avx2(__m256i x) {
+        __m256i parens = _mm256_cmpeq_epi8(_mm256_or_si256(x, _mm256_set1_epi8(1)), _mm256_set1_epi8(')'));
+        __m256i brackets =
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('[')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8(']')));
+        __m256i semicolons = _mm256_cmpeq_epi8(x, _mm256_set1_epi8(';'));
+        return _mm256_or_si256(_mm256_or_si256(Space::avx2(x), parens), _mm256_or_si256(brackets, semicolons));
+    }
+#endif
+};
+
+// 字符串字面量里需要处理的字符：结束的引号与转义
+struct StringStop {
+    static bool byte(unsigned char c) {
+        return c == '"' || c == '\\';
+    }
+#ifdef SCAN_X86
+    SSE2 static __m128i sse2(__m128i x) {
+        return _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('"')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\\')));
+    }
+    AVX2 static __m256i avx2(__m256i x) {
+        return _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\\')));
+    }
+#endif
+};
+
+struct Newline {
+    static bool byte(unsigned char c) {
+        return c == '\n';
+    }
+#ifdef SCAN_X86
+    SSE2 static __m128i sse2(__m128i x) {
+        return _mm_cmpeq_epi8(x, _mm_set1_epi8('\n'));
+    }
+    AVX2 static __m256i avx2(__m256i x) {
+        return _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n'));
+    }
+#endif
+};
+
+// ============================================================================
+// Kernels: first byte whose membership in Class is In
+// ============================================================================
+
+template <class Class, bool In>
+const char *find_scalar(const char *p, const char *end) {
+    while (p < end && Class::byte(*p) != In)
+        ++p;
+    return p;
+}
+
+#ifdef SCAN_X86
+template <class Class, bool In>
+SSE2 const char *find_sse2(const char *p, const char *end) {
+    for (; end - p >= 16; p += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        unsigned mask = _mm_movemask_epi8(Class::sse2(x));
+        if (!In) mask = ~mask & 0xffff;
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    return find_scalar<Class, In>(p, end);
+}
+
+// 先用 16 字节试一次：大多数记号很短，32 字节的读入更常跨越缓存行
+template <class Class, bool In>
+AVX2 const char *find_avx2(const char *p, const char *end) {
+    if (end - p >= 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        unsigned mask = _mm_movemask_epi8(Class::sse2(x));
+        if (!In) mask = ~mask & 0xffff;
+        if (mask != 0) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+    for (; end - p >= 32; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        unsigned mask = _mm256_movemask_epi8(Class::avx2(x));
+        if (!In) mask = ~mask;
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    return find_sse2<Class, In>(p, end);   // 不足 32 字节的尾部
+}
+#endif
+
+const ScanKernels scalar_kernels = {
+    find_scalar<Space, false>,
+    find_scalar<Delimiter, true>,
+    find_scalar<StringStop, true>,
+    find_scalar<Newline, true>,
+};
+
+#ifdef SCAN_X86
+const ScanKernels sse2_kernels = {
+    find_sse2<Space, false>,
+    find_sse2<Delimiter, true>,
+    find_sse2<StringStop, true>,
+    find_sse2<Newline, true>,
+};
+
+const ScanKernels avx2_kernels = {
+    find_avx2<Space, false>,
+    find_avx2<Delimiter, true>,
+    find_avx2<StringStop, true>,
+    find_avx2<Newline, true>,
+};
+#endif
+
+bool supported(ScanLevel level) {
+    if (level == SCAN_SCALAR) return true;
+#ifdef SCAN_X86
+    __builtin_cpu_init();   // 静态初始化阶段调用时需要先初始化
+    if (level == SCAN_SSE2) return __builtin_cpu_supports("sse2");
+    if (level == SCAN_AVX2) return __builtin_cpu_supports("avx2");
+#endif
+    return false;
+}
+
+const ScanKernels &kernels(ScanLevel level) {
+#ifdef SCAN_X86
+    if (level == SCAN_AVX2) return avx2_kernels;
+    if (level == SCAN_SSE2) return sse2_kernels;
+#endif
+    return scalar_kernels;
+}
+
+} // namespace
+
+ScanKernels scan = kernels(scan_best());
+
+ScanLevel scan_best() {
+    if (supported(SCAN_AVX2)) return SCAN_AVX2;
+    if (supported(SCAN_SSE2)) return SCAN_SSE2;
+    return SCAN_SCALAR;
+}
+
+bool scan_select(ScanLevel level) {
+    if (!supported(level)) return false;
+    scan = kernels(level);
+    return true;
+}
+
+const char *scan_level_name(ScanLevel level) {
+    switch (level) {
+        case SCAN_SSE2: return "sse2";
+        case SCAN_AVX2: return "avx2";
+        default: return "scalar";
+    }
+}
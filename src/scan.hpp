@@ -0,0 +1,72 @@
+#ifndef SCAN_HPP
+#define SCAN_HPP
+
+/**
+ * @file scan.hpp
+ * @brief Byte-class scanning kernels of the reader
+ *
+ * Each kernel returns the first byte of [p, end) in a class, or end if
+ * there is none. Kernels never read outside [p, end), so they are safe on
+ * the last bytes of an mmap'd file. On x86 the SSE2 and AVX2 versions
+ * test 16 or 32 bytes per step; the fastest one the CPU supports is
+ * chosen at startup, and the scalar one is used elsewhere.
+ */
+
+/**
+ * @brief Instruction sets a set of kernels can be built on
+ */
+enum ScanLevel {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2,
+};
+
+struct ScanKernels {
+    /// First byte that is not whitespace
+    const char *(*space_end)(const char *p, const char *end);
+    /// First whitespace, parenthesis, bracket or ';': the end of a token
+    const char *(*delimiter)(const char *p, const char *end);
+    /// First '"' or '\\' inside a string literal
+    const char *(*string_stop)(const char *p, const char *end);
+    /// First '\n': the end of a comment
+    const char *(*line_end)(const char *p, const char *end);
+};
+
+/// Kernels used by the reader, selected by CPUID at startup
+extern ScanKernels scan;
+
+/**
+ * @brief Best level the running CPU supports
+ */
+ScanLevel scan_best();
+
+/**
+ * @brief Switch the reader's kernels
+ * @return false (and no change) if the CPU or the build does not support the level
+ */
+bool scan_select(ScanLevel);
+
+const char *scan_level_name(ScanLevel);
+
+/**
+ * @brief Whitespace as isspace in the C locale
+ */
+inline bool scan_is_space(char c) {
+    unsigned char u = c;
+    return u == ' ' || static_cast<unsigned char>(u - '\t') <= '\r' - '\t';
+}
+
+/**
+ * @brief First byte of [p, end) that is not whitespace
+ *
+ * Tokens are mostly separated by nothing or by one space, which is
+ * checked here before calling the kernel.
+ */
+inline const char *scan_space_end(const char *p, const char *end) {
+    if (p == end || !scan_is_space(*p)) return p;
+    ++p;
+    if (p == end || !scan_is_space(*p)) return p;
+    return scan.space_end(p, end);
+}
+
+#endif // SCAN_HPP
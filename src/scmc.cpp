@@ -0,0 +1,51 @@
+/**
+ * @file scmc.cpp
+ * @brief scmc: translate a Scheme program to C++ (see aot.hpp)
+ *
+ * Usage: scmc program.scm [-o program.cpp]. The output is compiled with the
+ * same definitions as scheme_runtime and linked against it; add_scheme_program
+ * in CMakeLists.txt does both.
+ */
+
+#include "aot.hpp"
+#include "RE.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char *argv[]) {
+    const char *input = nullptr;
+    const char *output = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            input = argv[i];
+        }
+    }
+    if (input == nullptr) {
+        std::cerr << "usage: scmc program.scm [-o program.cpp]\n";
+        return 2;
+    }
+    std::ifstream in(input, std::ios::binary);
+    if (!in) {
+        std::cerr << "scmc: cannot open " << input << "\n";
+        return 1;
+    }
+    std::ofstream file;
+    if (output != nullptr) {
+        file.open(output);
+        if (!file) {
+            std::cerr << "scmc: cannot write " << output << "\n";
+            return 1;
+        }
+    }
+    try {
+        int n = aot_translate(in, output != nullptr ? file : std::cout, input);
+        std::cerr << "scmc: " << input << ": " << n << " lambda(s) translated to C++\n";
+    } catch (const RuntimeError &e) {
+        std::cerr << "scmc: " << input << ": " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
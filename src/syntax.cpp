@@ -1,17 +1,66 @@
 #include "syntax.hpp"
+#include "reader.hpp"
+#include "scan.hpp"
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <vector>
 
-Syntax::Syntax(SyntaxBase *stx) : ptr(stx) {}
-SyntaxBase* Syntax::operator->() const { return ptr.get(); }
-SyntaxBase& Syntax::operator*() { return *ptr; }
-SyntaxBase* Syntax::get() const { return ptr.get(); }
+namespace {
+
+const size_t ARENA_BLOCK_SIZE = 64 << 10;
+
+} // namespace
+
+SyntaxArena::SyntaxArena() : block_size(0), next(nullptr), limit(nullptr) {}
+
+SyntaxArena::~SyntaxArena() {
+    clear();
+    for (char *block : blocks) delete[] block;
+}
+
+void *SyntaxArena::allocate(size_t size, size_t align) {
+    uintptr_t at = (reinterpret_cast<uintptr_t>(next) + align - 1) & ~(uintptr_t)(align - 1);
+    if (next == nullptr || at + size > reinterpret_cast<uintptr_t>(limit)) {
+        // 新块的大小加倍，大的形式也只需要对数次分配
+        block_size = std::max(std::max(block_size * 2, ARENA_BLOCK_SIZE), size + align);
+        blocks.push_back(new char[block_size]);
+        next = blocks.back();
+        limit = next + block_size;
+        at = (reinterpret_cast<uintptr_t>(next) + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    next = reinterpret_cast<char *>(at + size);
+    return reinterpret_cast<void *>(at);
+}
+
+SyntaxSpan SyntaxArena::copy(const Syntax *first, size_t count) {
+    if (count == 0) return SyntaxSpan();
+    Syntax *items = static_cast<Syntax *>(allocate(count * sizeof(Syntax), alignof(Syntax)));
+    for (size_t i = 0; i < count; ++i) new (items + i) Syntax(first[i]);
+    return SyntaxSpan(items, count);
+}
+
+void SyntaxArena::clear() {
+    for (size_t i = nodes.size(); i-- > 0;) nodes[i]->~SyntaxBase();
+    nodes.clear();
+    if (blocks.empty()) return;
+    // 只留下最大的（最后一块）
+    for (size_t i = 0; i + 1 < blocks.size(); ++i) delete[] blocks[i];
+    blocks.erase(blocks.begin(), blocks.end() - 1);
+    next = blocks.back();
+    limit = next + block_size;
+}
 
 Number::Number(int n) : n(n) {}
 void Number::show(std::ostream &os) {
   os << "the-number-" << n;
 }
 
+BignumSyntax::BignumSyntax(const BigInt &n) : n(n) {}
+void BignumSyntax::show(std::ostream &os) {
+  os << "the-number-" << n.toString();
+}
+
 RationalSyntax::RationalSyntax(int num, int den) : numerator(num), denominator(den) {}
 void RationalSyntax::show(std::ostream &os) {
   os << numerator << "/" << denominator;
@@ -35,7 +84,8 @@ void StringSyntax::show(std::ostream &os) {
     os << "\"" << s << "\"";
 }
 
-List::List() {}
+List::List(SyntaxSpan stxs) : stxs(stxs) {}
+
 void List::show(std::ostream &os) {
     os << '(';
     for (auto stx : stxs) {
@@ -45,32 +95,43 @@ void List::show(std::ostream &os) {
     os << ')';
 }
 
-std::istream &readSpace(std::istream &is) {
+// 跳过空白字符与注释（分号到行末）
+void readSpace(Reader &r) {
+  bool comment = false;
   while (true) {
-    // 跳过空白字符
-    while (isspace(is.peek()))
-      is.get();
-    
-    // 检查是否是注释
-    if (is.peek() == ';') {
-      // 跳过注释直到行末
-      while (is.peek() != '\n' && is.peek() != EOF)
-        is.get();
-      // 继续循环以跳过注释后的空白字符
-    } else {
-      // 没有更多空白字符或注释，退出循环
-      break;
+    const char *s = r.pos(), *e = r.end();
+    if (comment) {
+      const char *nl = scan.line_end(s, e);
+      if (nl == e) {
+        r.advance(e);
+        if (!r.fill()) return;
+        continue;
+      }
+      s = nl;
+      comment = false;
+    }
+    s = scan_space_end(s, e);
+    r.advance(s);
+    if (s == e) {
+      if (!r.fill()) return;
+      continue;
     }
+    if (*s != ';') return;
+    comment = true;
   }
-  return is;
 }
 
-Syntax readList(std::istream &is);
+bool readEnd(Reader &r) {
+  readSpace(r);
+  return r.peek() == EOF;
+}
 
 // Helper function to try parsing as integer or rational
+// 超出 int 范围时返回 false，由调用者改用大整数（INT32_WRAP 下按 32 位回绕）
 bool tryParseNumber(const std::string &s, int &result) {
   bool neg = false;
-  int n = 0;
+  unsigned n = 0;
+  unsigned long long wide = 0;   // 饱和累加，用于检测溢出
   int i = 0;
   
   // Single '+' or '-' are not numbers
@@ -88,13 +149,18 @@ bool tryParseNumber(const std::string &s, int &result) {
   // Check if all remaining characters are digits
   for (; i < s.size(); i++) {
     if ('0' <= s[i] && s[i] <= '9') {
-      n = n * 10 + s[i] - '0';
+      n = n * 10 + (s[i] - '0');
+      if (wide <= 0x80000000ULL) wide = wide * 10 + (s[i] - '0');
     } else {
       return false;  // Not a valid number
     }
   }
   
-  result = neg ? -n : n;
+#ifndef INT32_WRAP
+  if (wide > (neg ? 0x80000000ULL : 0x7fffffffULL))
+    return false;
+#endif
+  result = static_cast<int>(neg ? 0u - n : n);
   return true;
 }
 
@@ -122,103 +188,148 @@ bool tryParseRational(const std::string &s, int &numerator, int &denominator) {
 }
 
 // Helper function to create identifier/symbol syntax
-Syntax createIdentifierSyntax(const std::string &s) {
+Syntax createIdentifierSyntax(const std::string &s, SyntaxArena &arena) {
   if (s == "#t")
-    return Syntax(new TrueSyntax());
+    return Syntax(arena.make<TrueSyntax>());
   if (s == "#f")
-    return Syntax(new FalseSyntax());
-  return Syntax(new SymbolSyntax(s));
+    return Syntax(arena.make<FalseSyntax>());
+  return Syntax(arena.make<SymbolSyntax>(s));
 }
 
-// no leading space
-Syntax readItem(std::istream &is) {
-  if (is.peek() == '(' || is.peek() == '[') {
-    is.get();
-    return readList(is);
-  }
-  if (is.peek() == '\'')
-  {
-    is.get();
-    // 读取单引号后的语法元素
-    Syntax quoted_syntax = readItem(is);
-    
-    // 创建 (quote <syntax>) 的列表结构
-    List *quote_list = new List();
-    quote_list->stxs.push_back(Syntax(new SymbolSyntax("quote")));
-    quote_list->stxs.push_back(quoted_syntax);
-    
-    return Syntax(quote_list);
-  }
+// 读取一个字符串字面量或记号（no leading space）
+Syntax readAtom(Reader &r, SyntaxArena &arena) {
   // 处理字符串字面量
-  if (is.peek() == '"') {
-    is.get(); // 消费开始的双引号
+  if (r.peek() == '"') {
+    r.get(); // 消费开始的双引号
     std::string str;
-    while (is.peek() != '"' && is.peek() != EOF) {
-      char c = is.get();
-      if (c == '\\') {
-        // 处理转义字符
-        char next = is.get();
-        switch (next) {
-          case 'n': str.push_back('\n'); break;
-          case 't': str.push_back('\t'); break;
-          case 'r': str.push_back('\r'); break;
-          case '\\': str.push_back('\\'); break;
-          case '"': str.push_back('"'); break;
-          default: str.push_back(next); break;
-        }
-      } else {
-        str.push_back(c);
+    while (true) {
+      // 整段复制到下一个引号或反斜杠为止
+      const char *s = scan.string_stop(r.pos(), r.end()), *e = r.end();
+      str.append(r.pos(), s);
+      r.advance(s);
+      if (s == e) {
+        if (!r.fill()) break;
+        continue;
+      }
+      if (r.get() == '"') break; // 消费结束的双引号
+      // 处理转义字符
+      int next = r.get();
+      switch (next) {
+        case EOF: break;
+        case 'n': str.push_back('\n'); break;
+        case 't': str.push_back('\t'); break;
+        case 'r': str.push_back('\r'); break;
+        default: str.push_back(next); break;
       }
     }
-    if (is.peek() == '"') {
-      is.get(); // 消费结束的双引号
-    }
-    return Syntax(new StringSyntax(str));
+    return Syntax(arena.make<StringSyntax>(str));
   }
   
-  // Read token
-  std::string s;
-  do {
-    int c = is.peek();
-    if (c == '(' || c == ')' ||
-        c == '[' || c == ']' || 
-        c == ';' ||  // 添加分号作为分隔符
-        isspace(c) ||
-        c == EOF)
-      break;
-    is.get();
-    s.push_back(c);
-  } while (true);
+  // Read token：记号可能跨越缓冲区末尾，补充数据后从记号开头的偏移处继续扫描
+  size_t len = 0;
+  while (true) {
+    const char *s = scan.delimiter(r.pos() + len, r.end()), *e = r.end();
+    len = s - r.pos();
+    if (s < e || !r.fill()) break;
+  }
+  std::string s(r.pos(), len);
+  r.advance(r.pos() + len);
   
   // Try parsing as rational first
   int numerator, denominator;
   if (tryParseRational(s, numerator, denominator)) {
-    return Syntax(new RationalSyntax(numerator, denominator));
+    return Syntax(arena.make<RationalSyntax>(numerator, denominator));
   }
   
   // Try parsing as integer
   int number_value;
   if (tryParseNumber(s, number_value)) {
-    return Syntax(new Number(number_value));
+    return Syntax(arena.make<Number>(number_value));
+  }
+  
+  BigInt big;
+  if (BigInt::parse(s, big)) {
+    return Syntax(arena.make<BignumSyntax>(big));
   }
   
   // Not a number, treat as identifier/symbol
-  return createIdentifierSyntax(s);
+  return createIdentifierSyntax(s, arena);
 }
 
-Syntax readList(std::istream &is) {
-    List *stx = new List();
-    while (readSpace(is).peek() != ')' && readSpace(is).peek() != ')')
-        stx->stxs.push_back(readItem(is));
-    is.get(); // ')'
-    return Syntax(stx);
+namespace {
+
+// 未读完的列表：元素从 items 的 start 处开始
+struct OpenList {
+  size_t start;
+  bool quote;     // 'x 展开的 (quote x)，读到一个元素就结束
+};
+
+// 各次读入共用，读完一个形式后都是空的
+std::vector<Syntax> items;
+std::vector<OpenList> open;
+
+// 把最内层列表的元素整段复制进 arena
+Syntax closeList(SyntaxArena &arena) {
+  size_t start = open.back().start;
+  List *list = arena.make<List>(arena.copy(items.data() + start, items.size() - start));
+  items.resize(start, Syntax(nullptr));
+  open.pop_back();
+  return Syntax(list);
 }
 
-Syntax readSyntax(std::istream &is) {
-  return readItem(readSpace(is));
+} // namespace
+
+/**
+ * @brief Read one datum (no leading space) with an explicit stack of open lists
+ *
+ * The elements of all open lists wait on one shared stack and are copied
+ * into the arena when their list closes, so the native stack use does not
+ * depend on how deeply the input is nested.
+ */
+Syntax readItem(Reader &r, SyntaxArena &arena) {
+  items.clear();
+  open.clear();
+  while (true) {
+    Syntax done(nullptr);
+    int c = r.peek();
+    if (c == '(' || c == '[') {
+      r.get();
+      open.push_back({items.size(), false});
+    } else if (c == '\'') {
+      r.get();
+      // 创建 (quote <syntax>) 的列表结构，单引号后紧接着读被引用的元素
+      open.push_back({items.size(), true});
+      items.push_back(Syntax(arena.make<SymbolSyntax>("quote")));
+      continue;
+    } else {
+      done = readAtom(r, arena);
+    }
+    // 读完的元素放进所在的列表；随后关闭已结束的列表，直到下一个元素的开头
+    while (true) {
+      if (done.get() != nullptr) {
+        if (open.empty()) return done;
+        items.push_back(done);
+        if (open.back().quote) {
+          done = closeList(arena);
+          continue;
+        }
+        done = Syntax(nullptr);
+      }
+      readSpace(r);
+      c = r.peek();
+      if (c != ')' && c != ']' && c != EOF) break;
+      if (c != EOF) r.get(); // 未闭合的列表在输入结束处截止
+      done = closeList(arena);
+    }
+  }
 }
 
-std::istream &operator>>(std::istream &is, Syntax &stx) {
-  stx = readSyntax(is);
-  return is;
+Syntax readSyntax(Reader &r, SyntaxArena &arena) {
+  readSpace(r);
+  // 顶层多余的右括号直接跳过
+  while (r.peek() == ')' || r.peek() == ']') {
+    r.get();
+    readSpace(r);
+  }
+  return readItem(r, arena);
 }
@@ -1,30 +1,104 @@
 #ifndef SYNTAX 
 #define SYNTAX
 
+#include <cstddef>
 #include <cstring>
-#include <memory>
+#include <new>
+#include <utility>
 #include <vector>
 #include "Def.hpp"
+#include "bigint.hpp"
+
+struct List;
 
 struct SyntaxBase {
-    virtual Expr parse(Assoc &) = 0;
+    virtual Expr parse(Scope &) = 0;
     virtual void show(std::ostream &) = 0;
+    virtual List *list() { return nullptr; }   // 列表返回自身
     virtual ~SyntaxBase() = default;
 };
 
+// 指向 SyntaxArena 中的节点，不负责释放
 struct Syntax {
-    std::shared_ptr<SyntaxBase> ptr;
-    Syntax(SyntaxBase *);
-    SyntaxBase* operator->() const;
-    SyntaxBase& operator*();
-    SyntaxBase* get() const;
-    Expr parse(Assoc &);
+    SyntaxBase *ptr;
+    Syntax(SyntaxBase *stx) : ptr(stx) {}
+    SyntaxBase* operator->() const { return ptr; }
+    SyntaxBase& operator*() { return *ptr; }
+    SyntaxBase* get() const { return ptr; }
+    Expr parse(Scope &);
+};
+
+/**
+ * @brief A run of consecutive syntax nodes: the elements of a list, or a tail of them
+ *
+ * Parsing a form passes spans around instead of copying element vectors.
+ */
+struct SyntaxSpan {
+    Syntax *first;
+    size_t count;
+    SyntaxSpan() : first(nullptr), count(0) {}
+    SyntaxSpan(Syntax *first, size_t count) : first(first), count(count) {}
+    Syntax *begin() const { return first; }
+    Syntax *end() const { return first + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    Syntax &operator[](size_t i) const { return first[i]; }
+    Syntax &back() const { return first[count - 1]; }
+    /// The elements from index i on
+    SyntaxSpan from(size_t i) const { return i < count ? SyntaxSpan(first + i, count - i) : SyntaxSpan(); }
+};
+
+/**
+ * @brief Storage for the syntax tree of one top-level form
+ *
+ * Nodes and list elements are carved out of large blocks and released
+ * all at once by clear(), which keeps the largest block for the next
+ * form, so reading a form does not call malloc once per node. Nothing
+ * may refer to the nodes after clear(): parsing copies what it needs
+ * out of the tree.
+ */
+class SyntaxArena {
+public:
+    SyntaxArena();
+    ~SyntaxArena();
+    SyntaxArena(const SyntaxArena &) = delete;
+    SyntaxArena &operator=(const SyntaxArena &) = delete;
+
+    template <class T, class... Args>
+    T *make(Args &&...args) {
+        T *node = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        nodes.push_back(node);
+        return node;
+    }
+
+    /// Copy count handles into the arena
+    SyntaxSpan copy(const Syntax *first, size_t count);
+
+    /// Destroy every node made since the last clear
+    void clear();
+
+private:
+    std::vector<char *> blocks;         // 最后一块是正在分配的
+    size_t block_size;                  // 最后一块的大小
+    char *next;
+    char *limit;
+    std::vector<SyntaxBase *> nodes;    // clear 时逐个析构
+
+    void *allocate(size_t size, size_t align);
 };
 
 struct Number : SyntaxBase {
     int n;
     Number(int);
-    virtual Expr parse(Assoc &) override;
+    virtual Expr parse(Scope &) override;
+    virtual void show(std::ostream &) override;
+};
+
+// 超出 int 范围的整数字面量
+struct BignumSyntax : SyntaxBase {
+    BigInt n;
+    BignumSyntax(const BigInt &);
+    virtual Expr parse(Scope &) override;
     virtual void show(std::ostream &) override;
 };
 
@@ -32,44 +106,54 @@ struct RationalSyntax : SyntaxBase {
     int numerator;
     int denominator;
     RationalSyntax(int num, int den);
-    virtual Expr parse(Assoc &) override;
+    virtual Expr parse(Scope &) override;
     virtual void show(std::ostream &) override;
 };
 
 struct TrueSyntax : SyntaxBase {
     // This will not match
-    virtual Expr parse(Assoc &) override;
+    virtual Expr parse(Scope &) override;
     virtual void show(std::ostream &) override;
 };
 
 struct FalseSyntax : SyntaxBase {
     // FalseSyntax();
-    virtual Expr parse(Assoc &) override;
+    virtual Expr parse(Scope &) override;
     virtual void show(std::ostream &) override;
 };
 
 struct SymbolSyntax : SyntaxBase {
     std::string s;
     SymbolSyntax(const std::string &);
-    virtual Expr parse(Assoc &) override;
+    virtual Expr parse(Scope &) override;
     virtual void show(std::ostream &) override;
 };
 
 struct StringSyntax : SyntaxBase {
     std::string s;
     StringSyntax(const std::string &);
-    virtual Expr parse(Assoc &) override;
+    virtual Expr parse(Scope &) override;
     virtual void show(std::ostream &) override;
 };
 
 struct List : SyntaxBase {
-    std::vector<Syntax> stxs;
-    List();
-    virtual Expr parse(Assoc &) override;
+    SyntaxSpan stxs;
+    List(SyntaxSpan);
+    virtual Expr parse(Scope &) override;
     virtual void show(std::ostream &) override;
+    virtual List *list() override { return this; }
 };
 
-Syntax readSyntax(std::istream &);
+class Reader;
+
+/**
+ * @brief Read one datum, skipping the whitespace and comments before it
+ * @param arena Holds the nodes until the caller clears it
+ */
+Syntax readSyntax(Reader &, SyntaxArena &arena);
 
-std::istream &operator>>(std::istream &, Syntax);
+/**
+ * @brief Skip whitespace and comments; true if nothing else is left
+ */
+bool readEnd(Reader &);
 #endif
\ No newline at end of file
@@ -7,145 +7,215 @@
  */
 
 #include "value.hpp"
+#include "printer.hpp"
+#include <algorithm>
+#include <sys/mman.h>
 
 // ============================================================================
 // Base ValueBase Implementation
 // ============================================================================
 
-ValueBase::ValueBase(ValueType vt) : v_type(vt) {}
+// 只有 pair、procedure 和 box 能引用其他对象，需要回收器跟踪
+ValueBase::ValueBase(ValueType vt) : GcObject(vt == V_PAIR || vt == V_PROC || vt == V_BOX), v_type(vt) {}
 
-void ValueBase::showCdr(std::ostream &os) {
-    os << " . ";
-    show(os);
-    os << ')';
+static void visitValue(GcVisitor &visitor, const Value &v) {
+    if (v.isHeap()) visitor.visit(v.get());
 }
 
 // ============================================================================
 // Value Smart Pointer Implementation
 // ============================================================================
 
-Value::Value(ValueBase *ptr) : ptr(ptr) {}
-
-ValueBase* Value::operator->() const { 
-    return ptr.get(); 
+void Value::show(std::ostream &os) const {
+    print_value(os, *this);
 }
 
-ValueBase& Value::operator*() { 
-    return *ptr; 
-}
+// ============================================================================
+// Global Environment Implementation
+// ============================================================================
 
-ValueBase* Value::get() const { 
-    return ptr.get(); 
-}
+GlobalCell::GlobalCell(const std::string &name) : name(name), v(nullptr) {}
 
-void Value::show(std::ostream &os) {
-    ptr->show(os);
+// unordered_map never relocates its elements, so the returned pointer stays valid
+GlobalCell *GlobalEnv::cell(const std::string &name) {
+    auto it = cells.find(name);
+    if (it == cells.end()) {
+        it = cells.emplace(name, GlobalCell(name)).first;
+    }
+    return &it->second;
 }
 
+GlobalEnv global_env;
+
 // ============================================================================
-// Environment (Association List) Implementation
+// Lexically Addressed Frames Implementation
 // ============================================================================
 
-AssocList::AssocList(const std::string &x, const Value &v, Assoc &next)
-    : x(x), v(v), next(next) {}
-
-Assoc::Assoc(AssocList *x) : ptr(x) {}
+namespace {
+
+const std::size_t VALUE_STACK_BYTES = std::size_t(256) << 20;   // 保留的地址空间，用到时才分配物理页
+
+// 调用帧的槽位栈。top 以上与空洞中都是空 Value，压栈不必初始化
+class ValueStack {
+public:
+    Value *push(int);
+    void pop(Value *, int);
+    void settle(Frame *);
+
+private:
+    Value *base = nullptr, *top = nullptr, *limit = nullptr;
+    bool reserved = false;
+    std::vector<std::pair<Value *, Value *>> holes;   // top 以下已释放的区间，按地址升序
+};
+
+// 满了返回 nullptr，由调用者改用自己分配的槽位
+Value *ValueStack::push(int n) {
+    if (!reserved) {
+        reserved = true;
+        void *m = mmap(nullptr, VALUE_STACK_BYTES, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (m != MAP_FAILED) {
+            base = top = static_cast<Value *>(m);
+            limit = base + VALUE_STACK_BYTES / sizeof(Value);
+        }
+    }
+    if (limit - top < n) return nullptr;
+    Value *slots = top;
+    top += n;
+    return slots;
+}
 
-AssocList* Assoc::operator->() const { 
-    return ptr.get(); 
+void ValueStack::pop(Value *slots, int n) {
+    if (n == 0) return;
+    for (int i = 0; i < n; ++i) {
+        slots[i] = Value(nullptr);
+    }
+    if (slots + n == top) {
+        top = slots;
+        while (!holes.empty() && holes.back().second == top) {
+            top = holes.back().first;
+            holes.pop_back();
+        }
+    } else {
+        std::pair<Value *, Value *> hole(slots, slots + n);
+        holes.insert(std::upper_bound(holes.begin(), holes.end(), hole), hole);
+    }
 }
 
-AssocList& Assoc::operator*() { 
-    return *ptr; 
+void ValueStack::settle(Frame *f) {
+    if (f->size == 0 || f->slots + f->size != top) return;
+    Value *start = f->slots;
+    while (!holes.empty() && holes.back().second == start) {
+        start = holes.back().first;
+        holes.pop_back();
+    }
+    if (start == f->slots) return;
+    // 目标处都是空 Value，逐个交换后原来的槽位也变为空
+    for (int i = 0; i < f->size; ++i) {
+        start[i] = std::move(f->slots[i]);
+    }
+    f->slots = start;
+    top = start + f->size;
 }
 
-AssocList* Assoc::get() const { 
-    return ptr.get(); 
+ValueStack &value_stack() {
+    static ValueStack &stack = *new ValueStack();   // 不随程序退出析构
+    return stack;
 }
 
-Assoc empty() {
-    return Assoc(nullptr);
+} // namespace
+
+Frame::Frame(int size, const Env &parent)
+    : GcObject(true), slots(nullptr), size(size), stacked(false), storage(size, Value(nullptr)), parent(parent) {
+    slots = storage.data();
 }
 
-Assoc extend(const std::string &x, const Value &v, Assoc &lst) {
-    return Assoc(new AssocList(x, v, lst));
+Frame::~Frame() {
+    if (stacked) value_stack().pop(slots, size);
 }
 
-void modify(const std::string &x, const Value &v, Assoc &lst) {
-    for (auto i = lst; i.get() != nullptr; i = i->next) {
-        if (x == i->x) {
-            i->v = v;
-            return;
-        }
+void Frame::traceRefs(GcVisitor &visitor) {
+    for (int i = 0; i < size; ++i) {
+        visitValue(visitor, slots[i]);
     }
+    if (parent.get() != nullptr) visitor.visit(parent.get());
 }
 
-Value find(const std::string &x, Assoc &l) {
-    for (auto i = l; i.get() != nullptr; i = i->next) {
-        if (x == i->x) {
-            return i->v;
-        }
+void Frame::clearRefs() {
+    for (int i = 0; i < size; ++i) {
+        slots[i] = Value(nullptr);
     }
-    return Value(nullptr);
+    parent = Env(nullptr);
 }
-Assoc global_env = empty();
-// ============================================================================
-// Simple Value Types Implementation
-// ============================================================================
 
-// Void
-Void::Void() : ValueBase(V_VOID) {}
-
-void Void::show(std::ostream &os) {
-    os << "#<void>";
+Frame *stack_frame(int size, const Env &parent) {
+    Value *slots = value_stack().push(size);
+    if (slots == nullptr) return new Frame(size, parent);
+    Frame *f = new Frame(0, parent);
+    f->slots = slots;
+    f->size = size;
+    f->stacked = true;
+    return f;
 }
 
-Value VoidV() {
-    return Value(new Void());
+void settle_frame(Frame *f) {
+    if (f->stacked) value_stack().settle(f);
 }
 
-// Integer
-Integer::Integer(int n) : ValueBase(V_INT), n(n) {}
-
-void Integer::show(std::ostream &os) {
-    os << n;
+StackArgs::StackArgs(int size) : slots(value_stack().push(size)), size(size) {
+    if (slots == nullptr) {
+        storage.assign(size, Value(nullptr));
+        slots = storage.data();
+    }
 }
 
-Value IntegerV(int n) {
-    return Value(new Integer(n));
+StackArgs::~StackArgs() {
+    if (storage.empty()) value_stack().pop(slots, size);
 }
 
-// Rational
-// Helper function to calculate greatest common divisor
-static int gcd(int a, int b) {
-    if (a < 0) a = -a;
-    if (b < 0) b = -b;
-    while (b != 0) {
-        int temp = b;
-        b = a % b;
-        a = temp;
+Value &lookup(const Env &env, int depth, int index) {
+    Frame *f = env.get();
+    for (; depth > 0; --depth) {
+        f = f->parent.get();
     }
-    return a;
+    return f->slots[index];
 }
+// ============================================================================
+// Simple Value Types Implementation
+// ============================================================================
 
-Rational::Rational(int num, int den) : ValueBase(V_RATIONAL) {
-    if (den == 0) {
-        throw std::runtime_error("Division by zero");
-    }
-
-    // Simplify the fraction
-    int g = gcd(num, den);
-    numerator = num / g;
-    denominator = den / g;
-    
-    // Ensure denominator is positive
-    if (denominator < 0) {
-        numerator = -numerator;
-        denominator = -denominator;
-    }
+// Rational
+// Stein 二进制 gcd：只用移位和减法，避免 64 位除法
+static unsigned long long gcd(unsigned long long a, unsigned long long b) {
+    if (a == 0) return b;
+    if (b == 0) return a;
+    int shift = __builtin_ctzll(a | b);
+    a >>= __builtin_ctzll(a);
+    do {
+        b >>= __builtin_ctzll(b);
+        if (a > b) std::swap(a, b);
+        b -= a;
+    } while (b != 0);
+    return a << shift;
+}
+
+Rational::Rational(long long num, long long den)
+    : ValueBase(V_RATIONAL), numerator(num), denominator(den), reduced(false) {}
+
+bool Rational::normalize() {
+    if (reduced) return false;
+    reduced = true;
+    unsigned long long magnitude = numerator < 0 ? 0ULL - static_cast<unsigned long long>(numerator)
+                                                 : static_cast<unsigned long long>(numerator);
+    long long g = static_cast<long long>(gcd(magnitude, static_cast<unsigned long long>(denominator)));
+    if (g == 1) return false;
+    numerator /= g;
+    denominator /= g;
+    return true;
 }
 
 void Rational::show(std::ostream &os) {
+    normalize();
     if (denominator == 1) {
         os << numerator;
     } else {
@@ -153,19 +223,38 @@ void Rational::show(std::ostream &os) {
     }
 }
 
-Value RationalV(int num, int den) {
-    return Value(new Rational(num, den));
+Value RationalV(long long num, long long den) {
+    if (den == 0) {
+        throw std::runtime_error("Division by zero");
+    }
+    // Ensure denominator is positive
+    if (den < 0) {
+        num = -num;
+        den = -den;
+    }
+    Rational *r = new Rational(num, den);
+    r->normalize();
+    return Value(r);
+}
+
+// BigRational
+BigRational::BigRational(const BigInt &num, const BigInt &den)
+    : ValueBase(V_BIGRATIONAL), numerator(num), denominator(den) {}
+
+void BigRational::show(std::ostream &os) {
+    os << numerator.toString() << "/" << denominator.toString();
 }
 
-// Boolean
-Boolean::Boolean(bool b) : ValueBase(V_BOOL), b(b) {}
+// Bignum
+Bignum::Bignum(const BigInt &n) : ValueBase(V_BIGNUM), n(n) {}
 
-void Boolean::show(std::ostream &os) {
-    os << (b ? "#t" : "#f");
+void Bignum::show(std::ostream &os) {
+    os << n.toString();
 }
 
-Value BooleanV(bool b) {
-    return Value(new Boolean(b));
+Value BignumV(const BigInt &n) {
+    if (n.fitsInt()) return IntegerV(n.toInt());
+    return Value(new Bignum(n));
 }
 
 // Symbol
@@ -194,21 +283,6 @@ Value StringV(const std::string &s) {
 // Special Value Types Implementation
 // ============================================================================
 
-// Null
-Null::Null() : ValueBase(V_NULL) {}
-
-void Null::show(std::ostream &os) {
-    os << "()";
-}
-
-void Null::showCdr(std::ostream &os) {
-    os << ')';
-}
-
-Value NullV() {
-    return Value(new Null());
-}
-
 // Terminate
 Terminate::Terminate() : ValueBase(V_TERMINATE) {}
 
@@ -229,13 +303,17 @@ Pair::Pair(const Value &car, const Value &cdr)
     : ValueBase(V_PAIR), car(car), cdr(cdr) {}
 
 void Pair::show(std::ostream &os) {
-    os << '(' << car;
-    cdr->showCdr(os);
+    print_value(os, Value(this));
 }
 
-void Pair::showCdr(std::ostream &os) {
-    os << ' ' << car;
-    cdr->showCdr(os);
+void Pair::traceRefs(GcVisitor &visitor) {
+    visitValue(visitor, car);
+    visitValue(visitor, cdr);
+}
+
+void Pair::clearRefs() {
+    car = NullV();
+    cdr = NullV();
 }
 
 Value PairV(const Value &car, const Value &cdr) {
@@ -243,22 +321,67 @@ Value PairV(const Value &car, const Value &cdr) {
 }
 
 // Procedure
-Procedure::Procedure(const std::vector<std::string> &xs, const Expr &e, const Assoc &env)
-    : ValueBase(V_PROC), parameters(xs), e(e), env(env) {}
+Procedure::Procedure(const std::shared_ptr<LambdaInfo> &info, const Env &env)
+    : ValueBase(V_PROC), info(info), env(env) {}
 
 void Procedure::show(std::ostream &os) {
     os << "#<procedure>";
 }
 
-Value ProcedureV(const std::vector<std::string> &xs, const Expr &e, const Assoc &env) {
-    return Value(new Procedure(xs, e, env));
+void Procedure::traceRefs(GcVisitor &visitor) {
+    if (env.get() != nullptr) visitor.visit(env.get());
+}
+
+void Procedure::clearRefs() {
+    env = Env(nullptr);
+}
+
+Value ProcedureV(const std::shared_ptr<LambdaInfo> &info, const Env &env) {
+    return Value(new Procedure(info, env));
+}
+
+// Box
+Box::Box(const Value &v) : ValueBase(V_BOX), v(v) {}
+
+void Box::show(std::ostream &os) {
+    os << "#<box>";
+}
+
+void Box::traceRefs(GcVisitor &visitor) {
+    visitValue(visitor, v);
+}
+
+void Box::clearRefs() {
+    v = NullV();
+}
+
+Value BoxV(const Value &v) {
+    return Value(new Box(v));
+}
+
+void box_slots(Frame *frame, const std::vector<int> &slots) {
+    for (int i : slots) {
+        frame->slots[i] = BoxV(frame->slots[i]);
+    }
+}
+
+// Primitive
+Primitive::Primitive(const std::string &name, PrimitiveFn fn, const Expr &node, int min_args, int max_args)
+    : ValueBase(V_PRIMITIVE), name(name), fn(fn), node(node), min_args(min_args), max_args(max_args) {}
+
+void Primitive::show(std::ostream &os) {
+    os << "#<procedure>";
+}
+
+Value PrimitiveV(const std::string &name, PrimitiveFn fn, const Expr &node, int min_args, int max_args) {
+    return Value(new Primitive(name, fn, node, min_args, max_args));
 }
 
 // ============================================================================
 // Utility Functions Implementation
 // ============================================================================
 
-std::ostream &operator<<(std::ostream &os, Value &v) {
-    v->show(os);
+std::ostream &operator<<(std::ostream &os, const Value &v) {
+    v.show(os);
     return os;
 }
@@ -11,111 +11,339 @@
 
 #include "Def.hpp"
 #include "expr.hpp"
+#include "gc.hpp"
+#include "bigint.hpp"
 #include <memory>
 #include <cstring>
+#include <cstdint>
+#include <utility>
 #include <vector>
+#include <unordered_map>
 
 // ============================================================================
 // Base classes and smart pointer wrappers
 // ============================================================================
 
 /**
- * @brief Base class for all values in the Scheme interpreter
+ * @brief Base class for all heap-allocated values in the Scheme interpreter
+ *
+ * Fixnums, booleans, () and void never get a ValueBase; see Value.
+ * Pairs and procedures are tracked by the cycle collector (gc.hpp).
  */
-struct ValueBase {
+struct ValueBase : GcObject {
     ValueType v_type;
     ValueBase(ValueType);
     virtual void show(std::ostream &) = 0;
-    virtual void showCdr(std::ostream &);
     virtual ~ValueBase() = default;
 };
 
 /**
- * @brief Smart pointer wrapper for ValueBase objects
+ * @brief Tagged value word
+ *
+ * Small values are stored inline and never touch the heap:
+ *   ...xxxx1  fixnum, the int is the word shifted right by one
+ *   ...kk010  immediate constant: #f, #t, () or void
+ *   ...xx000  pointer to a reference-counted ValueBase
+ * A zero word means "no value" (an unbound slot or global cell).
+ * Pointers count as references for the collector in gc.hpp.
  */
 struct Value {
-    std::shared_ptr<ValueBase> ptr;
+    uintptr_t w;
     Value(ValueBase *);
-    void show(std::ostream &);
+    Value(const Value &);
+    Value(Value &&);
+    Value &operator=(const Value &);
+    Value &operator=(Value &&);
+    ~Value();
+
+    static const uintptr_t FALSE_WORD = 0x02;
+    static const uintptr_t TRUE_WORD = 0x0a;
+    static const uintptr_t NULL_WORD = 0x12;
+    static const uintptr_t VOID_WORD = 0x1a;
+    static Value raw(uintptr_t);
+
+    bool empty() const { return w == 0; }
+    bool isHeap() const { return w != 0 && (w & 7) == 0; }
+    bool isFixnum() const { return (w & 1) != 0; }
+    bool isFalse() const { return w == FALSE_WORD; }
+    int fixnum() const { return static_cast<int>(static_cast<intptr_t>(w) >> 1); }
+    ValueType type() const;
+
+    void show(std::ostream &) const;   ///< Print through print_value (printer.hpp)
     ValueBase* operator->() const;
     ValueBase& operator*();
-    ValueBase* get() const;
+    ValueBase* get() const;   ///< Heap object, nullptr for immediates and empty values
 };
 
+// Copying a Value is on every path of the evaluator, so the word operations live here
+inline Value::Value(ValueBase *p) : w(reinterpret_cast<uintptr_t>(p)) {
+    if (p != nullptr) ++p->refs;
+}
+
+inline Value::Value(const Value &o) : w(o.w) {
+    if (isHeap()) ++reinterpret_cast<ValueBase *>(w)->refs;
+}
+
+inline Value::Value(Value &&o) : w(o.w) {
+    o.w = 0;
+}
+
+inline Value::~Value() {
+    if (isHeap() && --reinterpret_cast<ValueBase *>(w)->refs == 0) {
+        gc_release(reinterpret_cast<ValueBase *>(w));
+    }
+}
+
+inline Value &Value::operator=(const Value &o) {
+    Value tmp(o);
+    std::swap(w, tmp.w);
+    return *this;
+}
+
+inline Value &Value::operator=(Value &&o) {
+    std::swap(w, o.w);
+    return *this;
+}
+
+inline Value Value::raw(uintptr_t word) {
+    Value v(nullptr);
+    v.w = word;
+    return v;
+}
+
+inline ValueType Value::type() const {
+    if (isFixnum()) return V_INT;
+    switch (w) {
+        case FALSE_WORD:
+        case TRUE_WORD:
+            return V_BOOL;
+        case NULL_WORD:
+            return V_NULL;
+        case VOID_WORD:
+            return V_VOID;
+        default:
+            return reinterpret_cast<ValueBase *>(w)->v_type;
+    }
+}
+
+inline ValueBase* Value::operator->() const {
+    return reinterpret_cast<ValueBase *>(w);
+}
+
+inline ValueBase& Value::operator*() {
+    return *reinterpret_cast<ValueBase *>(w);
+}
+
+inline ValueBase* Value::get() const {
+    return isHeap() ? reinterpret_cast<ValueBase *>(w) : nullptr;
+}
+
 // ============================================================================
-// Environment (Association Lists)
+// Global Environment
 // ============================================================================
 
 /**
- * @brief Smart pointer wrapper for AssocList (Environment)
+ * @brief Binding cell of a global variable
+ *
+ * A cell is created the first time its name is referenced and never moves,
+ * so Var/Set/Define nodes may cache a pointer to it. An unbound name has a
+ * cell whose value is null; redefinition overwrites the value in place.
  */
-struct Assoc {
-    std::shared_ptr<AssocList> ptr;
-    Assoc(AssocList *);
-    AssocList* operator->() const;
-    AssocList& operator*();
-    AssocList* get() const;
+struct GlobalCell {
+    std::string name;   ///< Variable name
+    Value v;            ///< Bound value, null while undefined
+    GlobalCell(const std::string &);
 };
 
 /**
- * @brief Association list node for variable bindings
+ * @brief Hash-indexed table of global binding cells
  */
-struct AssocList {
-    std::string x;      ///< Variable name
-    Value v;            ///< Variable value
-    Assoc next;         ///< Next binding in the chain
-    AssocList(const std::string &, const Value &, Assoc &);
+struct GlobalEnv {
+    std::unordered_map<std::string, GlobalCell> cells;
+    GlobalCell *cell(const std::string &);
 };
 
-// Environment operations
-Assoc empty();
-Assoc extend(const std::string&, const Value &, Assoc &);
-void modify(const std::string&, const Value &, Assoc &);
-Value find(const std::string &, Assoc &);
+// ============================================================================
+// Lexically Addressed Frames
+// ============================================================================
+
+/**
+ * @brief Counted handle to a Frame (local environment)
+ */
+struct Env {
+    Frame *ptr;
+    Env(Frame *);
+    Env(const Env &);
+    Env(Env &&);
+    Env &operator=(const Env &);
+    Env &operator=(Env &&);
+    ~Env();
+    Frame* operator->() const;
+    Frame& operator*();
+    Frame* get() const;
+};
+
+/**
+ * @brief Fixed-size activation frame of a lambda, let or letrec
+ *
+ * Slot indices are assigned by the parser (see Scope in expr.hpp), so a
+ * variable is found by walking `depth` parent links and indexing `slots`.
+ * The slots are either owned by the frame or, for a frame made by
+ * stack_frame, a range of the interpreter's value stack.
+ */
+struct Frame : GcObject {
+    Value *slots;               ///< Parameters/bindings first, then internal defines
+    int size;                   ///< Number of slots
+    bool stacked;               ///< The slots are on the value stack
+    std::vector<Value> storage; ///< Slots of a frame that is not on the value stack
+    Env parent;                 ///< Lexically enclosing frame
+    Frame(int, const Env &);
+    ~Frame();
+    virtual void traceRefs(GcVisitor &) override;
+    virtual void clearRefs() override;
+};
+
+inline Env::Env(Frame *f) : ptr(f) {
+    if (f != nullptr) ++f->refs;
+}
+
+inline Env::Env(const Env &o) : ptr(o.ptr) {
+    if (ptr != nullptr) ++ptr->refs;
+}
+
+inline Env::Env(Env &&o) : ptr(o.ptr) {
+    o.ptr = nullptr;
+}
+
+inline Env::~Env() {
+    if (ptr != nullptr && --ptr->refs == 0) gc_release(ptr);
+}
+
+inline Env &Env::operator=(const Env &o) {
+    Env tmp(o);
+    std::swap(ptr, tmp.ptr);
+    return *this;
+}
+
+inline Env &Env::operator=(Env &&o) {
+    std::swap(ptr, o.ptr);
+    return *this;
+}
+
+inline Frame* Env::operator->() const {
+    return ptr;
+}
+
+inline Frame& Env::operator*() {
+    return *ptr;
+}
+
+inline Frame* Env::get() const {
+    return ptr;
+}
+
+Value &lookup(const Env &, int, int);
+
+/**
+ * @brief Call frame whose slots are taken from the interpreter's value stack
+ *
+ * The value stack is one reserved address range that grows as it is
+ * touched, so slots never move while the frame is used and a call makes
+ * no heap allocation: the Frame itself comes from the collector's free
+ * lists. The range is given back when the frame is freed; a frame freed
+ * below the top leaves a hole that is reclaimed once the frames above it
+ * are gone. If the stack is full the frame gets its own slots.
+ */
+Frame *stack_frame(int, const Env &);
+
+/**
+ * @brief Move a stacked frame down over the holes directly below it
+ *
+ * The frame of a pending tail call is created above the frame it
+ * replaces; settling it once that frame is freed keeps a loop of tail
+ * calls in constant stack space. No reference into the slots may be live.
+ */
+void settle_frame(Frame *);
+
+/**
+ * @brief Arguments of a primitive call, on the value stack for one scope
+ *
+ * A primitive only reads its arguments, so unlike a callee frame no Frame
+ * object (and nothing the collector counts) is made. If the stack is full
+ * the arguments get their own slots.
+ */
+class StackArgs {
+public:
+    explicit StackArgs(int);
+    ~StackArgs();
+    StackArgs(const StackArgs &) = delete;
+    StackArgs &operator=(const StackArgs &) = delete;
+
+    Value *slots;
+
+private:
+    int size;
+    std::vector<Value> storage;
+};
 
 // ============================================================================
 // Simple Value Types
 // ============================================================================
 
+// Void, integers, booleans and () are immediate Values and never allocate
+inline Value VoidV() { return Value::raw(Value::VOID_WORD); }
+inline Value IntegerV(int n) { return Value::raw(static_cast<uintptr_t>(static_cast<intptr_t>(n)) << 1 | 1); }
+inline Value BooleanV(bool b) { return Value::raw(b ? Value::TRUE_WORD : Value::FALSE_WORD); }
+inline Value NullV() { return Value::raw(Value::NULL_WORD); }
+
 /**
- * @brief Void value (represents no meaningful return value)
+ * @brief Rational number value with 64-bit parts
+ *
+ * Arithmetic results are stored unreduced (see number.cpp); the gcd is only
+ * taken by normalize(), which printing calls and which the kernels call when
+ * a 64-bit intermediate would overflow. The denominator is always positive.
  */
-struct Void : ValueBase {
-    Void();
+struct Rational : ValueBase {
+    long long numerator;
+    long long denominator;
+    bool reduced;           ///< numerator/denominator is in lowest terms
+    Rational(long long, long long);
+    /**
+     * @brief Reduce to lowest terms in place
+     * @return true if the parts changed
+     */
+    bool normalize();
     virtual void show(std::ostream &) override;
 };
-Value VoidV();
 
 /**
- * @brief Integer value
+ * @brief Rational num/den in lowest terms; throws if den is zero
  */
-struct Integer : ValueBase {
-    int n;
-    Integer(int);
-    virtual void show(std::ostream &) override;
-};
-Value IntegerV(int);
+Value RationalV(long long, long long);
 
 /**
- * @brief Rational number value
+ * @brief Rational whose reduced parts do not fit in 64 bits
  */
-struct Rational : ValueBase {
-    int numerator;
-    int denominator;
-    Rational(int, int);
+struct BigRational : ValueBase {
+    BigInt numerator;
+    BigInt denominator;
+    BigRational(const BigInt &, const BigInt &);
     virtual void show(std::ostream &) override;
 };
-Value RationalV(int, int);
 
 /**
- * @brief Boolean value
+ * @brief Integer too large for a fixnum
  */
-struct Boolean : ValueBase {
-    bool b;
-    Boolean(bool);
+struct Bignum : ValueBase {
+    BigInt n;
+    Bignum(const BigInt &);
     virtual void show(std::ostream &) override;
 };
-Value BooleanV(bool);
+
+/**
+ * @brief Integer value of n: a fixnum when it fits, a Bignum otherwise
+ */
+Value BignumV(const BigInt &);
 
 /**
  * @brief Symbol value
@@ -141,16 +369,6 @@ Value StringV(const std::string &);
 // Special Value Types
 // ============================================================================
 
-/**
- * @brief Null value (empty list)
- */
-struct Null : ValueBase {
-    Null();
-    virtual void show(std::ostream &) override;
-    virtual void showCdr(std::ostream &) override;
-};
-Value NullV();
-
 /**
  * @brief Termination signal value
  */
@@ -172,26 +390,82 @@ struct Pair : ValueBase {
     Value cdr;  ///< Second element
     Pair(const Value &, const Value &);
     virtual void show(std::ostream &) override;
-    virtual void showCdr(std::ostream &) override;
+    virtual void traceRefs(GcVisitor &) override;
+    virtual void clearRefs() override;
 };
 Value PairV(const Value &, const Value &);
 
 /**
  * @brief Procedure (function) value
+ *
+ * A closure is the shared description of its lambda plus a frame holding
+ * copies of the free variables the body refers to; the enclosing frames
+ * themselves are not kept alive.
  */
 struct Procedure : ValueBase {
-    std::vector<std::string> parameters;   ///< Parameter names
-    Expr e;                                ///< Function body expression
-    Assoc env;                             ///< Closure environment
-    Procedure(const std::vector<std::string> &, const Expr &, const Assoc &);
+    std::shared_ptr<LambdaInfo> info;      ///< Parameters, body and frame layout
+    Env env;                               ///< Closure frame (captured variables), nullptr if none
+    Procedure(const std::shared_ptr<LambdaInfo> &, const Env &);
+    virtual void show(std::ostream &) override;
+    virtual void traceRefs(GcVisitor &) override;
+    virtual void clearRefs() override;
+};
+Value ProcedureV(const std::shared_ptr<LambdaInfo> &, const Env &);
+
+/**
+ * @brief Mutable cell for a variable that is both captured and assigned
+ *
+ * Never visible to Scheme code: Var, Set and Define nodes marked boxed
+ * by the parser read and write through it.
+ */
+struct Box : ValueBase {
+    Value v;   ///< Current value, empty while the variable is undefined
+    explicit Box(const Value &);
+    virtual void show(std::ostream &) override;
+    virtual void traceRefs(GcVisitor &) override;
+    virtual void clearRefs() override;
+};
+Value BoxV(const Value &);
+
+/**
+ * @brief Wrap the listed slots of a new frame in Boxes
+ */
+void box_slots(Frame *, const std::vector<int> &);
+
+/**
+ * @brief The variable stored in a boxed slot
+ */
+inline Value &unbox(Value &slot) {
+    return static_cast<Box *>(slot.get())->v;
+}
+
+/**
+ * @brief Entry point of a primitive: its evaluator node and the argument array
+ */
+typedef Value (*PrimitiveFn)(ExprBase *, const Value *, int);
+
+/**
+ * @brief Built-in procedure value (car, +, display, ...)
+ *
+ * One Primitive per built-in is allocated at startup and handed out whenever
+ * the name is used as a value, so applying it is an arity check and a single
+ * indirect call into the evalRator of `node`.
+ */
+struct Primitive : ValueBase {
+    std::string name;   ///< Name the primitive is bound to
+    PrimitiveFn fn;     ///< Applies node's evalRator to the arguments
+    Expr node;          ///< Evaluator node implementing the primitive
+    int min_args;       ///< Fewest arguments accepted
+    int max_args;       ///< Most arguments accepted, -1 if unbounded
+    Primitive(const std::string &, PrimitiveFn, const Expr &, int, int);
     virtual void show(std::ostream &) override;
 };
-Value ProcedureV(const std::vector<std::string> &, const Expr &, const Assoc &);
+Value PrimitiveV(const std::string &, PrimitiveFn, const Expr &, int, int);
 
 // ============================================================================
 // Utility Functions
 // ============================================================================
 
-std::ostream &operator<<(std::ostream &, Value &);
+std::ostream &operator<<(std::ostream &, const Value &);
 
 #endif // VALUE
\ No newline at end of file
@@ -0,0 +1,363 @@
+/**
+ * @file vm.cpp
+ * @brief Stack VM executing the bytecode produced by compiler.cpp
+ *
+ * Calls between compiled procedures do not recurse on the C++ stack: the
+ * caller's state is pushed on `calls` and the callee's chunk is entered in
+ * the same dispatch loop. Tail calls replace the current call record.
+ */
+
+#include "bytecode.hpp"
+#include "RE.hpp"
+#include "jit.hpp"
+
+extern GlobalEnv global_env;
+Value apply_primitive(Primitive *, const Value *, int);
+Value finish_tail_calls(Value);
+
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO 1
+#else
+#define VM_COMPUTED_GOTO 0
+#endif
+
+namespace {
+
+struct CallRecord {
+    std::shared_ptr<Chunk> chunk;   ///< Caller's chunk, kept alive while suspended
+    const int *pc;                  ///< Caller's resume point
+    Env env;                        ///< Caller's frame
+    size_t saved_height;            ///< Size of the let-frame stack on entry to the callee
+};
+
+} // namespace
+
+/**
+ * @brief Evaluate a top-level form with the bytecode VM
+ */
+Value vm_eval(const Expr &expr, Env &top) {
+    std::shared_ptr<Chunk> chunk = compile(expr);
+    const int *pc = chunk->code.data();
+    Env env = top;
+    std::vector<Value> stack;
+    std::vector<Env> saved;          // frames shadowed by let/letrec
+    std::vector<CallRecord> calls;
+    int argc = 0;
+    bool tail = false;
+
+// A computed goto leaves the current block without running destructors, so
+// no handler may have an owning local (Value, Env, vector) alive at NEXT().
+#define PUSH(v) stack.push_back(v)
+#define TOP() stack.back()
+#define NODE(T) static_cast<T *>(chunk->nodes[*pc++])
+
+#if VM_COMPUTED_GOTO
+    // must list the labels in OpCode order
+    static void *labels[OP_COUNT] = {
+        &&L_OP_CONST, &&L_OP_EVAL, &&L_OP_LOCAL0, &&L_OP_LOCAL, &&L_OP_BOXED, &&L_OP_GLOBAL,
+        &&L_OP_SET_CHECK, &&L_OP_SET, &&L_OP_DEF_CHECK, &&L_OP_DEF_VOID, &&L_OP_DEF_SET,
+        &&L_OP_POP, &&L_OP_JUMP, &&L_OP_JUMP_FALSE, &&L_OP_JUMP_FALSE_KEEP, &&L_OP_JUMP_TRUE_KEEP,
+        &&L_OP_UNARY, &&L_OP_BINARY, &&L_OP_VARIADIC, &&L_OP_CLOSURE, &&L_OP_LET,
+        &&L_OP_LETREC, &&L_OP_STORE0, &&L_OP_BOX, &&L_OP_END_LET, &&L_OP_CHECK_PROC, &&L_OP_CALL,
+        &&L_OP_TAIL_CALL, &&L_OP_RETURN, &&L_OP_HALT
+    };
+#define TARGET(op) L_##op:
+#define NEXT() goto *labels[*pc++]
+    NEXT();
+#else
+#define TARGET(op) case op:
+#define NEXT() goto dispatch
+dispatch:
+    switch (*pc++) {
+#endif
+
+    TARGET(OP_CONST) {
+        PUSH(chunk->consts[*pc++]);
+        NEXT();
+    }
+    TARGET(OP_EVAL) {
+        ExprBase *e = chunk->nodes[*pc++];
+        PUSH(finish_tail_calls(e->eval(env)));  // tail-marked applications inside the node
+        NEXT();
+    }
+    TARGET(OP_LOCAL0) {
+        Value &v = env->slots[pc[0]];
+        if (v.empty()) {
+            chunk->nodes[pc[1]]->eval(env);  // reports the undefined variable
+        }
+        PUSH(v);
+        pc += 2;
+        NEXT();
+    }
+    TARGET(OP_LOCAL) {
+        Value &v = lookup(env, pc[0], pc[1]);
+        if (v.empty()) {
+            chunk->nodes[pc[2]]->eval(env);
+        }
+        PUSH(v);
+        pc += 3;
+        NEXT();
+    }
+    TARGET(OP_BOXED) {
+        Value &v = unbox(lookup(env, pc[0], pc[1]));
+        if (v.empty()) {
+            chunk->nodes[pc[2]]->eval(env);
+        }
+        PUSH(v);
+        pc += 3;
+        NEXT();
+    }
+    TARGET(OP_GLOBAL) {
+        Var *var = NODE(Var);
+        if (var->cell != nullptr && !var->cell->v.empty()) {
+            PUSH(var->cell->v);
+        } else {
+            PUSH(var->eval(env));
+        }
+        NEXT();
+    }
+    TARGET(OP_SET_CHECK) {
+        Set *set = NODE(Set);
+        if (set->depth >= 0) {
+            Value &slot = lookup(env, set->depth, set->index);
+            if ((set->boxed ? unbox(slot) : slot).empty()) {
+                throw RuntimeError("the var has not been defined yet");
+            }
+        } else {
+            if (set->cell == nullptr) {
+                set->cell = global_env.cell(set->var);
+            }
+            if (set->cell->v.empty()) {
+                throw RuntimeError("the var has not been defined yet");
+            }
+        }
+        NEXT();
+    }
+    TARGET(OP_SET) {
+        Set *set = NODE(Set);
+        if (set->depth >= 0) {
+            Value &slot = lookup(env, set->depth, set->index);
+            (set->boxed ? unbox(slot) : slot) = std::move(TOP());
+        } else {
+            set->cell->v = std::move(TOP());
+        }
+        TOP() = VoidV();
+        NEXT();
+    }
+    TARGET(OP_DEF_CHECK) {
+        Define *def = NODE(Define);
+        def->checkName();
+        def->bind(env, VoidV());
+        NEXT();
+    }
+    TARGET(OP_DEF_VOID) {
+        NODE(Define)->bind(env, VoidV());
+        NEXT();
+    }
+    TARGET(OP_DEF_SET) {
+        NODE(Define)->bind(env, TOP());
+        TOP() = VoidV();
+        NEXT();
+    }
+    TARGET(OP_POP) {
+        stack.pop_back();
+        NEXT();
+    }
+    TARGET(OP_JUMP) {
+        pc = chunk->code.data() + *pc;
+        NEXT();
+    }
+    TARGET(OP_JUMP_FALSE) {
+        bool f = TOP().isFalse();
+        stack.pop_back();
+        pc = f ? chunk->code.data() + *pc : pc + 1;
+        NEXT();
+    }
+    TARGET(OP_JUMP_FALSE_KEEP) {
+        if (TOP().isFalse()) {
+            pc = chunk->code.data() + *pc;
+        } else {
+            stack.pop_back();
+            ++pc;
+        }
+        NEXT();
+    }
+    TARGET(OP_JUMP_TRUE_KEEP) {
+        if (!TOP().isFalse()) {
+            pc = chunk->code.data() + *pc;
+        } else {
+            stack.pop_back();
+            ++pc;
+        }
+        NEXT();
+    }
+    TARGET(OP_UNARY) {
+        Unary *u = NODE(Unary);
+        TOP() = u->evalRator(TOP());
+        NEXT();
+    }
+    TARGET(OP_BINARY) {
+        Binary *b = NODE(Binary);
+        Value &rand1 = stack[stack.size() - 2];
+        rand1 = b->evalRator(rand1, TOP());
+        stack.pop_back();
+        NEXT();
+    }
+    TARGET(OP_VARIADIC) {
+        Variadic *v = NODE(Variadic);
+        int n = *pc++;
+        {
+            Value result = v->evalRator(stack.data() + (stack.size() - n), n);
+            stack.erase(stack.end() - n, stack.end());
+            PUSH(std::move(result));
+        }
+        NEXT();
+    }
+    TARGET(OP_CLOSURE) {
+        Lambda *lambda = NODE(Lambda);
+        if (lambda->closure) {
+            PUSH(*lambda->closure);
+        } else {
+            const std::vector<std::pair<int, int>> &captures = lambda->info->captures;
+            Env captured(new Frame(captures.size(), Env(nullptr)));
+            for (size_t i = 0; i < captures.size(); ++i) {
+                captured->slots[i] = lookup(env, captures[i].first, captures[i].second);
+            }
+            PUSH(ProcedureV(lambda->info, captured));
+        }
+        NEXT();
+    }
+    TARGET(OP_LET) {
+        int size = pc[0], n = pc[1];
+        pc += 2;
+        saved.push_back(env);
+        env = Env(new Frame(size, saved.back()));
+        for (int k = 0; k < n; ++k) {
+            env->slots[k] = std::move(stack[stack.size() - n + k]);
+        }
+        stack.erase(stack.end() - n, stack.end());
+        NEXT();
+    }
+    TARGET(OP_LETREC) {
+        int size = pc[0], n = pc[1];
+        pc += 2;
+        saved.push_back(env);
+        env = Env(new Frame(size, saved.back()));
+        for (int k = 0; k < n; ++k) {
+            env->slots[k] = VoidV();
+        }
+        NEXT();
+    }
+    TARGET(OP_STORE0) {
+        Value &slot = env->slots[*pc++];
+        (slot.type() == V_BOX ? unbox(slot) : slot) = std::move(TOP());
+        stack.pop_back();
+        NEXT();
+    }
+    TARGET(OP_BOX) {
+        Value &slot = env->slots[*pc++];
+        slot = BoxV(slot);
+        NEXT();
+    }
+    TARGET(OP_END_LET) {
+        env = std::move(saved.back());
+        saved.pop_back();
+        NEXT();
+    }
+    TARGET(OP_CHECK_PROC) {
+        if (TOP().type() != V_PROC && TOP().type() != V_PRIMITIVE) {
+            throw RuntimeError("Attempt to apply a non-procedure");
+        }
+        NEXT();
+    }
+    TARGET(OP_CALL) {
+        argc = *pc++;
+        tail = false;
+        goto do_call;
+    }
+    TARGET(OP_TAIL_CALL) {
+        argc = *pc++;
+        tail = true;
+        goto do_call;
+    }
+    TARGET(OP_RETURN) {
+        CallRecord &caller = calls.back();
+        chunk = std::move(caller.chunk);
+        pc = caller.pc;
+        env = std::move(caller.env);
+        calls.pop_back();
+        NEXT();
+    }
+    TARGET(OP_HALT) {
+        return stack.back();
+    }
+
+#if !VM_COMPUTED_GOTO
+    default:
+        throw RuntimeError("Invalid bytecode");
+    }
+#endif
+
+do_call:
+    {
+        size_t base = stack.size() - argc;
+        if (stack[base - 1].type() == V_PRIMITIVE) {
+            // 内置函数直接读取栈上的实参，不复制
+            Primitive *prim = static_cast<Primitive *>(stack[base - 1].get());
+            Value result = apply_primitive(prim, stack.data() + base, argc);
+            stack.erase(stack.begin() + (base - 1), stack.end());
+            PUSH(std::move(result));
+        } else {
+            Procedure *proc = static_cast<Procedure *>(stack[base - 1].get());
+            LambdaInfo &info = *proc->info;
+            if (argc != static_cast<int>(info.x.size())) {
+                throw RuntimeError("Wrong number of arguments for lambda");
+            }
+            Env callee(stack_frame(info.frame_size, proc->env));
+            for (int k = 0; k < argc; ++k) {
+                callee->slots[k] = std::move(stack[base + k]);
+            }
+            box_slots(callee.get(), info.boxed);
+            Value native(nullptr);
+            if (jit_call(proc, callee, argc, native)) {
+                stack.erase(stack.begin() + (base - 1), stack.end());
+                PUSH(std::move(native));
+                if (tail) {
+                    // 尾调用的结果直接返回给当前函数的调用者
+                    saved.resize(calls.back().saved_height, Env(nullptr));
+                    CallRecord &caller = calls.back();
+                    chunk = std::move(caller.chunk);
+                    pc = caller.pc;
+                    env = std::move(caller.env);
+                    calls.pop_back();
+                }
+            } else {
+                if (!info.code) {
+                    info.code = compile_body(info.e);
+                }
+                std::shared_ptr<Chunk> target = info.code;
+                stack.erase(stack.begin() + (base - 1), stack.end());
+                if (tail) {
+                    saved.resize(calls.back().saved_height, Env(nullptr));
+                } else {
+                    calls.push_back(CallRecord{std::move(chunk), pc, std::move(env), saved.size()});
+                }
+                chunk = std::move(target);
+                pc = chunk->code.data();
+                env = std::move(callee);
+                if (tail) {
+                    // 释放被替换的帧，新帧下移到它在值栈上的位置
+                    callee = Env(nullptr);
+                    settle_frame(env.get());
+                }
+            }
+        }
+    }
+    NEXT();
+
+#undef PUSH
+#undef TOP
+#undef NODE
+#undef TARGET
+#undef NEXT
+}